@@ -34,6 +34,8 @@
 #define EYE_HEIGHT      1.75f
 #define CAM_MIN         1
 #define CAM_MAX         12
+//How far to keep the camera from the ground when a hill gets in the way.
+#define CAM_MARGIN      0.5f
 #define STOP_SPEED      0.02f
 #define SWIM_DEPTH      1.4f
 #define ACCEL           0.66f
@@ -56,6 +58,7 @@ static GLvector         camera_angle;
 static GLvector         angle;
 static GLvector         avatar_facing;
 static GLvector         position;
+static GLvector         travel;
 static GLvector2        current_movement;
 static GLvector2        desired_movement;
 static float            cam_distance;
@@ -119,6 +122,10 @@ void do_camera ()
 {
 
   GLvector  cam;
+  GLvector  eye;
+  GLvector  to_cam;
+  float     distance;
+  float     hit;
   float     vert_delta;
   float     horz_delta;
   float     ground;
@@ -130,13 +137,22 @@ void do_camera ()
   horz_delta = sin (rads.x);
 
 
-  cam = position;
-  cam.z += EYE_HEIGHT;
+  eye = position;
+  eye.z += EYE_HEIGHT;
+  cam = eye;
   
   cam.x += sin (angle.z * DEGREES_TO_RADIANS) * cam_distance * horz_delta;
   cam.y += cos (angle.z * DEGREES_TO_RADIANS) * cam_distance * horz_delta;
   cam.z += vert_delta;
 
+  //If there's a hill between us and the camera, pull the camera in front of it.
+  to_cam = cam - eye;
+  distance = to_cam.Length ();
+  if (distance > 0.0f) {
+    to_cam /= distance;
+    if (CacheRaycast (eye, to_cam, distance, &hit))
+      cam = eye + to_cam * max (hit - CAM_MARGIN, 0.0f);
+  }
   ground = CacheElevation (cam.x, cam.y) + 0.2f;
   cam.z = max (cam.z, ground);
   camera_angle = angle;
@@ -181,8 +197,10 @@ void AvatarUpdate (void)
   float     angle_adjust;
   float     step_tracking;
 
-  if (!GameRunning ())
+  if (!GameRunning ()) {
+    CacheView (position, camera_angle, travel, false);
     return;
+  }
   if (InputKeyState (SDLK_LCTRL)) 
     AvatarLook (0, 1);
   flying = CVarUtils::GetCVar<bool> ("flying");
@@ -316,8 +334,16 @@ void AvatarUpdate (void)
   last_time = GameTime ();
   TextPrint ("%s elapsed: %f", anim_names[anim_id], elapsed);
   region = WorldRegionGet ((int)(position.x + REGION_HALF) / REGION_SIZE, (int)(position.y + REGION_HALF) / REGION_SIZE);
+  //Keep a smoothed velocity, so the cache can guess where we're headed.
+  if (elapsed > 0.0f) {
+    travel.x = MathInterpolate (travel.x, (position.x - old.x) / elapsed, elapsed * 4.0f);
+    travel.y = MathInterpolate (travel.y, (position.y - old.y) / elapsed, elapsed * 4.0f);
+    travel.z = MathInterpolate (travel.z, (position.z - old.z) / elapsed, elapsed * 4.0f);
+  }
   do_camera ();
   do_location ();
+  //Let the cache know where we are, so it can fetch what we'll need next.
+  CacheView (position, camera_angle, travel, true);
 
 }
 
@@ -371,13 +397,22 @@ void AvatarPositionSet (GLvector new_pos)
   new_pos.x = clamp (new_pos.x, 0, (REGION_SIZE * WORLD_GRID));
   new_pos.y = clamp (new_pos.y, 0, (REGION_SIZE * WORLD_GRID));
   position = new_pos;
+  travel = glVector (0.0f, 0.0f, 0.0f);
   camera_position = position;
   angle = camera_angle = glVector (90.0f, 0.0f, 0.0f);
   last_time = GameTime ();
+  CacheView (position, camera_angle, travel, GameRunning ());
   do_model ();
 
 }
 
+GLvector AvatarVelocity ()
+{
+
+  return travel;
+
+}
+
 GLvector AvatarCameraPosition ()
 {
 
@@ -21,4 +21,5 @@ void      AvatarPositionSet (GLvector new_pos);
 void*     AvatarRegion ();
 void      AvatarRender ();
 void      AvatarUpdate ();
+GLvector  AvatarVelocity ();
 
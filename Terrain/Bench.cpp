@@ -0,0 +1,182 @@
+/*-----------------------------------------------------------------------------
+
+  Bench.cpp
+
+-------------------------------------------------------------------------------
+
+  Measures the engine core without a window: generate a world, build a block
+  of its pages, build the terrain, grass, and brush meshes in the middle of
+  it, and build a full set of tree meshes, timing each.  The meshes are sent
+  to the core's stand-in for GL (see Headless.cpp), so this also shows they 
+  can be built with no GL context.  The page normal kernel is also timed against the original cell-at-a-time path, and
+  checked against it and against its own plain C version.  This is built 
+  with the core library, and runs anywhere it does.
+
+  Usage: frontier_bench [first seed] [seed count] [pages across]
+
+  Stages and pages are saved like any other world, so running the same seed
+  again measures loading them instead.  Delete the saves directory to time
+  everything from scratch.
+
+-----------------------------------------------------------------------------*/
+
+#include "Core.h"
+#include "Cache.h"
+#include "Cpage.h"
+#include "VBO.h"
+#include "CBrush.h"
+#include "CGrass.h"
+#include "CTerrain.h"
+#include "CTree.h"
+#include "Platform.h"
+#include "World.h"
+
+#define BENCH_SIZE        16
+#define NORMAL_PASSES     20
+#define MESH_SLICE        10 //milliseconds
+#define MESH_BLOCKS       (TERRAIN_SIZE / GRASS_SIZE)
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+//Run one grid item until it's done, letting the cache bring in its pages.
+static void mesh_build (GridData* item)
+{
+
+  while (!item->Ready ()) {
+    CacheUpdate (PlatformTick () + MESH_SLICE);
+    item->Update (PlatformTick () + MESH_SLICE);
+  }
+
+}
+
+//Build one terrain mesh, and the grass and brush meshes that cover it, the 
+//way the scene does.  The first terrain only brings the pages in, so the 
+//time is just the building.
+static unsigned bench_meshes (GLcoord origin, double* seconds)
+{
+
+  CTerrain*   terrain;
+  CGrass*     grass;
+  CBrush*     brush;
+  int         x, y;
+  unsigned    polygons;
+  double      start;
+
+  terrain = new CTerrain;
+  terrain->Set (origin.x, origin.y, 0);
+  mesh_build (terrain);
+  delete terrain;
+  start = PlatformSeconds ();
+  terrain = new CTerrain;
+  terrain->Set (origin.x, origin.y, 0);
+  mesh_build (terrain);
+  polygons = terrain->Polygons ();
+  delete terrain;
+  for (x = 0; x < MESH_BLOCKS; x++) {
+    for (y = 0; y < MESH_BLOCKS; y++) {
+      grass = new CGrass;
+      grass->Set (origin.x * MESH_BLOCKS + x, origin.y * MESH_BLOCKS + y, 0);
+      mesh_build (grass);
+      polygons += grass->Polygons ();
+      delete grass;
+      brush = new CBrush;
+      brush->Set (origin.x * MESH_BLOCKS + x, origin.y * MESH_BLOCKS + y, 0);
+      mesh_build (brush);
+      polygons += brush->Polygons ();
+      delete brush;
+    }
+  }
+  *seconds = PlatformSeconds () - start;
+  return polygons;
+
+}
+
+//Build one tree of every species, the way the world does, and count triangles.
+static unsigned bench_trees ()
+{
+
+  CTree*      tree;
+  unsigned    m, t;
+  unsigned    alt, lod;
+  unsigned    triangles;
+
+  triangles = 0;
+  tree = new CTree;
+  for (m = 0; m < TREE_TYPES; m++) {
+    for (t = 0; t < TREE_TYPES; t++) {
+      tree->Create (false, (float)m / TREE_TYPES, (float)t / TREE_TYPES, m * TREE_TYPES + t);
+      for (alt = 0; alt < TREE_ALTS; alt++) {
+        for (lod = 0; lod < LOD_LEVELS; lod++)
+          triangles += tree->Mesh (alt, (LOD)lod)->Triangles ();
+      }
+    }
+  }
+  delete tree;
+  return triangles;
+
+}
+
+//Time and check the normal kernel on one page.
+static void bench_normals (GLcoord origin, double* reference, double* kernel, int* scalar_differ, int* reference_differ)
+{
+
+  CPage*      p;
+
+  p = new CPage;
+  p->Cache (origin.x, origin.y);
+  p->Build ();
+  p->NormalBenchmark (NORMAL_PASSES, reference, kernel, scalar_differ, reference_differ);
+  delete p;
+
+}
+
+int main (int argc, char** argv)
+{
+
+  unsigned    first, count, i;
+  unsigned    triangles;
+  unsigned    polygons;
+  int         across;
+  int         built;
+  int         scalar_differ, reference_differ;
+  unsigned long long  bytes;
+  GLcoord     origin, size, center;
+  double      start, world, pages, trees, meshes;
+  double      reference, kernel;
+
+  first = argc > 1 ? (unsigned)atoi (argv[1]) : 1;
+  count = argc > 2 ? (unsigned)atoi (argv[2]) : 1;
+  across = argc > 3 ? atoi (argv[3]) : BENCH_SIZE;
+  across = clamp (across, 1, WORLD_GRID);
+  size.x = size.y = across;
+  origin.x = origin.y = (WORLD_GRID - across) / 2;
+  center.x = center.y = origin.x + across / 2;
+  WorldInit ();
+  CacheInit ();
+  printf ("seed\tworld ms\tpages\tbytes\tpages ms\tpages/sec\ttrees ms\ttriangles/sec\t");
+  printf ("meshes ms\tpolygons\tnormals ms\tkernel ms\tvs plain C\tvs original\n");
+  for (i = 0; i < count; i++) {
+    start = PlatformSeconds ();
+    WorldBake (first + i);
+    world = PlatformSeconds () - start;
+    start = PlatformSeconds ();
+    built = CacheBake (origin, size, &bytes);
+    pages = PlatformSeconds () - start;
+    CachePurge ();
+    polygons = bench_meshes (center, &meshes);
+    start = PlatformSeconds ();
+    triangles = bench_trees ();
+    trees = PlatformSeconds () - start;
+    bench_normals (origin, &reference, &kernel, &scalar_differ, &reference_differ);
+    printf ("%u\t%.1f\t%d\t%llu\t%.1f\t%.1f\t%.1f\t%.0f\t%.1f\t%u\t%.3f\t%.3f\t%d\t%d\n", first + i,
+      world * 1000.0, built, bytes, pages * 1000.0, pages > 0.0 ? built / pages : 0.0,
+      trees * 1000.0, trees > 0.0 ? triangles / trees : 0.0, meshes * 1000.0, polygons,
+      reference * 1000.0 / NORMAL_PASSES, kernel * 1000.0 / NORMAL_PASSES, scalar_differ, reference_differ);
+    fflush (stdout);
+  }
+  CacheTerm ();
+  return 0;
+
+}
@@ -4,19 +4,19 @@
 
 -------------------------------------------------------------------------------
 
-  This holds the brush object class.  Bushes and the like. 
+  This holds the brush object class.  Bushes and the like.  Drawing them needs a
+  GL context, and is in CBrushRender.cpp.
 
 -----------------------------------------------------------------------------*/
 
 
-#include "stdafx.h"
-#include "cache.h"
-#include "cbrush.h"
-#include "entropy.h"
-#include "sdl.h"
-#include "Render.h"
-#include "texture.h"
-#include "world.h"
+#include "Core.h"
+#include "Cache.h"
+#include "Platform.h"
+#include "VBO.h"
+#include "CBrush.h"
+#include "Entropy.h"
+#include "World.h"
 
 #define BRUSH_TYPES   4
 #define MAX_TUFTS     9
@@ -105,15 +105,19 @@ void CBrush::Set (int x, int y, int density)
 bool CBrush::ZoneCheck ()
 {
 
+  bool    ready;
+
+  //Ask for all four corners at once, so the workers can build them side by side.
+  ready = true;
   if (!CachePointAvailable (_origin.x, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + BRUSH_SIZE, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + BRUSH_SIZE,_origin.y + BRUSH_SIZE))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x, _origin.y + BRUSH_SIZE))
-    return false;
-  return true;
+    ready = false;
+  return ready;
 
 }
 
@@ -121,64 +125,74 @@ bool CBrush::ZoneCheck ()
 void CBrush::Build (long stop)
 {
 
-  int       world_x, world_y;
-  bool      do_tuft;
+  int         x;
+  int         world_x, world_y;
+  bool        do_tuft;
+  SurfaceType surface[BRUSH_SIZE];
+  GLrgba      surface_color[BRUSH_SIZE];
+  GLvector    surface_normal[BRUSH_SIZE];
 
-  world_x = _origin.x + _walk.x;
+  //Build a whole row at a time, so we only have to go to the cache once.
   world_y = _origin.y + _walk.y;
-  do_tuft = CacheSurface (world_x, world_y) == SURFACE_GRASS_EDGE;
-  if (do_tuft) {
-    GLvector    v[8];
-    GLvector    normal;
-    GLrgba      color;
-    int         current;
-    GLvector    root;
-    GLvector2   size;
-    Region      r;
-    float       height;
-    int         index;
-    int         patch;
-    tuft*       this_tuft;
-    unsigned    i;
-
-    r = WorldRegionFromPosition (world_x, world_y);
-    index = world_x + world_y * BRUSH_SIZE;
-    this_tuft = &tuft_list[index % MAX_TUFTS];
-    root.x = (float)world_x;
-    root.y = (float)world_y;
-    root.z = 0.0f;
-    height = 0.25f + (r.moisture * r.temperature) * 2.0f;
-    size.x = 1.0f + WorldNoisef (index) * 1.0f;
-    size.y = 1.0f + WorldNoisef (index) * height;
-    size.y = max (size.x, size.y);//Don't let bushes get wider than they are tall
-    color = CacheSurfaceColor (world_x, world_y);
-    color *= 0.75f;
-    color.alpha = 1.0f;
-    //Now we construct our grass panels
-    for (i = 0; i < 4; i++) { 
-      v[i] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
-      v[i + 4] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
-      v[i + 4].z += size.y;
-    }
-    for (i = 0; i < 8; i++) {
-      v[i] += root;
-      v[i].z += CacheElevation (v[i].x, v[i].y);
+  CacheSurfaceRect (_origin.x, world_y, BRUSH_SIZE, 1, surface);
+  CacheSurfaceColorRect (_origin.x, world_y, BRUSH_SIZE, 1, surface_color);
+  CacheNormalRect (_origin.x, world_y, BRUSH_SIZE, 1, surface_normal);
+  for (x = 0; x < BRUSH_SIZE; x++) {
+    world_x = _origin.x + x;
+    do_tuft = surface[x] == SURFACE_GRASS_EDGE;
+    if (do_tuft) {
+      GLvector    v[8];
+      GLvector    normal;
+      GLrgba      color;
+      int         current;
+      GLvector    root;
+      GLvector2   size;
+      Region      r;
+      float       height;
+      int         index;
+      int         patch;
+      tuft*       this_tuft;
+      unsigned    i;
+
+      r = WorldRegionFromPosition (world_x, world_y);
+      index = world_x + world_y * BRUSH_SIZE;
+      this_tuft = &tuft_list[index % MAX_TUFTS];
+      root.x = (float)world_x;
+      root.y = (float)world_y;
+      root.z = 0.0f;
+      height = 0.25f + (r.moisture * r.temperature) * 2.0f;
+      size.x = 1.0f + WorldNoisef (index) * 1.0f;
+      size.y = 1.0f + WorldNoisef (index) * height;
+      size.y = max (size.x, size.y);//Don't let bushes get wider than they are tall
+      color = surface_color[x];
+      color *= 0.75f;
+      color.alpha = 1.0f;
+      //Now we construct our grass panels
+      for (i = 0; i < 4; i++) { 
+        v[i] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
+        v[i + 4] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
+        v[i + 4].z += size.y;
+      }
+      for (i = 0; i < 8; i++) {
+        v[i] += root;
+        v[i].z += CacheElevation (v[i].x, v[i].y);
+      }
+      patch = r.flower_shape[index % FLOWERS] % BRUSH_TYPES;
+      current = _mesh.Vertices ();
+      normal = surface_normal[x];
+      _mesh.PushVertex (v[0], normal, color, box[patch].Corner (1)); 
+      _mesh.PushVertex (v[1], normal, color, box[patch].Corner (1)); 
+      _mesh.PushVertex (v[2], normal, color, box[patch].Corner (0)); 
+      _mesh.PushVertex (v[3], normal, color, box[patch].Corner (0)); 
+      _mesh.PushVertex (v[4], normal, color, box[patch].Corner (2)); 
+      _mesh.PushVertex (v[5], normal, color, box[patch].Corner (2)); 
+      _mesh.PushVertex (v[6], normal, color, box[patch].Corner (3)); 
+      _mesh.PushVertex (v[7], normal, color, box[patch].Corner (3)); 
+      _mesh.PushQuad (current, current + 2, current + 6, current + 4);
+      _mesh.PushQuad (current + 1, current + 3, current + 7, current + 5);
     }
-    patch = r.flower_shape[index % FLOWERS] % BRUSH_TYPES;
-    current = _mesh.Vertices ();
-    normal = CacheNormal (world_x, world_y);
-    _mesh.PushVertex (v[0], normal, color, box[patch].Corner (1)); 
-    _mesh.PushVertex (v[1], normal, color, box[patch].Corner (1)); 
-    _mesh.PushVertex (v[2], normal, color, box[patch].Corner (0)); 
-    _mesh.PushVertex (v[3], normal, color, box[patch].Corner (0)); 
-    _mesh.PushVertex (v[4], normal, color, box[patch].Corner (2)); 
-    _mesh.PushVertex (v[5], normal, color, box[patch].Corner (2)); 
-    _mesh.PushVertex (v[6], normal, color, box[patch].Corner (3)); 
-    _mesh.PushVertex (v[7], normal, color, box[patch].Corner (3)); 
-    _mesh.PushQuad (current, current + 2, current + 6, current + 4);
-    _mesh.PushQuad (current + 1, current + 3, current + 7, current + 5);
   }
-  if (_walk.Walk (BRUSH_SIZE)) 
+  if (_walk.Walk (1, BRUSH_SIZE)) 
     _stage++;
 
 }
@@ -186,7 +200,7 @@ void CBrush::Build (long stop)
 void CBrush::Update (long stop)
 {
 
-  while (SdlTick () < stop && !Ready ()) {
+  while (PlatformTick () < stop && !Ready ()) {
     switch (_stage) {
     case BRUSH_STAGE_BEGIN:
       if (!ZoneCheck ())
@@ -207,18 +221,3 @@ void CBrush::Update (long stop)
   }
 
 }
-
-
-void CBrush::Render ()
-{
-
-  //We need at least one successful build before we can draw.
-  if (!_valid)
-    return;
-  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
-  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-  glDisable (GL_CULL_FACE);
-  _vbo.Render ();
-
-}
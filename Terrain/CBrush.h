@@ -10,7 +10,7 @@ enum
 
 
 #ifndef GRID
-#include "cgrid.h"
+#include "CGrid.h"
 #endif
 
 class CBrush : public GridData
@@ -40,6 +40,7 @@ public:
   unsigned          Sizeof () { return sizeof (CBrush); }; 
   void              Set (int origin_x, int origin_y, int distance);
   void              Render ();
+  int               Polygons () { return _mesh.Triangles (); }
   void              Update (long stop);
   bool              Ready ()  { return _stage == BRUSH_STAGE_DONE; };
   void              Invalidate () { _valid = false; };
@@ -0,0 +1,31 @@
+/*-----------------------------------------------------------------------------
+
+  CBrushRender.cpp
+
+-------------------------------------------------------------------------------
+
+  Drawing the brush, which needs a GL context.  The mesh is built in
+  CBrush.cpp, which is part of the core library.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include "CBrush.h"
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void CBrush::Render ()
+{
+
+  //We need at least one successful build before we can draw.
+  if (!_valid)
+    return;
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  glDisable (GL_CULL_FACE);
+  _vbo.Render ();
+
+}
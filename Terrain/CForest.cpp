@@ -53,15 +53,19 @@ unsigned CForest::MeshFromTexture (unsigned texture_id)
 bool CForest::ZoneCheck ()
 {
 
+  bool    ready;
+
+  //Ask for all four corners at once, so the workers can build them side by side.
+  ready = true;
   if (!CachePointAvailable (_origin.x, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + FOREST_SIZE, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + FOREST_SIZE,_origin.y + FOREST_SIZE))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x, _origin.y + FOREST_SIZE))
-    return false;
-  return true;
+    ready = false;
+  return ready;
 
 }
 
@@ -105,36 +109,44 @@ void CForest::Build (long stop)
   GLmatrix      mat;
   unsigned      mesh_index;
   unsigned      alt;
+  int           x;
+  unsigned      trees[FOREST_SIZE];
+  float         elevation[FOREST_SIZE];
 
-  world_x = _origin.x + _walk.x;
+  //Build a whole row at a time, so we only have to go to the cache once.
   world_y = _origin.y + _walk.y;
-  tree_id = CacheTree (world_x, world_y);
-  if (tree_id) {
-    alt = _walk.x + _walk.y * FOREST_SIZE;
-    mat.Identity ();
-    mat.Rotate (WorldNoisef (alt) * 360.0f, 0.0f, 0.0f, 1.0f);
-    origin = CachePosition (world_x, world_y);
-    tree = WorldTree (tree_id);
-    tm = tree->Mesh (alt, _lod);
-    //tm = tree->Mesh (alt, LOD_LOW);///////////////
-    texture_id = tree->Texture ();
-    mesh_index = MeshFromTexture (texture_id);
-    base_index = _mesh_list[mesh_index]._mesh.Vertices ();
-    for (i = 0; i < tm->Vertices (); i++) {
-      newpos = glMatrixTransformPoint (mat, tm->_vertex[i]);
-      //newpos.z *= 0.5f + WorldNoisef (2 + _walk.x + _walk.y * FOREST_SIZE) * 1.0f;
-      newnorm = glMatrixTransformPoint (mat, tm->_normal[i]);
-      _mesh_list[mesh_index]._mesh.PushVertex (newpos + origin, newnorm, tm->_uv[i]);
-    }
-    for (i = 0; i < tm->Triangles (); i++) {
-      unsigned i1, i2, i3;
-      i1 = base_index + tm->_index[i * 3];
-      i2 = base_index + tm->_index[i * 3 + 1];
-      i3 = base_index + tm->_index[i * 3 + 2];
-      _mesh_list[mesh_index]._mesh.PushTriangle (i1, i2, i3);
+  CacheTreeRect (_origin.x, world_y, FOREST_SIZE, 1, trees);
+  CacheElevationRect (_origin.x, world_y, FOREST_SIZE, 1, elevation);
+  for (x = 0; x < FOREST_SIZE; x++) {
+    world_x = _origin.x + x;
+    tree_id = trees[x];
+    if (tree_id) {
+      alt = x + _walk.y * FOREST_SIZE;
+      mat.Identity ();
+      mat.Rotate (WorldNoisef (alt) * 360.0f, 0.0f, 0.0f, 1.0f);
+      origin = glVector ((float)world_x, (float)world_y, elevation[x]);
+      tree = WorldTree (tree_id);
+      tm = tree->Mesh (alt, _lod);
+      //tm = tree->Mesh (alt, LOD_LOW);///////////////
+      texture_id = tree->Texture ();
+      mesh_index = MeshFromTexture (texture_id);
+      base_index = _mesh_list[mesh_index]._mesh.Vertices ();
+      for (i = 0; i < tm->Vertices (); i++) {
+        newpos = glMatrixTransformPoint (mat, tm->_vertex[i]);
+        //newpos.z *= 0.5f + WorldNoisef (2 + _walk.x + _walk.y * FOREST_SIZE) * 1.0f;
+        newnorm = glMatrixTransformPoint (mat, tm->_normal[i]);
+        _mesh_list[mesh_index]._mesh.PushVertex (newpos + origin, newnorm, tm->_uv[i]);
+      }
+      for (i = 0; i < tm->Triangles (); i++) {
+        unsigned i1, i2, i3;
+        i1 = base_index + tm->_index[i * 3];
+        i2 = base_index + tm->_index[i * 3 + 1];
+        i3 = base_index + tm->_index[i * 3 + 2];
+        _mesh_list[mesh_index]._mesh.PushTriangle (i1, i2, i3);
+      }
     }
   }
-  if (_walk.Walk (FOREST_SIZE))
+  if (_walk.Walk (1, FOREST_SIZE))
     _stage++;
 
 }
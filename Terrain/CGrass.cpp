@@ -4,18 +4,18 @@
 
 -------------------------------------------------------------------------------
 
-  This holds the grass object class.  Little bits of grass all over!
+  This holds the grass object class.  Little bits of grass all over!  
+  Drawing it needs a GL context, and is in CGrassRender.cpp.
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
-#include "cache.h"
-#include "cgrass.h"
-#include "entropy.h"
-#include "sdl.h"
-#include "render.h"
-#include "texture.h"
-#include "world.h"
+#include "Core.h"
+#include "Cache.h"
+#include "Platform.h"
+#include "VBO.h"
+#include "CGrass.h"
+#include "Entropy.h"
+#include "World.h"
 
 #define GRASS_TYPES   8
 #define MAX_TUFTS     9
@@ -128,95 +128,109 @@ void CGrass::QuadPush (int n1, int n2, int n3, int n4)
 bool CGrass::ZoneCheck ()
 {
 
+  bool    ready;
+
+  //Ask for all four corners at once, so the workers can build them side by side.
+  ready = true;
   if (!CachePointAvailable (_origin.x, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + GRASS_SIZE, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + GRASS_SIZE,_origin.y + GRASS_SIZE))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x, _origin.y + GRASS_SIZE))
-    return false;
-  return true;
+    ready = false;
+  return ready;
 
 }
 
 void CGrass::Build (long stop)
 {
 
-  int       world_x, world_y;
-  bool      do_grass;
+  int         x;
+  int         world_x, world_y;
+  bool        do_grass;
+  SurfaceType surface[GRASS_SIZE];
+  GLrgba      surface_color[GRASS_SIZE];
+  GLvector    surface_normal[GRASS_SIZE];
 
-  world_x = _origin.x + _walk.x;
+  //Build a whole row at a time, so we only have to go to the cache once.
   world_y = _origin.y + _walk.y;
-  do_grass = CacheSurface (world_x, world_y) == SURFACE_GRASS;
-  if (_walk.x % _current_distance || _walk.y  % _current_distance)
-    do_grass = false;
-  if (do_grass) {
-    GLvector    v[8];
-    GLvector    normal;
-    GLrgba      color;
-    int         current;
-    GLvector    root;
-    GLvector2   size;
-    Region      r;
-    float       height;
-    int         index;
-    bool        do_flower;
-    int         patch;
-    tuft*       this_tuft;
-    //GLmatrix    mat;
-    unsigned    i;
-
-    r = WorldRegionFromPosition (world_x, world_y);
-    index = world_x + world_y * GRASS_SIZE;
-    this_tuft = &tuft_list[index % MAX_TUFTS];
-    root.x = (float)world_x + (WorldNoisef (index) -0.5f);
-    root.y = (float)world_y + (WorldNoisef (index) -0.5f);
-    root.z = 0.0f;
-    height = 0.05f + r.moisture * r.temperature;
-    size.x = 0.4f + WorldNoisef (index) * 0.5f;
-    size.y = WorldNoisef (index) * height + (height / 2);
-    do_flower = r.has_flowers;
-    if (do_flower) //flowers are shorter than grass
-      size.y /= 2;
-    size.y = max (size.y, 0.3f);
-    color = CacheSurfaceColor (world_x, world_y);
-    color.alpha = 1.0f;
-    //Now we construct our grass panels
-    for (i = 0; i < 4; i++) { 
-      v[i] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
-      v[i + 4] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
-      v[i + 4].z += size.y;
-    }
-    for (i = 0; i < 8; i++) {
-      v[i] += root;
-      v[i].z += CacheElevation (v[i].x, v[i].y);
-    }
-    patch = r.flower_shape[index % FLOWERS] % GRASS_TYPES;
-    current = _vertex.size ();
-    normal = CacheNormal (world_x, world_y);
-    VertexPush (v[0], normal, color, box_grass[patch].Corner (1));
-    VertexPush (v[1], normal, color, box_grass[patch].Corner (1));
-    VertexPush (v[2], normal, color, box_grass[patch].Corner (0));
-    VertexPush (v[3], normal, color, box_grass[patch].Corner (0));
-    VertexPush (v[4], normal, color, box_grass[patch].Corner (2));
-    VertexPush (v[5], normal, color, box_grass[patch].Corner (2));
-    VertexPush (v[6], normal, color, box_grass[patch].Corner (3));
-    VertexPush (v[7], normal, color, box_grass[patch].Corner (3));
-    QuadPush (current, current + 2, current + 6, current + 4);
-    QuadPush (current + 1, current + 3, current + 7, current + 5);
-    if (do_flower) {
+  CacheSurfaceRect (_origin.x, world_y, GRASS_SIZE, 1, surface);
+  CacheSurfaceColorRect (_origin.x, world_y, GRASS_SIZE, 1, surface_color);
+  CacheNormalRect (_origin.x, world_y, GRASS_SIZE, 1, surface_normal);
+  for (x = 0; x < GRASS_SIZE; x++) {
+    world_x = _origin.x + x;
+    do_grass = surface[x] == SURFACE_GRASS;
+    if (x % _current_distance || _walk.y % _current_distance)
+      do_grass = false;
+    if (do_grass) {
+      GLvector    v[8];
+      GLvector    normal;
+      GLrgba      color;
+      int         current;
+      GLvector    root;
+      GLvector2   size;
+      Region      r;
+      float       height;
+      int         index;
+      bool        do_flower;
+      int         patch;
+      tuft*       this_tuft;
+      //GLmatrix    mat;
+      unsigned    i;
+
+      r = WorldRegionFromPosition (world_x, world_y);
+      index = world_x + world_y * GRASS_SIZE;
+      this_tuft = &tuft_list[index % MAX_TUFTS];
+      root.x = (float)world_x + (WorldNoisef (index) -0.5f);
+      root.y = (float)world_y + (WorldNoisef (index) -0.5f);
+      root.z = 0.0f;
+      height = 0.05f + r.moisture * r.temperature;
+      size.x = 0.4f + WorldNoisef (index) * 0.5f;
+      size.y = WorldNoisef (index) * height + (height / 2);
+      do_flower = r.has_flowers;
+      if (do_flower) //flowers are shorter than grass
+        size.y /= 2;
+      size.y = max (size.y, 0.3f);
+      color = surface_color[x];
+      color.alpha = 1.0f;
+      //Now we construct our grass panels
+      for (i = 0; i < 4; i++) { 
+        v[i] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
+        v[i + 4] = this_tuft->v[i] * glVector (size.x, size.x, 0.0f);
+        v[i + 4].z += size.y;
+      }
+      for (i = 0; i < 8; i++) {
+        v[i] += root;
+        v[i].z += CacheElevation (v[i].x, v[i].y);
+      }
+      patch = r.flower_shape[index % FLOWERS] % GRASS_TYPES;
       current = _vertex.size ();
-      color = r.color_flowers[index % FLOWERS];
-      normal = glVector (0.0f, 0.0f, 1.0f);
-      VertexPush (v[4], normal, color, box_flower[patch].Corner (0));
-      VertexPush (v[5], normal, color, box_flower[patch].Corner (1));
-      VertexPush (v[6], normal, color, box_flower[patch].Corner (2));
-      VertexPush (v[7], normal, color, box_flower[patch].Corner (3));
-      QuadPush (current, current + 1, current + 2, current + 3);
+      normal = surface_normal[x];
+      VertexPush (v[0], normal, color, box_grass[patch].Corner (1));
+      VertexPush (v[1], normal, color, box_grass[patch].Corner (1));
+      VertexPush (v[2], normal, color, box_grass[patch].Corner (0));
+      VertexPush (v[3], normal, color, box_grass[patch].Corner (0));
+      VertexPush (v[4], normal, color, box_grass[patch].Corner (2));
+      VertexPush (v[5], normal, color, box_grass[patch].Corner (2));
+      VertexPush (v[6], normal, color, box_grass[patch].Corner (3));
+      VertexPush (v[7], normal, color, box_grass[patch].Corner (3));
+      QuadPush (current, current + 2, current + 6, current + 4);
+      QuadPush (current + 1, current + 3, current + 7, current + 5);
+      if (do_flower) {
+        current = _vertex.size ();
+        color = r.color_flowers[index % FLOWERS];
+        normal = glVector (0.0f, 0.0f, 1.0f);
+        VertexPush (v[4], normal, color, box_flower[patch].Corner (0));
+        VertexPush (v[5], normal, color, box_flower[patch].Corner (1));
+        VertexPush (v[6], normal, color, box_flower[patch].Corner (2));
+        VertexPush (v[7], normal, color, box_flower[patch].Corner (3));
+        QuadPush (current, current + 1, current + 2, current + 3);
+      }
     }
   }
-  if (_walk.Walk (GRASS_SIZE)) 
+  if (_walk.Walk (1, GRASS_SIZE)) 
     _stage++;
 
 }
@@ -224,7 +238,7 @@ void CGrass::Build (long stop)
 void CGrass::Update (long stop)
 {
 
-  while (SdlTick () < stop && !Ready ()) {
+  while (PlatformTick () < stop && !Ready ()) {
     switch (_stage) {
     case GRASS_STAGE_BEGIN:
       if (!ZoneCheck ())
@@ -246,40 +260,3 @@ void CGrass::Update (long stop)
 
 
 }
-
-void CGrass::Render ()
-{
-
-  //We need at least one successful build before we can draw.
-  if (!_valid)
-    return;
-  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
-  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-  glDisable (GL_CULL_FACE);
-  _vbo.Render ();
-  return;
-  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-  glDisable (GL_BLEND);
-  //glEnable (GL_BLEND);
-  //glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  //glDisable (GL_LIGHTING);
-  _vbo.Render ();
-
-  glDisable (GL_TEXTURE_2D);
-  //glDisable (GL_FOG);
-  glDisable (GL_LIGHTING);
-  glDepthFunc (GL_EQUAL);
-  glEnable (GL_BLEND);
-  glBlendFunc (GL_ZERO, GL_SRC_COLOR);
-  glBlendFunc (GL_DST_COLOR, GL_SRC_COLOR);
-  _vbo.Render ();
-  glDepthFunc (GL_LEQUAL);
-  if (0) {
-    glColor3f (1,0,1);
-    _bbox.Render ();
-  }
-  glEnable (GL_TEXTURE_2D);
-  glEnable (GL_LIGHTING);
-
-}
@@ -10,7 +10,7 @@ enum
 
 
 #ifndef GRID
-#include "cgrid.h"
+#include "CGrid.h"
 #endif
 
 class CGrass : public GridData
@@ -39,6 +39,7 @@ public:
   unsigned          Sizeof () { return sizeof (CGrass); }; 
   void              Set (int origin_x, int origin_y, int distance);
   void              Render ();
+  int               Polygons () { return _index.size () / 4; }
   void              Update (long stop);
   bool              Ready ()  { return _stage == GRASS_STAGE_DONE; };
   void              Invalidate () { _valid = false; };
@@ -0,0 +1,54 @@
+/*-----------------------------------------------------------------------------
+
+  CGrassRender.cpp
+
+-------------------------------------------------------------------------------
+
+  Drawing the grass, which needs a GL context.  The mesh is built in
+  CGrass.cpp, which is part of the core library.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include "CGrass.h"
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void CGrass::Render ()
+{
+
+  //We need at least one successful build before we can draw.
+  if (!_valid)
+    return;
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  glDisable (GL_CULL_FACE);
+  _vbo.Render ();
+  return;
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  glDisable (GL_BLEND);
+  //glEnable (GL_BLEND);
+  //glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  //glDisable (GL_LIGHTING);
+  _vbo.Render ();
+
+  glDisable (GL_TEXTURE_2D);
+  //glDisable (GL_FOG);
+  glDisable (GL_LIGHTING);
+  glDepthFunc (GL_EQUAL);
+  glEnable (GL_BLEND);
+  glBlendFunc (GL_ZERO, GL_SRC_COLOR);
+  glBlendFunc (GL_DST_COLOR, GL_SRC_COLOR);
+  _vbo.Render ();
+  glDepthFunc (GL_LEQUAL);
+  if (0) {
+    glColor3f (1,0,1);
+    _bbox.Render ();
+  }
+  glEnable (GL_TEXTURE_2D);
+  glEnable (GL_LIGHTING);
+
+}
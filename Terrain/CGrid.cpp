@@ -8,7 +8,8 @@
   The grid manager handles various types of objects that make up the world. 
   Terrain, blocks of trees, grass, etc.  It takes tables of GridData objects
   and shuffles them around, rendering them and prioritizing their updates
-  to favor things closest to the player.
+  to favor things closest to the player, and the direction they're moving
+  or looking.
  
 -----------------------------------------------------------------------------*/
 
@@ -26,10 +27,16 @@ struct Dist
 
 #define TABLE_SIZE  32
 #define TABLE_HALF  (TABLE_SIZE / 2)
+//How strongly to favor items ahead of the viewer. At 0.5, something directly
+//ahead is updated as if it was half as far away.
+#define AHEAD_BIAS  0.5f
+//Below this speed, we favor the direction of the camera instead of travel.
+#define AHEAD_SPEED 1.0f
 
 static vector<Dist> distance_list;
 //static vector<Dist> foo2;
 static bool         list_ready;
+static vector<float> order_key;
 
 /*-----------------------------------------------------------------------------
 Here we build a list of offsets.  These are used to walk a grid outward in
@@ -79,6 +86,42 @@ static void do_list ()
 
 }
 
+static int order_sort (const void* elem1, const void* elem2)
+{
+
+  float   k1 = order_key[*(unsigned*)elem1];
+  float   k2 = order_key[*(unsigned*)elem2];
+
+  if (k1 < k2)
+    return -1;
+  else if (k1 > k2)
+    return 1;
+  return 0;
+
+}
+
+//Which way is the viewer headed? Where they're moving, or failing that,
+//where they're looking.
+static GLvector2 do_heading ()
+{
+
+  GLvector    travel, angle;
+  GLvector2   heading;
+  float       speed;
+
+  travel = AvatarVelocity ();
+  heading.x = travel.x;
+  heading.y = travel.y;
+  speed = heading.Length ();
+  if (speed > AHEAD_SPEED)
+    return heading / speed;
+  angle = AvatarCameraAngle ();
+  heading.x = -sin (angle.z * DEGREES_TO_RADIANS);
+  heading.y = -cos (angle.z * DEGREES_TO_RADIANS);
+  return heading;
+
+}
+
 /*-----------------------------------------------------------------------------
 
 -----------------------------------------------------------------------------*/
@@ -125,6 +168,7 @@ void GridManager::Clear ()
   _item_count = 0;
   _last_viewer.Clear ();
   _list_pos = 0;
+  _order.clear ();
 
 }
 
@@ -153,6 +197,7 @@ void GridManager::Init (GridData* itemptr, unsigned grid_size, unsigned item_siz
     else
       break;
   }
+  Order ();
   do {
     gd = Item (walk);
     gd->Invalidate ();
@@ -174,15 +219,102 @@ GLcoord GridManager::ViewPosition (GLvector eye)
 
 }
 
+//Where in our rolling grid is the item at the given offset from the viewer?
+GLcoord GridManager::GridPosition (GLcoord viewer, GLcoord offset)
+{
+
+  GLcoord     grid_pos;
+
+  grid_pos.x = _grid_half + viewer.x % _grid_size;
+  grid_pos.y = _grid_half + viewer.y % _grid_size;
+  grid_pos += offset;
+  //Bring it back into bounds.
+  if (grid_pos.x < 0)
+    grid_pos.x += _grid_size;
+  if (grid_pos.y < 0)
+    grid_pos.y += _grid_size;
+  grid_pos.x %= _grid_size;
+  grid_pos.y %= _grid_size;
+  return grid_pos;
+
+}
+
+/*-----------------------------------------------------------------------------
+Sort the viewable items so the ones ahead of the viewer come up sooner, and 
+the ones behind come up later.  Distance still matters most, so we'll never 
+skip over an item under our feet to build one on the horizon.
+-----------------------------------------------------------------------------*/
+
+void GridManager::Order ()
+{
+
+  GLvector2   heading;
+  GLvector2   to_item;
+  Dist*       d;
+  unsigned    i;
+
+  heading = do_heading ();
+  _order.resize (_view_items);
+  order_key.resize (_view_items);
+  for (i = 0; i < _view_items; i++) {
+    d = &distance_list[i];
+    _order[i] = i;
+    if (d->distancef == 0.0f) {
+      order_key[i] = 0.0f;
+      continue;
+    }
+    to_item.x = (float)d->offset.x / d->distancef;
+    to_item.y = (float)d->offset.y / d->distancef;
+    order_key[i] = d->distancef * (1.0f - AHEAD_BIAS * (to_item.x * heading.x + to_item.y * heading.y));
+  }
+  if (!_order.empty ())
+    qsort (&_order[0], _order.size (), sizeof (unsigned), order_sort);
+
+}
+
+//Is anything right around the viewer, in front of the camera, still unfinished?
+bool GridManager::Stalled ()
+{
+
+  GLcoord     viewer;
+  GLcoord     pos;
+  GLvector2   heading;
+  GLvector    angle;
+  Dist*       d;
+  GridData*   gd;
+  unsigned    i;
+
+  if (!_item)
+    return false;
+  viewer = ViewPosition (AvatarPosition ());
+  angle = AvatarCameraAngle ();
+  heading.x = -sin (angle.z * DEGREES_TO_RADIANS);
+  heading.y = -cos (angle.z * DEGREES_TO_RADIANS);
+  for (i = 0; i < _view_items; i++) {
+    d = &distance_list[i];
+    if (d->distancei > 1)
+      break;
+    if (d->offset.x * heading.x + d->offset.y * heading.y < 0.0f)
+      continue;
+    gd = Item (GridPosition (viewer, d->offset));
+    pos = viewer + d->offset;
+    if (gd->GridPosition () != pos || !gd->Ready ())
+      return true;
+  }
+  return false;
+
+}
+
 void GridManager::Update (long stop)
 {
 
   GLcoord     viewer;
   GLcoord     pos;
   GLcoord     grid_pos;
+  GLcoord     offset;
   unsigned    dist;
 
-  if (!_item)
+  if (!_item || _order.empty ())
     return;
   viewer = ViewPosition (AvatarPosition ());
   //If the player has moved to a new spot on the grid, restart our
@@ -190,37 +322,23 @@ void GridManager::Update (long stop)
   if (viewer != _last_viewer) {
     _last_viewer = viewer;
     _list_pos = 0;
+    Order ();
   }
+  offset = distance_list[_order[_list_pos]].offset;
   //figure out where the player is in our rolling grid
-  grid_pos.x = _grid_half + viewer.x % _grid_size;
-  grid_pos.y = _grid_half + viewer.y % _grid_size;
-  //Now offset that with the position being updated.
-  grid_pos += distance_list[_list_pos].offset;
-  //Bring it back into bounds.
-  if (grid_pos.x < 0)
-    grid_pos.x += _grid_size;
-  if (grid_pos.y < 0)
-    grid_pos.y += _grid_size;
-  grid_pos.x %= _grid_size;
-  grid_pos.y %= _grid_size;
-  pos = Item(grid_pos)->GridPosition ();
-  if (viewer.x - pos.x > (int)_grid_half)
-    pos.x += _grid_size;
-  if (pos.x - viewer.x > (int)_grid_half)
-    pos.x -= _grid_size;
-  if (viewer.y - pos.y > (int)_grid_half)
-    pos.y += _grid_size;
-  if (pos.y - viewer.y > (int)_grid_half)
-    pos.y -= _grid_size;
-  pos = viewer + distance_list[_list_pos].offset;
+  grid_pos = GridPosition (viewer, offset);
+  pos = viewer + offset;
   dist = max (abs (pos.x - viewer.x), abs(pos.y - viewer.y));
   Item(grid_pos)->Set (pos.x, pos.y, dist);
   Item(grid_pos)->Update (stop);
   if (Item(grid_pos)->Ready ()) {
     _list_pos++;
-    //If we reach the outer ring, move back to the center and begin again.
-    if (distance_list[_list_pos].distancei > _grid_half)
+    //If we reach the outer ring, move back to the center and begin again,
+    //taking into account any change in where we're headed.
+    if (_list_pos >= _view_items) {
       _list_pos = 0;
+      Order ();
+    }
   } 
 
 
@@ -33,7 +33,10 @@ protected:
   unsigned              _view_items; //How many items in the table are withing the viewable circle?
   GLcoord               _last_viewer;
   unsigned              _list_pos;
+  vector<unsigned>      _order;      //The viewable part of distance_list, sorted to favor where we're headed.
 
+  GLcoord               GridPosition (GLcoord viewer, GLcoord offset);
+  void                  Order ();
   GLcoord               ViewPosition (GLvector eye);
   GridData*             Item (GLcoord c);
   GridData*             Item (unsigned index);
@@ -46,6 +49,7 @@ public:
   void                  Update (long stop);
   void                  Render ();
   void                  RestartProgress () { _list_pos = 0; };
+  bool                  Stalled ();
 
 };
 
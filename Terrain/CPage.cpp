@@ -11,36 +11,212 @@
   with the region data (modifying the evevation to make the different land
   formations) and then is used to generate the table of surface data, which
   describes how to paint the textures for the given area.
+
+  To keep pages small, each cell property is stored in its own plane, 
+  packed down as far as it will go: elevation as 16-bit fixed point, detail
+  as a byte, normals as an octahedral-mapped pair of bytes, and color as 
+  RGB bytes. 
+
+  Pages also carry a min/max pyramid of their elevations, so rays and range
+  queries can skip over whole blocks of terrain at once.  The bounds cover 
+  the row and column shared with the next page over, so anything 
+  interpolated between cells is guaranteed to lie inside them.
+
+  Normals are computed for the whole page at once, four cells at a time 
+  where SSE is available.  The cells along the edges take their neighbors 
+  from a one-cell apron around the page, sampled straight from the world, 
+  so they match the page next door without having to wait for it.
+
+  Stored, a page is a small header followed by the planes, delta-encoded
+  and packed with the LZ codec.  The header records the world seed and the 
+  generator it was built with, so stale pages are simply rebuilt.  Pages
+  live in the page store (see Store.cpp) and are unpacked straight out of
+  the mapped file.
  
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
-#include "cpage.h"
-#include "ctree.h"
-#include "entropy.h"
-#include "file.h"
-#include "game.h"
-#include "sdl.h"
-#include "world.h"
-
-#define SAVE_INTERVAL     1000
-
-static unsigned     save_cooldown;
+#include "Core.h"
+#include <float.h>
+#include <math.h>
+#include "Cpage.h"
+#include "CTree.h"
+#include "Entropy.h"
+#include "Lz.h"
+#include "Platform.h"
+#include "Store.h"
+#include "World.h"
+
+#if defined (_M_IX86) || defined (_M_X64) || defined (__SSE2__)
+#define PAGE_SSE
+#include <emmintrin.h>
+#endif
+
+#define PAGE_MAGIC        0x47415046 //"FPAG"
+#define PAGE_VERSION      4
+#define PAGE_CELLS        (PAGE_SIZE * PAGE_SIZE)
+//Bytes per cell, across all planes.
+#define PAGE_PLANES       10
+//Size of an unpacked page: the planes, followed by the bounds pyramid.
+#define PAGE_RAW          (PAGE_CELLS * PAGE_PLANES + PYRAMID_NODES * 2 * sizeof (unsigned short))
+
+struct PHeader
+{
+  unsigned    magic;
+  int         version;
+  unsigned    seed;
+  unsigned    generator;
+  GLcoord     origin;
+  GLbbox      bbox;
+  int         packed_size;
+};
 
 /*-----------------------------------------------------------------------------
- 
+  Packing and unpacking of cell values.
 -----------------------------------------------------------------------------*/
 
-static char* page_file_name (GLcoord p)
+static unsigned short elevation_pack (float elevation)
+{
+
+  float   n;
+
+  n = (elevation - ELEVATION_FLOOR) * ELEVATION_STEPS + 0.5f;
+  n = clamp (n, 0.0f, 65535.0f);
+  return (unsigned short)n;
+
+}
+
+//Round down (or up, for a high bound) so the packed value still contains the original.
+static unsigned short bound_pack (float elevation, bool high)
+{
+
+  float   n;
+
+  n = (elevation - ELEVATION_FLOOR) * ELEVATION_STEPS;
+  n = high ? ceil (n) : floor (n);
+  n = clamp (n, 0.0f, 65535.0f);
+  return (unsigned short)n;
+
+}
+
+//Where the given level of the pyramid begins.
+static int bound_offset (int level)
+{
+
+  int     offset;
+  int     size;
+
+  offset = 0;
+  for (size = PYRAMID_BASE; level > 0; level--, size /= 2)
+    offset += size * size;
+  return offset;
+
+}
+
+static float elevation_unpack (unsigned short n)
+{
+
+  return (float)n / ELEVATION_STEPS + ELEVATION_FLOOR;
+
+}
+
+static UCHAR unit_pack (float n)
+{
+
+  n = clamp (n, 0.0f, 1.0f);
+  return (UCHAR)(n * 255.0f + 0.5f);
+
+}
+
+static float unit_unpack (UCHAR n)
+{
+
+  return (float)n / 255.0f;
+
+}
+
+static UCHAR signed_pack (float n)
+{
+
+  return unit_pack (n * 0.5f + 0.5f);
+
+}
+
+static float signed_unpack (UCHAR n)
 {
 
-  static char     name[256];
+  return unit_unpack (n) * 2.0f - 1.0f;
 
-  sprintf (name, "%s//cache%d-%d.pag", GameDirectory (), p.x, p.y);
-  return name;
+}
+
+//Fold the unit sphere onto an octahedron, then unfold that into a square.
+static void normal_pack (GLvector n, UCHAR* out)
+{
+
+  float   sum;
+  float   x, y;
+
+  sum = fabs (n.x) + fabs (n.y) + fabs (n.z);
+  x = n.x / sum;
+  y = n.y / sum;
+  if (n.z < 0.0f) {
+    x = (1.0f - fabs (n.y / sum)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - fabs (n.x / sum)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  out[0] = signed_pack (x);
+  out[1] = signed_pack (y);
 
 }
 
+static GLvector normal_unpack (const UCHAR* in)
+{
+
+  GLvector  n;
+  float     t;
+
+  n.x = signed_unpack (in[0]);
+  n.y = signed_unpack (in[1]);
+  n.z = 1.0f - fabs (n.x) - fabs (n.y);
+  if (n.z < 0.0f) {
+    t = n.x;
+    n.x = (1.0f - fabs (n.y)) * (t >= 0.0f ? 1.0f : -1.0f);
+    n.y = (1.0f - fabs (t)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  n.Normalize ();
+  return n;
+
+}
+
+//Store each value as the difference from the one before it.  Smooth data
+//turns into long runs of small numbers, which compress far better.
+static UCHAR* plane_encode (const UCHAR* src, int stride, UCHAR* out)
+{
+
+  UCHAR   prev;
+  int     i;
+
+  prev = 0;
+  for (i = 0; i < PAGE_CELLS; i++) {
+    out[i] = (UCHAR)(src[i * stride] - prev);
+    prev = src[i * stride];
+  }
+  return out + PAGE_CELLS;
+
+}
+
+static const UCHAR* plane_decode (const UCHAR* in, int stride, UCHAR* dest)
+{
+
+  UCHAR   prev;
+  int     i;
+
+  prev = 0;
+  for (i = 0; i < PAGE_CELLS; i++) {
+    prev += in[i];
+    dest[i * stride] = prev;
+  }
+  return in + PAGE_CELLS;
+
+}
 
 /*-----------------------------------------------------------------------------
  
@@ -49,15 +225,13 @@ static char* page_file_name (GLcoord p)
 SurfaceType CPage::Surface (int x, int y)
 {
 
-  _last_touched = SdlTick ();
-  return (SurfaceType)_cell[x][y].surface;
+  return (SurfaceType)_surface[x][y];
 
 }
 
 bool CPage::Ready ()
 {
 
-  _last_touched = SdlTick ();
   return _stage == PAGE_STAGE_DONE;
 
 }
@@ -65,71 +239,112 @@ bool CPage::Ready ()
 GLvector CPage::Position (int x, int y)
 {
 
-  _last_touched = SdlTick ();
-  return glVector ((float)(x + _origin.x * PAGE_SIZE), (float)(y + _origin.y * PAGE_SIZE), _cell[(x % PAGE_SIZE)][(y % PAGE_SIZE)].elevation);
+  return glVector ((float)(x + _origin.x * PAGE_SIZE), (float)(y + _origin.y * PAGE_SIZE), elevation_unpack (_elevation[x % PAGE_SIZE][y % PAGE_SIZE]));
 
 }
 
 GLvector CPage::Normal (int x, int y)
 {
 
-  _last_touched = SdlTick ();
-  return _cell[(x % PAGE_SIZE)][(y % PAGE_SIZE)].normal;
+  return normal_unpack (_normal[x % PAGE_SIZE][y % PAGE_SIZE]);
 
 }
 
 GLrgba CPage::Color (int x, int y)
 {
 
-  return _cell[(x % PAGE_SIZE)][(y % PAGE_SIZE)].color;
+  UCHAR*  c;
+
+  c = _color[x % PAGE_SIZE][y % PAGE_SIZE];
+  return glRgba (unit_unpack (c[0]), unit_unpack (c[1]), unit_unpack (c[2]));
 
 }
 
-void CPage::Render ()
+unsigned CPage::Tree (int x, int y)
 {
 
-  int     elapsed;
-  float   n;
+  return _tree[x][y];
 
-  glDisable (GL_TEXTURE_2D);
-  glDisable (GL_LIGHTING);
-  elapsed = SdlTick () - _last_touched;
-  n = (float)elapsed / PAGE_EXPIRE;
-  n = clamp (n, 0.0f, 1.0f);
-  glColor3f (n, 1.0f - n, 0.0f);
-  _bbox.Render ();
+}
+
+float CPage::Elevation (int x, int y)
+{
+
+  return elevation_unpack (_elevation[x][y]);
 
 }
 
+float CPage::Detail (int x, int y)
+{
 
-unsigned CPage::Tree (int x, int y)
+  return unit_unpack (_detail[x][y]);
+
+}
+
+/*-----------------------------------------------------------------------------
+  Span copies.  The planes are laid out [x][y], so a run along y is 
+  contiguous in memory.
+-----------------------------------------------------------------------------*/
+
+void CPage::ElevationSpan (int x, int y, int count, float* out)
 {
 
-  _last_touched = SdlTick ();
-  return _cell[x][y].tree_id;
+  const unsigned short* src;
+  int                   i;
+
+  src = &_elevation[x][y];
+  for (i = 0; i < count; i++)
+    out[i] = (float)src[i] * (1.0f / ELEVATION_STEPS) + ELEVATION_FLOOR;
 
 }
 
-float CPage::Elevation (int x, int y)
+void CPage::NormalSpan (int x, int y, int count, GLvector* out)
 {
 
-  _last_touched = SdlTick ();
-  return _cell[x][y].elevation;
+  int     i;
+
+  for (i = 0; i < count; i++)
+    out[i] = normal_unpack (_normal[x][y + i]);
 
 }
 
-float CPage::Detail (int x, int y)
+void CPage::ColorSpan (int x, int y, int count, GLrgba* out)
 {
 
-  _last_touched = SdlTick ();
-  return _cell[x][y].detail;
+  const UCHAR*  src;
+  int           i;
+
+  src = _color[x][y];
+  for (i = 0; i < count; i++) {
+    out[i].red = src[i * 3] * (1.0f / 255.0f);
+    out[i].green = src[i * 3 + 1] * (1.0f / 255.0f);
+    out[i].blue = src[i * 3 + 2] * (1.0f / 255.0f);
+    out[i].alpha = 1.0f;
+  }
 
 }
 
-bool CPage::Expired ()
+void CPage::SurfaceSpan (int x, int y, int count, SurfaceType* out)
 {
 
-  return (_last_touched + PAGE_EXPIRE) < SdlTick ();
+  const UCHAR*  src;
+  int           i;
+
+  src = &_surface[x][y];
+  for (i = 0; i < count; i++)
+    out[i] = (SurfaceType)src[i];
+
+}
+
+void CPage::TreeSpan (int x, int y, int count, unsigned* out)
+{
+
+  const UCHAR*  src;
+  int           i;
+
+  src = &_tree[x][y];
+  for (i = 0; i < count; i++)
+    out[i] = src[i];
 
 }
 
@@ -137,18 +352,122 @@ void CPage::DoPosition ()
 {
 
   int     world_x, world_y;
-  Cell    c;
+  int     x, y;
+  Cell    cells[PAGE_SIZE];
+  Cell*   c;
+
+  world_y = _origin.y * PAGE_SIZE;
+  for (x = 0; x < PAGE_SIZE; x++) {
+    world_x = _origin.x * PAGE_SIZE + x;
+    WorldCells (world_x, world_y, PAGE_SIZE, cells);
+    for (y = 0; y < PAGE_SIZE; y++) {
+      c = &cells[y];
+      _scratch->elevation[x][y] = c->elevation;
+      _scratch->detail[x][y] = c->detail;
+      _scratch->water_level[x][y] = c->water_level;
+      _elevation[x][y] = elevation_pack (c->elevation);
+      _detail[x][y] = unit_pack (c->detail);
+      _bbox.ContainPoint (glVector ((float)world_x, (float)(world_y + y), c->elevation));
+    }
+  }
+  memset (_tree, 0, sizeof (_tree));
+  DoApron ();
+  DoBounds ();
+  _stage++;
 
-  world_x = (_origin.x * PAGE_SIZE + _walk.x);
-  world_y = (_origin.y * PAGE_SIZE + _walk.y);
-  c = WorldCell (world_x, world_y);
-  _cell[_walk.x][_walk.y].elevation = c.elevation;
-  _cell[_walk.x][_walk.y].detail = c.detail;
-  _cell[_walk.x][_walk.y].water_level = c.water_level;
-  _cell[_walk.x][_walk.y].tree_id = 0;
-  _bbox.ContainPoint (Position (world_x, world_y));
-  if (_walk.Walk (PAGE_SIZE))
-    _stage++;
+}
+
+//Sample the ring of cells just outside the page.
+void CPage::DoApron ()
+{
+
+  int     world_x, world_y;
+  int     i;
+  Cell    cells[PAGE_SIZE + 1];
+
+  world_x = _origin.x * PAGE_SIZE;
+  world_y = _origin.y * PAGE_SIZE;
+  //The east and west sides run along y, so they can be done as spans.
+  WorldCells (world_x - 1, world_y, PAGE_SIZE, cells);
+  for (i = 0; i < PAGE_SIZE; i++)
+    _scratch->apron_west[i] = cells[i].elevation;
+  WorldCells (world_x + PAGE_SIZE, world_y, PAGE_SIZE + 1, cells);
+  for (i = 0; i <= PAGE_SIZE; i++)
+    _scratch->apron_east[i] = cells[i].elevation;
+  for (i = 0; i < PAGE_SIZE; i++) {
+    _scratch->apron_south[i] = WorldCell (world_x + i, world_y - 1).elevation;
+    _scratch->apron_north[i] = WorldCell (world_x + i, world_y + PAGE_SIZE).elevation;
+  }
+
+}
+
+/*-----------------------------------------------------------------------------
+  Build the pyramid of elevation bounds.  Each block includes the cells along
+  its far edges, so for the last row and column we use the apron.
+-----------------------------------------------------------------------------*/
+
+void CPage::DoBounds ()
+{
+
+  int       x, y, bx, by;
+  int       level, size, offset, below;
+  float     e, low, high;
+  unsigned short* b;
+  unsigned short* child;
+
+  for (bx = 0; bx < PYRAMID_BASE; bx++) {
+    for (by = 0; by < PYRAMID_BASE; by++) {
+      low = FLT_MAX;
+      high = -FLT_MAX;
+      for (x = bx * PYRAMID_LEAF; x <= (bx + 1) * PYRAMID_LEAF; x++) {
+        for (y = by * PYRAMID_LEAF; y <= (by + 1) * PYRAMID_LEAF; y++) {
+          if (x == PAGE_SIZE)
+            e = _scratch->apron_east[y];
+          else if (y == PAGE_SIZE)
+            e = _scratch->apron_north[x];
+          else
+            e = _scratch->elevation[x][y];
+          low = min (low, e);
+          high = max (high, e);
+        }
+      }
+      b = _bound[bx * PYRAMID_BASE + by];
+      b[0] = bound_pack (low, false);
+      b[1] = bound_pack (high, true);
+    }
+  }
+  //Each level up takes the extremes of the four blocks beneath it.
+  below = 0;
+  offset = PYRAMID_BASE * PYRAMID_BASE;
+  for (level = 1, size = PYRAMID_BASE / 2; level < PYRAMID_LEVELS; level++, size /= 2) {
+    for (bx = 0; bx < size; bx++) {
+      for (by = 0; by < size; by++) {
+        b = _bound[offset + bx * size + by];
+        b[0] = 65535;
+        b[1] = 0;
+        for (x = 0; x < 2; x++) {
+          for (y = 0; y < 2; y++) {
+            child = _bound[below + (bx * 2 + x) * size * 2 + by * 2 + y];
+            b[0] = min (b[0], child[0]);
+            b[1] = max (b[1], child[1]);
+          }
+        }
+      }
+    }
+    below = offset;
+    offset += size * size;
+  }
+
+}
+
+void CPage::Bounds (int level, int x, int y, float* low, float* high)
+{
+
+  unsigned short* b;
+
+  b = _bound[bound_offset (level) + x * (PYRAMID_BASE >> level) + y];
+  *low = elevation_unpack (b[0]);
+  *high = elevation_unpack (b[1]);
 
 }
 
@@ -156,59 +475,228 @@ void CPage::DoColor ()
 {
 
   int     world_x, world_y;
+  UCHAR   surface;
+  GLrgba  color;
+  UCHAR*  c;
 
   world_x = (_origin.x * PAGE_SIZE + _walk.x);
   world_y = (_origin.y * PAGE_SIZE + _walk.y);
-  if (_cell[_walk.x][_walk.y].surface == SURFACE_GRASS || _cell[_walk.x][_walk.y].surface == SURFACE_GRASS_EDGE)
-    _cell[_walk.x][_walk.y].color = WorldColorGet (world_x, world_y, SURFACE_COLOR_GRASS);
-  else if (_cell[_walk.x][_walk.y].surface == SURFACE_DIRT || _cell[_walk.x][_walk.y].surface == SURFACE_DIRT_DARK || _cell[_walk.x][_walk.y].surface == SURFACE_FOREST)
-    _cell[_walk.x][_walk.y].color = WorldColorGet (world_x, world_y, SURFACE_COLOR_DIRT);
-  else if (_cell[_walk.x][_walk.y].surface == SURFACE_SAND || _cell[_walk.x][_walk.y].surface == SURFACE_SAND_DARK)
-    _cell[_walk.x][_walk.y].color = WorldColorGet (world_x, world_y, SURFACE_COLOR_SAND);
-  else if (_cell[_walk.x][_walk.y].surface == SURFACE_SNOW)
-    _cell[_walk.x][_walk.y].color = glRgba (1.0f, 1.0f, 1.0f);
+  surface = _surface[_walk.x][_walk.y];
+  if (surface == SURFACE_GRASS || surface == SURFACE_GRASS_EDGE)
+    color = WorldColorGet (world_x, world_y, SURFACE_COLOR_GRASS);
+  else if (surface == SURFACE_DIRT || surface == SURFACE_DIRT_DARK || surface == SURFACE_FOREST)
+    color = WorldColorGet (world_x, world_y, SURFACE_COLOR_DIRT);
+  else if (surface == SURFACE_SAND || surface == SURFACE_SAND_DARK)
+    color = WorldColorGet (world_x, world_y, SURFACE_COLOR_SAND);
+  else if (surface == SURFACE_SNOW)
+    color = glRgba (1.0f, 1.0f, 1.0f);
   else 
-    _cell[_walk.x][_walk.y].color = WorldColorGet (world_x, world_y, SURFACE_COLOR_ROCK);
+    color = WorldColorGet (world_x, world_y, SURFACE_COLOR_ROCK);
+  c = _color[_walk.x][_walk.y];
+  c[0] = unit_pack (color.red);
+  c[1] = unit_pack (color.green);
+  c[2] = unit_pack (color.blue);
   if (_walk.Walk (PAGE_SIZE))
     _stage++;
 
 }
 
 
-void CPage::DoNormal ()
+/*-----------------------------------------------------------------------------
+  Normals.  These give the same normal as the original cell-at-a-time code
+  (normal_reference, below), which took the cross product of a two cell 
+  step along x and a one cell step along y.  Worked through, that comes to 
+  this (unnormalized) normal:
+
+    (west - east, 2 * (south - north), 2 * NORMAL_SCALING)
+
+  The octahedral packing divides through by the sum of the components, so 
+  there's no need to normalize it first.  Z is always positive, which also
+  means we never need the fold for the lower hemisphere.
+
+  Each row along y is done in one go.  The rows on either side come from 
+  the page, or from the apron at the west and east edges.  The row itself is 
+  copied out with its south and north apron cells on the ends, so the y 
+  neighbors are just the same row shifted by one.
+-----------------------------------------------------------------------------*/
+
+//One cell at a time.  This is what we use without SSE2, and what the SSE2 
+//version is checked against.
+static void normal_row_scalar (const float* west, const float* row, const float* east, UCHAR (*out)[2])
+{
+
+  const float   nz = 2.0f * NORMAL_SCALING;
+  float         dx, dy, sum;
+  int           y;
+
+  for (y = 0; y < PAGE_SIZE; y++) {
+    dx = west[y] - east[y];
+    dy = row[y] - row[y + 2];
+    dy += dy;
+    sum = 127.5f / ((float)fabs (dx) + (float)fabs (dy) + nz);
+    out[y][0] = (UCHAR)clamp (dx * sum + 128.0f, 0.0f, 255.0f);
+    out[y][1] = (UCHAR)clamp (dy * sum + 128.0f, 0.0f, 255.0f);
+  }
+
+}
+
+static void normal_row (const float* west, const float* row, const float* east, UCHAR (*out)[2])
 {
 
-  GLvector        normal_y, normal_x;
-  float           world_x, world_y;
+#ifdef PAGE_SSE
+  const float   nz = 2.0f * NORMAL_SCALING;
+  int           y;
+  const __m128  sign = _mm_castsi128_ps (_mm_set1_epi32 (0x7fffffff));
+  const __m128  z = _mm_set1_ps (nz);
+  const __m128  scale = _mm_set1_ps (127.5f);
+  const __m128  bias = _mm_set1_ps (128.0f);
+  __m128        dx, dy, sum;
+  __m128i       px, py;
+
+  for (y = 0; y < PAGE_SIZE; y += 4) {
+    dx = _mm_sub_ps (_mm_loadu_ps (west + y), _mm_loadu_ps (east + y));
+    dy = _mm_sub_ps (_mm_loadu_ps (row + y), _mm_loadu_ps (row + y + 2));
+    dy = _mm_add_ps (dy, dy);
+    sum = _mm_add_ps (_mm_add_ps (_mm_and_ps (dx, sign), _mm_and_ps (dy, sign)), z);
+    sum = _mm_div_ps (scale, sum);
+    px = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (dx, sum), bias));
+    py = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (dy, sum), bias));
+    //Saturate down to bytes, then interleave into x,y pairs.
+    px = _mm_packus_epi16 (_mm_packs_epi32 (px, px), px);
+    py = _mm_packus_epi16 (_mm_packs_epi32 (py, py), py);
+    _mm_storel_epi64 ((__m128i*)out[y], _mm_unpacklo_epi8 (px, py));
+  }
+#else
+  normal_row_scalar (west, row, east, out);
+#endif
 
-  world_x = (float)(_origin.x + _walk.x);
-  world_y = (float)(_origin.y + _walk.y);
-  if (_walk.x < 1 || _walk.x >= PAGE_SIZE - 1) 
+}
+
+static void normal_page (float (*elevation)[PAGE_SIZE], const pscratch* apron, UCHAR (*out)[PAGE_SIZE][2], bool scalar)
+{
+
+  float         row[PAGE_SIZE + 2];
+  const float*  west;
+  const float*  east;
+  int           x;
+
+  for (x = 0; x < PAGE_SIZE; x++) {
+    west = x > 0 ? elevation[x - 1] : apron->apron_west;
+    east = x < PAGE_SIZE - 1 ? elevation[x + 1] : apron->apron_east;
+    row[0] = apron->apron_south[x];
+    memcpy (row + 1, elevation[x], sizeof (float) * PAGE_SIZE);
+    row[PAGE_SIZE + 1] = apron->apron_north[x];
+    if (scalar)
+      normal_row_scalar (west, row, east, out[x]);
+    else
+      normal_row (west, row, east, out[x]);
+  }
+
+}
+
+//The way normals used to be done, one cell at a time. Kept for NormalBenchmark.
+static void normal_reference (float (*elevation)[PAGE_SIZE], int x, int y, UCHAR* out)
+{
+
+  GLvector        normal_y, normal_x, normal;
+
+  if (x < 1 || x >= PAGE_SIZE - 1) 
     normal_x = glVector (-1, 0, 0);
   else
-    normal_x = glVector (world_x - 1, world_y, _cell[_walk.x - 1][_walk.y].elevation) -
-      glVector (world_x + 1, world_y, _cell[_walk.x + 1][_walk.y].elevation);
-  if (_walk.y < 1 || _walk.y >= PAGE_SIZE - 1) 
+    normal_x = glVector ((float)x - 1, (float)y, elevation[x - 1][y]) -
+      glVector ((float)x + 1, (float)y, elevation[x + 1][y]);
+  if (y < 1 || y >= PAGE_SIZE - 1) 
     normal_y = glVector (0, -1, 0);
   else
-    normal_y = glVector (world_x, world_y - 1, _cell[_walk.x][_walk.y - 1].elevation) -
-      glVector (world_x, world_y, _cell[_walk.x][_walk.y + 1].elevation);
-  _cell[_walk.x][_walk.y].normal = glVectorCrossProduct (normal_x, normal_y);
-  _cell[_walk.x][_walk.y].normal.z *= NORMAL_SCALING;
-  _cell[_walk.x][_walk.y].normal.Normalize ();
-  if (_walk.Walk (PAGE_SIZE))
-    _stage++;
+    normal_y = glVector ((float)x, (float)y - 1, elevation[x][y - 1]) -
+      glVector ((float)x, (float)y, elevation[x][y + 1]);
+  normal = glVectorCrossProduct (normal_x, normal_y);
+  normal.z *= NORMAL_SCALING;
+  normal.Normalize ();
+  normal_pack (normal, out);
 
 }
 
+void CPage::DoNormal ()
+{
+
+  normal_page (_scratch->elevation, _scratch, _normal, false);
+  _stage++;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Time the cell-at-a-time path against the row kernel on this page, and 
+  check them against each other.  scalar_differ counts the cells where the 
+  kernel and the plain C version of it disagree, which should be none.  
+  reference_differ counts the cells where the kernel is more than one step 
+  off from the original, ignoring the edges, where the original didn't have
+  neighbors to work with.  Rounding through the normalize in the original
+  accounts for differences of one step.
+-----------------------------------------------------------------------------*/
+
+void CPage::NormalBenchmark (int passes, double* reference, double* kernel, int* scalar_differ, int* reference_differ)
+{
+
+  pscratch*       s;
+  UCHAR           (*out)[PAGE_SIZE][2];
+  UCHAR           (*ref)[PAGE_SIZE][2];
+  UCHAR           (*scalar)[PAGE_SIZE][2];
+  double          start;
+  int             i, x, y;
+
+  s = new pscratch;
+  out = new UCHAR[PAGE_SIZE][PAGE_SIZE][2];
+  ref = new UCHAR[PAGE_SIZE][PAGE_SIZE][2];
+  scalar = new UCHAR[PAGE_SIZE][PAGE_SIZE][2];
+  for (x = 0; x < PAGE_SIZE; x++)
+    ElevationSpan (x, 0, PAGE_SIZE, s->elevation[x]);
+  //We don't have the real apron any more, so just repeat the edges.
+  for (i = 0; i < PAGE_SIZE; i++) {
+    s->apron_west[i] = s->elevation[0][i];
+    s->apron_east[i] = s->elevation[PAGE_SIZE - 1][i];
+    s->apron_south[i] = s->elevation[i][0];
+    s->apron_north[i] = s->elevation[i][PAGE_SIZE - 1];
+  }
+  start = PlatformSeconds ();
+  for (i = 0; i < passes; i++) {
+    for (x = 0; x < PAGE_SIZE; x++) {
+      for (y = 0; y < PAGE_SIZE; y++)
+        normal_reference (s->elevation, x, y, ref[x][y]);
+    }
+  }
+  *reference = PlatformSeconds () - start;
+  start = PlatformSeconds ();
+  for (i = 0; i < passes; i++)
+    normal_page (s->elevation, s, out, false);
+  *kernel = PlatformSeconds () - start;
+  normal_page (s->elevation, s, scalar, true);
+  *scalar_differ = *reference_differ = 0;
+  for (x = 0; x < PAGE_SIZE; x++) {
+    for (y = 0; y < PAGE_SIZE; y++) {
+      if (out[x][y][0] != scalar[x][y][0] || out[x][y][1] != scalar[x][y][1])
+        (*scalar_differ)++;
+      if (x < 1 || x >= PAGE_SIZE - 1 || y < 1 || y >= PAGE_SIZE - 1)
+        continue;
+      if (abs (out[x][y][0] - ref[x][y][0]) > 1 || abs (out[x][y][1] - ref[x][y][1]) > 1)
+        (*reference_differ)++;
+    }
+  }
+  delete[] scalar;
+  delete[] ref;
+  delete[] out;
+  delete s;
+
+}
 
 void CPage::DoTrees ()
 {
 
   GLcoord   worldpos;
   Region    region;
-  pcell*    c;
   int       x, y;
+  int       cx, cy;
+  float     elevation, detail;
   GLcoord   plant;
   bool      valid;
   float     best;
@@ -226,135 +714,406 @@ void CPage::DoTrees ()
     best = 99999.9f;
   for (x = 0; x < TREE_SPACING - 2; x++) {
     for (y = 0; y < TREE_SPACING - 2; y++) {
-      c = &_cell[_walk.x * TREE_SPACING + x][_walk.y * TREE_SPACING + y];
-      if (c->surface != SURFACE_GRASS && c->surface != SURFACE_SNOW && c->surface != SURFACE_FOREST)
+      cx = _walk.x * TREE_SPACING + x;
+      cy = _walk.y * TREE_SPACING + y;
+      if (_surface[cx][cy] != SURFACE_GRASS && _surface[cx][cy] != SURFACE_SNOW && _surface[cx][cy] != SURFACE_FOREST)
         continue;
+      elevation = _scratch->elevation[cx][cy];
       //Don't spawn trees that might touch water.  Looks odd.
-      if (c->elevation < c->water_level + 1.2f)
+      if (elevation < _scratch->water_level[cx][cy] + 1.2f)
         continue;
-      if (tree->GrowsHigh() && (c->detail + region.tree_threshold) > 1.0f && c->elevation > best) {
+      detail = _scratch->detail[cx][cy];
+      if (tree->GrowsHigh() && (detail + region.tree_threshold) > 1.0f && elevation > best) {
         plant.x = _walk.x * TREE_SPACING + x;
         plant.y = _walk.y * TREE_SPACING + y;
-        best = c->elevation;
+        best = elevation;
         valid = true;
       }
-      if (!tree->GrowsHigh() && (c->detail - region.tree_threshold) < 0.0f && c->elevation < best) {
+      if (!tree->GrowsHigh() && (detail - region.tree_threshold) < 0.0f && elevation < best) {
         plant.x = _walk.x * TREE_SPACING + x;
         plant.y = _walk.y * TREE_SPACING + y;
-        best = c->elevation;
+        best = elevation;
         valid = true;
       }
     }
   }
-  if (valid) {
-    c = &_cell[plant.x][plant.y];
-    c->tree_id = region.tree_type;
-  }
+  if (valid) 
+    _tree[plant.x][plant.y] = (UCHAR)region.tree_type;
   if (_walk.Walk (TREE_MAP))
     _stage++;
 
 }
 
 
-void CPage::DoSurface ()
+/*-----------------------------------------------------------------------------
+  Surfaces.  The first pass finds the lowest and highest point around each 
+  cell, then classifies every cell on the page.  The second pass turns the 
+  edges of grassy areas into grass edges.
+
+  The neighborhood search uses the van Herk / Gil-Werman trick: split the 
+  line into blocks the size of the window, and take running extremes forward
+  and backward within each block.  Any window then spans at most two 
+  blocks, so its extremes are one compare away, no matter how wide it is.  
+  Doing the rows and then the columns gives us the full square.  Cells off 
+  the edge of the page are ignored, same as they always have been.
+-----------------------------------------------------------------------------*/
+
+#define SURFACE_RADIUS    2
+#define SURFACE_WINDOW    (SURFACE_RADIUS * 2 + 1)
+//The line, padded at both ends, and rounded up to a whole number of windows.
+#define SURFACE_LINE      (((PAGE_SIZE + SURFACE_RADIUS * 2 + SURFACE_WINDOW - 1) / SURFACE_WINDOW) * SURFACE_WINDOW)
+
+//Climate properties that matter to the surface.
+#define CF_SHORE          1
+#define CF_FOREST         2
+#define CF_SWAMP          4
+#define CF_DESERT         8
+
+static const UCHAR  climate_flags[CLIMATE_TYPES] = 
+{
+  0,              //CLIMATE_INVALID
+  CF_SHORE,       //CLIMATE_OCEAN
+  CF_SHORE,       //CLIMATE_COAST
+  0,              //CLIMATE_MOUNTAIN
+  0,              //CLIMATE_RIVER
+  0,              //CLIMATE_RIVER_BANK
+  CF_SWAMP,       //CLIMATE_SWAMP
+  0,              //CLIMATE_ROCKY
+  0,              //CLIMATE_LAKE
+  CF_DESERT,      //CLIMATE_DESERT
+  0,              //CLIMATE_FIELD
+  0,              //CLIMATE_PLAINS
+  0,              //CLIMATE_CANYON
+  CF_FOREST,      //CLIMATE_FOREST
+};
+
+//Everything about a region that the surface depends on, worked out once
+//per region instead of once per cell.  Thresholds that don't apply to a 
+//region are set so the comparison can never pass.
+struct SurfaceRule
+{
+  GLcoord   region;
+  UCHAR     base;
+  bool      forest;
+  bool      wet;
+  bool      desert;
+  float     dirt_delta;
+  float     dark_low;
+  float     snow_fade;
+  float     sand_low;
+  float     rock_delta;
+};
+
+#define SURFACE_RULES     16
+
+static void surface_rule (GLcoord pos, SurfaceRule* r)
 {
 
-  float     high, low, delta;
-  float     fade;
-  int       xx, yy;
-  int       neighbor_x, neighbor_y;
-  GLcoord   worldpos;
   Region    region;
-  pcell*    c;
+  UCHAR     flags;
+
+  region = WorldRegionGet (pos.x, pos.y);
+  flags = climate_flags[region.climate];
+  r->region = pos;
+  //Default surface. If the climate can support life, default to grass.
+  if (flags & CF_DESERT)
+    r->base = SURFACE_SAND;
+  else if (region.temperature > 0.1f && region.moisture > 0.1f)
+    r->base = SURFACE_GRASS;
+  else //Too cold or dry
+    r->base = SURFACE_ROCK;
+  r->forest = (flags & CF_FOREST) != 0;
+  r->wet = (flags & CF_SWAMP) == 0;
+  r->desert = (flags & CF_DESERT) != 0;
+  r->dirt_delta = region.moisture * 6;
+  r->dark_low = r->wet ? region.geo_water : -FLT_MAX;
+  //The colder it is, the more surface becomes snow, beginning at the lowest points.
+  r->snow_fade = region.temperature < FREEZING ? region.temperature / FREEZING : FLT_MAX;
+  r->sand_low = (flags & CF_SHORE) ? 2.5f : -FLT_MAX;
+  r->rock_delta = region.temperature > 0.0f ? 4.0f : FLT_MAX;
 
-  worldpos.x = _origin.x * PAGE_SIZE + _walk.x;
-  worldpos.y = _origin.y * PAGE_SIZE + _walk.y;
-  region = WorldRegionFromPosition (worldpos.x, worldpos.y);
-  c = &_cell[_walk.x][_walk.y];
-  if (_stage == PAGE_STAGE_SURFACE1) {
-    //Get the elevation of our neighbors
-    high = low = c->elevation;
-    for (xx = -2; xx <= 2; xx++) {
-      neighbor_x = _walk.x + xx;
-      if (neighbor_x < 0 || neighbor_x >= PAGE_SIZE) 
-        continue;
-      for (yy = -2; yy <= 2; yy++) {
-        neighbor_y = _walk.y + yy;
-        if (neighbor_y < 0 || neighbor_y >= PAGE_SIZE) 
-          continue;
-        high = max (high, _cell[neighbor_x][neighbor_y].elevation);
-        low = min (low, _cell[neighbor_x][neighbor_y].elevation);
-      }
+}
+
+static UCHAR surface_classify (const SurfaceRule* r, float low, float high, float detail, float water_level)
+{
+
+  float   delta;
+  UCHAR   s;
+
+  delta = high - low;
+  s = r->base;
+  //Forests are for... forests?
+  if (r->forest && detail < 0.75f && detail > 0.25f)
+    s = SURFACE_FOREST;
+  if (delta >= r->dirt_delta)
+    s = SURFACE_DIRT;
+  if (low <= r->dark_low)
+    s = SURFACE_DIRT_DARK;
+  if ((1.0f - detail) > r->snow_fade)
+    s = SURFACE_SNOW;
+  //Sand is only for coastal regions
+  if (low <= r->sand_low)
+    s = SURFACE_SAND;
+  //dirt touched by water is dark
+  if (r->wet) {
+    if (s == SURFACE_SAND && low <= 0)
+      s = SURFACE_SAND_DARK;
+    if (low <= water_level)
+      s = SURFACE_DIRT_DARK;
+  }
+  if (delta > r->rock_delta)
+    s = SURFACE_ROCK;
+  if (r->desert && s != SURFACE_ROCK)
+    s = SURFACE_SAND;
+  return s;
+
+}
+
+//Sliding window extremes along one line of the page. Input and output may overlap.
+static void line_extremes (const float* src_low, const float* src_high, int stride, float* low, float* high)
+{
+
+  float   v_low[SURFACE_LINE], v_high[SURFACE_LINE];
+  float   fwd_low[SURFACE_LINE], fwd_high[SURFACE_LINE];
+  float   back_low[SURFACE_LINE], back_high[SURFACE_LINE];
+  int     i, cell;
+
+  for (i = 0; i < SURFACE_LINE; i++) {
+    cell = i - SURFACE_RADIUS;
+    if (cell < 0 || cell >= PAGE_SIZE) {
+      v_low[i] = FLT_MAX;
+      v_high[i] = -FLT_MAX;
+    } else {
+      v_low[i] = src_low[cell * stride];
+      v_high[i] = src_high[cell * stride];
     }
-    delta = high - low;
-    //Default surface. If the climate can support life, default to grass.
-    if (region.temperature > 0.1f && region.moisture > 0.1f)
-      c->surface = SURFACE_GRASS;
-    else //Too cold or dry
-      c->surface = SURFACE_ROCK;
-    if (region.climate == CLIMATE_DESERT)
-      c->surface = SURFACE_SAND;
-    //Sand is only for coastal regions
-    if (low <= 2.0f && (region.climate == CLIMATE_COAST))
-      c->surface = SURFACE_SAND;
-    if (low <= 2.0f && (region.climate == CLIMATE_OCEAN))
-      c->surface = SURFACE_SAND;
-    //Forests are for... forests?
-    if (c->detail < 0.75f && c->detail > 0.25f && (region.climate == CLIMATE_FOREST))
-      c->surface = SURFACE_FOREST;
-    if (delta >= region.moisture * 6)
-      c->surface = SURFACE_DIRT;
-    if (low <= region.geo_water && region.climate != CLIMATE_SWAMP)
-      c->surface = SURFACE_DIRT;
-    if (low <= region.geo_water && region.climate != CLIMATE_SWAMP)
-      c->surface = SURFACE_DIRT_DARK;
-    //The colder it is, the more surface becomes snow, beginning at the lowest points.
-    if (region.temperature < FREEZING) {
-      fade = region.temperature / FREEZING;
-      if ((1.0f - c->detail) > fade)
-        c->surface = SURFACE_SNOW;
+  }
+  for (i = 0; i < SURFACE_LINE; i++) {
+    if (i % SURFACE_WINDOW == 0) {
+      fwd_low[i] = v_low[i];
+      fwd_high[i] = v_high[i];
+    } else {
+      fwd_low[i] = min (fwd_low[i - 1], v_low[i]);
+      fwd_high[i] = max (fwd_high[i - 1], v_high[i]);
     }
-    if (low <= 2.5f && (region.climate == CLIMATE_OCEAN))
-      c->surface = SURFACE_SAND;
-    if (low <= 2.5f && (region.climate == CLIMATE_COAST))
-      c->surface = SURFACE_SAND;
-    //dirt touched by water is dark
-    if (region.climate != CLIMATE_SWAMP) {
-      if (c->surface == SURFACE_SAND && low <= 0)
-        c->surface = SURFACE_SAND_DARK;
-      if (low <= c->water_level)
-        c->surface = SURFACE_DIRT_DARK;
+  }
+  for (i = SURFACE_LINE - 1; i >= 0; i--) {
+    if (i % SURFACE_WINDOW == SURFACE_WINDOW - 1) {
+      back_low[i] = v_low[i];
+      back_high[i] = v_high[i];
+    } else {
+      back_low[i] = min (back_low[i + 1], v_low[i]);
+      back_high[i] = max (back_high[i + 1], v_high[i]);
     }
-    if (delta > 4.0f && region.temperature > 0.0f)
-      c->surface = SURFACE_ROCK;
-    if ((region.climate == CLIMATE_DESERT) && c->surface != SURFACE_ROCK)
-      c->surface = SURFACE_SAND;
-  } else {
-    if (c->surface == SURFACE_GRASS && _walk.x > 0 && _walk.x < PAGE_SIZE - 1 && _walk.y > 0 && _walk.y < PAGE_SIZE - 1) {  
-      bool all_grass = true;
-      for (xx = -1; xx <= 1; xx++) {
-        if (!all_grass)
-          break;
-        for (yy = -1; yy <= 1; yy++) {
-          if (_cell[_walk.x + xx][_walk.y + yy].surface != SURFACE_GRASS && _cell[_walk.x + xx][_walk.y + yy].surface != SURFACE_GRASS_EDGE) {
-            all_grass = false;
-            break;
+  }
+  //The window for a cell starts at its own index in the padded line.
+  for (cell = 0; cell < PAGE_SIZE; cell++) {
+    low[cell * stride] = min (back_low[cell], fwd_low[cell + SURFACE_WINDOW - 1]);
+    high[cell * stride] = max (back_high[cell], fwd_high[cell + SURFACE_WINDOW - 1]);
+  }
+
+}
+
+void CPage::DoSurface ()
+{
+
+  SurfaceRule   rules[SURFACE_RULES];
+  SurfaceRule*  rule;
+  int           rule_count, rule_next;
+  GLcoord       region;
+  UCHAR         grassy[PAGE_SIZE][PAGE_SIZE];
+  UCHAR         s;
+  int           x, y, i;
+
+  if (_stage == PAGE_STAGE_SURFACE1) {
+    //Get the elevation of our neighbors. Rows first, then columns.
+    for (x = 0; x < PAGE_SIZE; x++) 
+      line_extremes (_scratch->elevation[x], _scratch->elevation[x], 1, _scratch->low[x], _scratch->high[x]);
+    for (y = 0; y < PAGE_SIZE; y++) 
+      line_extremes (&_scratch->low[0][y], &_scratch->high[0][y], PAGE_SIZE, &_scratch->low[0][y], &_scratch->high[0][y]);
+    rule_count = rule_next = 0;
+    rule = NULL;
+    for (x = 0; x < PAGE_SIZE; x++) {
+      for (y = 0; y < PAGE_SIZE; y++) {
+        region = WorldRegionCoord (_origin.x * PAGE_SIZE + x, _origin.y * PAGE_SIZE + y);
+        //Neighboring cells are almost always in the same region as the last one.
+        if (!rule || rule->region != region) {
+          for (i = 0, rule = NULL; i < rule_count; i++) {
+            if (rules[i].region == region) {
+              rule = &rules[i];
+              break;
+            }
+          }
+          if (!rule) {
+            rule = &rules[rule_next++ % SURFACE_RULES];
+            rule_count = min (rule_count + 1, SURFACE_RULES);
+            surface_rule (region, rule);
           }
         }
+        _surface[x][y] = surface_classify (rule, _scratch->low[x][y], _scratch->high[x][y], 
+          _scratch->detail[x][y], _scratch->water_level[x][y]);
+      }
+    }
+  } else {
+    //Grass that borders anything but grass becomes a grass edge. 
+    for (x = 0; x < PAGE_SIZE; x++) {
+      for (y = 0; y < PAGE_SIZE; y++) 
+        grassy[x][y] = _surface[x][y] == SURFACE_GRASS;
+    }
+    for (x = 1; x < PAGE_SIZE - 1; x++) {
+      for (y = 1; y < PAGE_SIZE - 1; y++) {
+        if (!grassy[x][y])
+          continue;
+        s = grassy[x - 1][y - 1] & grassy[x - 1][y] & grassy[x - 1][y + 1] &
+          grassy[x][y - 1] & grassy[x][y + 1] &
+          grassy[x + 1][y - 1] & grassy[x + 1][y] & grassy[x + 1][y + 1];
+        if (!s)
+          _surface[x][y] = SURFACE_GRASS_EDGE;
       }
-      if (!all_grass)
-        c->surface = SURFACE_GRASS_EDGE;
     }
   }
-  if (_walk.Walk (PAGE_SIZE))
-    _stage++;
+  _stage++;
   
 }
 
-void CPage::Build (int stop)
+/*-----------------------------------------------------------------------------
+  Convert the planes to and from the on-disk layout.  Elevation is split
+  into separate low and high byte planes after delta encoding, since the 
+  high bytes hardly ever change. 
+-----------------------------------------------------------------------------*/
+
+void CPage::Encode (UCHAR* out)
 {
 
-  while (_stage != PAGE_STAGE_DONE && SdlTick () < stop) {
+  const unsigned short* elevation;
+  unsigned short        prev, delta;
+  int                   i;
+
+  elevation = &_elevation[0][0];
+  prev = 0;
+  for (i = 0; i < PAGE_CELLS; i++) {
+    delta = (unsigned short)(elevation[i] - prev);
+    prev = elevation[i];
+    out[i] = (UCHAR)(delta & 0xff);
+    out[i + PAGE_CELLS] = (UCHAR)(delta >> 8);
+  }
+  out += PAGE_CELLS * 2;
+  out = plane_encode (&_detail[0][0], 1, out);
+  out = plane_encode (&_normal[0][0][0], 2, out);
+  out = plane_encode (&_normal[0][0][1], 2, out);
+  out = plane_encode (&_color[0][0][0], 3, out);
+  out = plane_encode (&_color[0][0][1], 3, out);
+  out = plane_encode (&_color[0][0][2], 3, out);
+  //Surface and tree values are categories, not quantities. Deltas won't help.
+  memcpy (out, &_surface[0][0], PAGE_CELLS);
+  out += PAGE_CELLS;
+  memcpy (out, &_tree[0][0], PAGE_CELLS);
+  out += PAGE_CELLS;
+  memcpy (out, &_bound[0][0], sizeof (_bound));
+
+}
+
+void CPage::Decode (const UCHAR* in)
+{
+
+  unsigned short*   elevation;
+  unsigned short    prev;
+  int               i;
+
+  elevation = &_elevation[0][0];
+  prev = 0;
+  for (i = 0; i < PAGE_CELLS; i++) {
+    prev += (unsigned short)(in[i] | (in[i + PAGE_CELLS] << 8));
+    elevation[i] = prev;
+  }
+  in += PAGE_CELLS * 2;
+  in = plane_decode (in, 1, &_detail[0][0]);
+  in = plane_decode (in, 2, &_normal[0][0][0]);
+  in = plane_decode (in, 2, &_normal[0][0][1]);
+  in = plane_decode (in, 3, &_color[0][0][0]);
+  in = plane_decode (in, 3, &_color[0][0][1]);
+  in = plane_decode (in, 3, &_color[0][0][2]);
+  memcpy (&_surface[0][0], in, PAGE_CELLS);
+  in += PAGE_CELLS;
+  memcpy (&_tree[0][0], in, PAGE_CELLS);
+  in += PAGE_CELLS;
+  memcpy (&_bound[0][0], in, sizeof (_bound));
+
+}
+
+void CPage::Store ()
+{
+
+  PHeader*  header;
+  UCHAR*    raw;
+  UCHAR*    buf;
+
+  raw = new UCHAR[PAGE_RAW];
+  buf = new UCHAR[sizeof (PHeader) + LzBound (PAGE_RAW)];
+  Encode (raw);
+  header = (PHeader*)buf;
+  header->magic = PAGE_MAGIC;
+  header->version = PAGE_VERSION;
+  header->seed = _seed;
+  header->generator = _generator;
+  header->origin = _origin;
+  header->bbox = _bbox;
+  header->packed_size = LzCompress (raw, PAGE_RAW, buf + sizeof (PHeader));
+  StoreWrite (_origin.x, _origin.y, buf, sizeof (PHeader) + header->packed_size);
+  _dirty = false;
+  delete[] buf;
+  delete[] raw;
+
+}
+
+//Returns true if the store held a usable page for the current world.
+bool CPage::Load (int origin_x, int origin_y)
+{
+
+  const UCHAR*    buf;
+  int             size;
+  const PHeader*  header;
+  UCHAR*          raw;
+  bool            ok;
+
+  buf = StoreRead (origin_x, origin_y, &size);
+  if (!buf)
+    return false;
+  ok = false;
+  header = (const PHeader*)buf;
+  if (size >= (int)sizeof (PHeader) && header->magic == PAGE_MAGIC && 
+    header->version == PAGE_VERSION && header->seed == WorldPtr ()->seed &&
+    header->generator == WorldGenerator () &&
+    header->packed_size == size - (int)sizeof (PHeader)) {
+    raw = new UCHAR[PAGE_RAW];
+    if (LzDecompress (buf + sizeof (PHeader), header->packed_size, raw, PAGE_RAW) == PAGE_RAW) {
+      Decode (raw);
+      _origin = header->origin;
+      _bbox = header->bbox;
+      _stage = PAGE_STAGE_DONE;
+      _dirty = false;
+      ok = true;
+    }
+    delete[] raw;
+  }
+  StoreRelease ();
+  return ok;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Run every stage of the page to completion.  This is called from the page
+  worker threads in Cache.cpp, so it must not touch anything but this page
+  and the (read-only) world data.  A freshly built page is dirty until 
+  someone stores it.
+-----------------------------------------------------------------------------*/
+
+void CPage::Build ()
+{
+
+  if (_stage != PAGE_STAGE_DONE) 
+    _scratch = new pscratch;
+  while (_stage != PAGE_STAGE_DONE) {
     switch (_stage) {
     case PAGE_STAGE_BEGIN:
       _stage++;
@@ -376,55 +1135,39 @@ void CPage::Build (int stop)
       DoTrees ();
       break;
     case PAGE_STAGE_SAVE:
-      Save ();
-      return;
+      _stage++;
+      delete _scratch;
+      _scratch = NULL;
+      _dirty = true;
+      break;
     }
   }
 
 }
 
+//True if this page was made for the world we have now.
+bool CPage::Current ()
+{
+
+  return _seed == WorldPtr ()->seed && _generator == WorldGenerator ();
+
+}
+
 void CPage::Cache (int origin_x, int origin_y)
 {
 
   _origin.x = origin_x;
   _origin.y = origin_y;
+  _seed = WorldPtr ()->seed;
+  _generator = WorldGenerator ();
   _stage = PAGE_STAGE_BEGIN;
   _bbox.Clear ();
-  if (FileExists (page_file_name (_origin))) {
-    char*   buf;
-    long    size;
-    long    my_size;
-
-    my_size = sizeof (CPage);
-    buf = NULL;
-    buf = FileBinaryLoad (page_file_name (_origin), &size);
-    if (buf && size == my_size) 
-      memcpy (this, buf, size);
-    if (buf)  
-      free (buf);
-  }  
+  _scratch = NULL;
+  _dirty = false;
+  _saving = false;
+  _evicted = false;
+  Load (origin_x, origin_y);
   _walk.Clear ();
-  _last_touched = SdlTick ();
+  _last_touched = PlatformTick ();
  
 }
-
-void CPage::Save ()
-{
-
-  unsigned    now;
-
-  if (!CVarUtils::GetCVar<bool> ("cache.active")) {
-    _stage++;
-    return;
-  }
-  now = SdlTick ();
-  if (now < save_cooldown)
-    return;
-  if (_stage < PAGE_STAGE_SAVE)
-    return;
-  if (_stage == PAGE_STAGE_SAVE)
-    _stage++;
-  FileSave (page_file_name (_origin), (char*)this, sizeof (CPage));
-  save_cooldown = now + SAVE_INTERVAL;
-
-}
\ No newline at end of file
@@ -147,15 +147,19 @@ void CParticleArea::DoSandStorm (GLcoord world)
 bool CParticleArea::ZoneCheck ()
 {
 
+  bool    ready;
+
+  //Ask for all four corners at once, so the workers can build them side by side.
+  ready = true;
   if (!CachePointAvailable (_origin.x, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + PARTICLE_AREA_SIZE, _origin.y))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x + PARTICLE_AREA_SIZE,_origin.y + PARTICLE_AREA_SIZE))
-    return false;
+    ready = false;
   if (!CachePointAvailable (_origin.x, _origin.y + PARTICLE_AREA_SIZE))
-    return false;
-  return true;
+    ready = false;
+  return ready;
 
 }
 
@@ -4,63 +4,27 @@
 
 -------------------------------------------------------------------------------
 
-  This holds the terrain object class.
+  This holds the terrain object class.  The mesh is built here, as part of
+  the core library.  Painting its texture and drawing it need a GL context,
+  and are in CTerrainRender.cpp.
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
-#include "cache.h"
-#include "console.h"
-#include "cterrain.h"
-#include "render.h"
-#include "scene.h"
-#include "sdl.h"
-#include "texture.h"
-
+#include "Core.h"
+#include "Cache.h"
+#include "Platform.h"
+#include "VBO.h"
+#include "CTerrain.h"
+#include "Scene.h"
 
 //Lower values make the terrain more precise at the expense of more polygons
 #define TOLERANCE         0.08f
-#define LAYERS            (sizeof (layers) / sizeof (LayerAttributes))
 
 #define COMPILE_GRID      4
 #define COMPILE_SIZE      (TERRAIN_SIZE / COMPILE_GRID)
 
-static struct LayerAttributes
-{
-  unsigned      texture_frame;
-  float         luminance;
-  float         opacity;
-  float         size;
-  SurfaceType   surface;
-  SurfaceColor   color;
-} layers [] = 
-{
-  {7,     0.7f,  0.3f,   1.3f,  SURFACE_SAND,       SURFACE_COLOR_SAND},
-  {7,     0.8f,  0.3f,   1.2f,  SURFACE_SAND,       SURFACE_COLOR_SAND},
-  {7,     1.0f,  1.0f,   1.1f,  SURFACE_SAND,       SURFACE_COLOR_SAND},
-
-  {4,     0.6f,  1.0f,   1.5f,  SURFACE_SAND_DARK,  SURFACE_COLOR_SAND},
-  {4,    1.0f,  1.0f,   1.4f,   SURFACE_DIRT,       SURFACE_COLOR_DIRT},
-  {4,    0.6f,  1.0f,   1.6f,   SURFACE_DIRT_DARK,  SURFACE_COLOR_DIRT},
-
-  {3,  1.0f,  1.0f,   1.6f,     SURFACE_FOREST,     SURFACE_COLOR_DIRT},
-
-  {6,   0.0f,  0.3f,   2.3f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
-  {6,   0.0f,  0.5f,   2.2f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
-  {6,   0.0f,  0.5f,   2.1f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
-  {5,   0.0f,  0.3f,   1.7f,    SURFACE_GRASS,      SURFACE_COLOR_GRASS},
-  {5,   0.0f,  0.5f,   1.5f,    SURFACE_GRASS,      SURFACE_COLOR_GRASS},
-  {5,   1.0f,  1.0f,   1.4f,    SURFACE_GRASS,      SURFACE_COLOR_GRASS},
-  {6,   1.0f,  1.0f,   2.0f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
-  
-  {2,    0.0f,  0.3f,   1.9f,   SURFACE_SNOW,       SURFACE_COLOR_SNOW},
-  {2,    0.6f,  0.8f,   1.6f,   SURFACE_SNOW,       SURFACE_COLOR_SNOW},
-  {2,    0.8f,  0.8f,   1.55f,  SURFACE_SNOW,       SURFACE_COLOR_SNOW},
-  {2,    1.0f,  1.0f,   1.5f,   SURFACE_SNOW,       SURFACE_COLOR_SNOW}
-};
-
 static bool   bound_ready;
-static int    boundary[TERRAIN_SIZE];
+static int    boundary[TERRAIN_EDGE];
 
 /*-----------------------------------------------------------------------------
   //This finds the largest power-of-two denominator for the given number.  This 
@@ -71,7 +35,7 @@ static int Boundary (int val)
 {
 
   if (!bound_ready) {
-    for (int n = 0; n < TERRAIN_SIZE; n++) {
+    for (int n = 0; n < TERRAIN_EDGE; n++) {
       boundary[n] = -1;
       if (n == 0)
         boundary[n] = TERRAIN_SIZE;
@@ -101,173 +65,41 @@ CTerrain::CTerrain ()
 
   //Call parent constructor
   GridData ();
+  _grid_position.Clear ();
+  _origin.Clear ();
+  _walk.Clear ();
+  _front_texture = 0;
+  _back_texture = 0;
+  _texture_desired_size = 0;
+  _texture_current_size = 0;
+  _lod = LOD_LOW;
+  _stage = STAGE_BEGIN;
+  _rebuild = 0;
+  _valid = false;
 
 }
 
 
-void CTerrain::DoPatch (int patch_z, int patch_y)
-{
-
-  float       tile;
-  int         x, y;
-  int         world_x, world_y;
-  GLvector    pos;
-  int         stage ;
-  GLrgba      col;
-  SurfaceType surface;
-  int         angle;
-  GLrgba      surface_color;
-  GLcoord     start, end;
-  GLuvbox     uvb;
-  GLvector2   uv;
-
-  glDisable (GL_CULL_FACE);
-  glDisable (GL_FOG);
-  glEnable (GL_BLEND);
-  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
-  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
-  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	
-  if (_patch_steps > 1) {
-    int     texture_step = TERRAIN_SIZE / _patch_steps;
-    start.x = _walk.x * texture_step - 3;
-    start.y = _walk.y * texture_step - 3;
-    end.x = start.x + texture_step + 5;
-    end.y = start.y + texture_step + 6;
-  } else {
-    start.x = start.y = -2;
-    end.x = end.y = TERRAIN_EDGE + 2;
-  }
-  glBindTexture (GL_TEXTURE_2D, TextureIdFromName ("terrain_rock.png"));
-	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
-  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-  for (y = start.y; y < end.y - 1; y++) {
-    glBegin (GL_QUAD_STRIP);
-    for (x = start.x; x < end.x; x++) {
-      world_x = _origin.x + x;
-      world_y = _origin.y + y;
-      glTexCoord2f ((float)x / 8, (float)y / 8);
-      surface_color = CacheSurfaceColor (world_x, world_y);
-      glColor3fv (&surface_color.red);
-      glVertex2f ((float)x, (float)y);
-      glTexCoord2f ((float)x / 8, (float)(y + 1) / 8);
-      surface_color = CacheSurfaceColor (world_x, world_y + 1);
-      glColor3fv (&surface_color.red);
-      glVertex2f ((float)x, (float)(y + 1));
-    }
-    glEnd ();
-  }
-  for (stage = 0; stage < LAYERS; stage++) {
-    //Special layer to give the sand & rock some more depth
-    if (stage == 3) {
-      glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-      glColor4f (1,1,1, 0.5f);
-      glColor3f (1,1,1);
-      glBlendFunc (GL_DST_COLOR, GL_SRC_COLOR);
-      glBindTexture (GL_TEXTURE_2D, TextureIdFromName ("terrain_shading.png"));
-	    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
-      glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	
-      glBegin (GL_QUADS);
-      glTexCoord2f (0, 0); glVertex2i (0, 0);
-      glTexCoord2f (0, 2); glVertex2i (TERRAIN_SIZE, 0);
-      glTexCoord2f (2, 2); glVertex2i (TERRAIN_SIZE, TERRAIN_SIZE);
-      glTexCoord2f (2, 0); glVertex2i (0, TERRAIN_SIZE);
-      glEnd ();
-      glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    }
-    if (!_surface_used[layers[stage].surface])
-      continue;
-    glBindTexture (GL_TEXTURE_2D, TextureIdFromName ("terrain.png"));
-    uvb.Set (0, layers[stage].texture_frame, 1, 8);
-	  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
-    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-    for (y = start.y; y < end.y - 1; y++) {
-      for (x = start.x; x < end.x; x++) {
-        world_x = _origin.x + x;
-        world_y = _origin.y + y;
-        surface = CacheSurface (world_x, world_y);
-        if (surface != layers[stage].surface)
-          continue;
-        pos.x = (float)x;
-        pos.y = (float)y;
-        tile = 0.66f * layers[stage].size; 
-        glPushMatrix ();
-        glTranslatef (pos.x - 0.5f, pos.y - 0.5f, 0);
-        angle = (world_x + world_y * 2) * 25;
-        angle %= 360;
-        glRotatef ((float)angle, 0.0f, 0.0f, 1.0f);
-        glTranslatef (-pos.x, -pos.y, 0);
-        if (layers[stage].color == SURFACE_COLOR_BLACK)
-          surface_color = glRgba (0.0f);
-        else
-          surface_color = CacheSurfaceColor (world_x, world_y);
-        col = surface_color * layers[stage].luminance;
-        col.alpha = layers[stage].opacity;
-        glColor4fv (&col.red);
-        glBegin (GL_QUADS);
-        uv = uvb.Corner (0); glTexCoord2fv (&uv.x); glVertex2f (pos.x - tile, pos.y - tile);
-        uv = uvb.Corner (1); glTexCoord2fv (&uv.x); glVertex2f (pos.x + tile, pos.y - tile);
-        uv = uvb.Corner (2); glTexCoord2fv (&uv.x); glVertex2f (pos.x + tile, pos.y + tile);
-        uv = uvb.Corner (3); glTexCoord2fv (&uv.x); glVertex2f (pos.x - tile, pos.y + tile);
-        glEnd ();
-        glPopMatrix ();
-      }
-    }
-  }
-
-
-
-
-}
 
-void CTerrain::DoTexture ()
+//This does the whole grid at once. With the rect queries it's cheap enough.
+void CTerrain::DoHeightmap ()
 {
 
-
-
-  if (!_back_texture) {
-    glGenTextures (1, &_back_texture); 
-    glBindTexture(GL_TEXTURE_2D, _back_texture);
- 	  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
-    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-    //We draw the terrain texture in squares called patches, but how big should they be?
-    //We can't draw more than will fit in the viewport
-    _patch_size = min (RenderMaxDimension (), _texture_desired_size);
-    _patch_steps = _texture_desired_size / _patch_size;
-    //We also don't want to do much at once. Walking a 128x128 grid in a singe frame creates stuttering. 
-    while (TERRAIN_SIZE / _patch_steps > 32) {
-      _patch_size /= 2;
-      _patch_steps = _texture_desired_size / _patch_size;
+  static float        elevation[TERRAIN_EDGE * TERRAIN_EDGE];
+  static SurfaceType  surface[TERRAIN_EDGE * TERRAIN_EDGE];
+  int                 x, y;
+  int                 i;
+
+  CacheElevationRect (_origin.x, _origin.y, TERRAIN_EDGE, TERRAIN_EDGE, elevation);
+  CacheSurfaceRect (_origin.x, _origin.y, TERRAIN_EDGE, TERRAIN_EDGE, surface);
+  for (x = 0; x < TERRAIN_EDGE; x++) {
+    for (y = 0; y < TERRAIN_EDGE; y++) {
+      i = x * TERRAIN_EDGE + y;
+      _surface_used[surface[i]] = true;
+      _pos[x][y] = glVector ((float)(_origin.x + x), (float)(_origin.y + y), elevation[i]);
     }
-    //_patch_steps = max (_patch_steps, 1);//Avoid div by zero. Trust me, it's bad.
-    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, _texture_desired_size, _texture_desired_size, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
   }
-  RenderCanvasBegin (_walk.x * TERRAIN_PATCH, _walk.x * TERRAIN_PATCH + TERRAIN_PATCH, _walk.y * TERRAIN_PATCH, _walk.y * TERRAIN_PATCH + TERRAIN_PATCH, _patch_size);
-  DoPatch (_walk.x, _walk.y);
-  glBindTexture(GL_TEXTURE_2D, _back_texture);
-  glCopyTexSubImage2D (GL_TEXTURE_2D, 0, _walk.x * _patch_size, _walk.y * _patch_size, 0, 0, _patch_size, _patch_size);
-  RenderCanvasEnd ();
-  if (_walk.Walk (_patch_steps))
-    _stage++;
-    
-}
-
-void CTerrain::DoHeightmap ()
-{
-
-  GLcoord         world;
-  GLvector        pos;
-
-  world.x = _origin.x + _walk.x;
-  world.y = _origin.y + _walk.y;
-  _surface_used[CacheSurface (world.x, world.y)] = true;
-  pos.x = (float)world.x;
-  pos.y = (float)world.y;
-  pos.z = CacheElevation (world.x, world.y);
-  _pos[_walk.x][_walk.y] = pos;
-  if (_walk.Walk (TERRAIN_EDGE))
-    _stage++;
+  _stage++;
 
 }
 
@@ -630,24 +462,19 @@ void CTerrain::CompileBlock (int x, int y, int size)
 bool CTerrain::ZoneCheck (long stop)
 {
 
-  //If we're waiting on a zone, give it our update allotment
-  if (!CachePointAvailable (_origin.x, _origin.y)) {
-    CacheUpdatePage (_origin.x, _origin.y, stop);
-    return false;
-  }
-  if (!CachePointAvailable (_origin.x + TERRAIN_EDGE, _origin.y + TERRAIN_EDGE)) {
-    CacheUpdatePage (_origin.x + TERRAIN_EDGE, _origin.y + TERRAIN_EDGE, stop);
-    return false;
-  }
-  if (!CachePointAvailable (_origin.x + TERRAIN_EDGE, _origin.y)) {
-    CacheUpdatePage (_origin.x + TERRAIN_EDGE, _origin.y, stop);
-    return false;
-  }
-  if (!CachePointAvailable (_origin.x, _origin.y + TERRAIN_EDGE)) {
-    CacheUpdatePage (_origin.x, _origin.y + TERRAIN_EDGE, stop);
-    return false;
-  }
-  return true;
+  bool    ready;
+
+  //Ask for all four corners at once, so the workers can build them side by side.
+  ready = true;
+  if (!CachePointAvailable (_origin.x, _origin.y))
+    ready = false;
+  if (!CachePointAvailable (_origin.x + TERRAIN_EDGE, _origin.y + TERRAIN_EDGE))
+    ready = false;
+  if (!CachePointAvailable (_origin.x + TERRAIN_EDGE, _origin.y))
+    ready = false;
+  if (!CachePointAvailable (_origin.x, _origin.y + TERRAIN_EDGE))
+    ready = false;
+  return ready;
 
 }
 
@@ -655,7 +482,7 @@ bool CTerrain::ZoneCheck (long stop)
 void CTerrain::Update (long stop)
 {
 
-  while (SdlTick () < stop) {
+  while (PlatformTick () < stop) {
     switch (_stage) {
     case STAGE_BEGIN: 
       if (!ZoneCheck (stop)) 
@@ -665,7 +492,7 @@ void CTerrain::Update (long stop)
       for (int i =0; i < NEIGHBOR_COUNT; i++)
         _neighbors[i] = 0;
       _walk.Clear ();
-      _rebuild = SdlTick ();
+      _rebuild = PlatformTick ();
       _stage++;
       break;
     case STAGE_CLEAR: 
@@ -736,8 +563,7 @@ void CTerrain::Update (long stop)
       DoTexture ();
       break;
     case STAGE_TEXTURE_FINAL: 
-      if (_front_texture) 
-        glDeleteTextures (1, &_front_texture); 
+      TextureDelete (&_front_texture);
       _front_texture = _back_texture;
       _back_texture = 0;
       _texture_current_size = _texture_desired_size;
@@ -745,10 +571,10 @@ void CTerrain::Update (long stop)
       break;
     case STAGE_DONE:
       _valid = true;
-      if (SdlTick () < _rebuild) 
+      if (PlatformTick () < _rebuild) 
         return;
       ZoneCheck (stop);//touch the zones to keep them in memory
-      _rebuild = SdlTick () + 1000;
+      _rebuild = PlatformTick () + 1000;
       if (_lod == LOD_HIGH && DoCheckNeighbors ())
         _stage = STAGE_QUADTREE;
       return;
@@ -770,12 +596,8 @@ void CTerrain::Update (long stop)
 void CTerrain::Clear ()
 {
 
-  if (_front_texture) 
-    glDeleteTextures (1, &_front_texture); 
-  if (_back_texture) 
-    glDeleteTextures (1, &_back_texture); 
-  _front_texture = 0;
-  _back_texture = 0;
+  TextureDelete (&_front_texture);
+  TextureDelete (&_back_texture);
   _stage = STAGE_BEGIN;
   _texture_current_size = 0;
   _vertex_list.clear ();
@@ -811,12 +633,8 @@ GLcoord CTerrain::Origin ()
 void CTerrain::TexturePurge ()
 {
 
-  if (_front_texture) 
-    glDeleteTextures (1, &_front_texture); 
-  if (_back_texture) 
-    glDeleteTextures (1, &_back_texture); 
-  _front_texture = 0;
-  _back_texture = 0;
+  TextureDelete (&_front_texture);
+  TextureDelete (&_back_texture);
   _texture_current_size = 0;
   _texture_desired_size = 64;
   if (_stage >= STAGE_TEXTURE) {
@@ -862,14 +680,3 @@ void CTerrain::Set (int grid_x, int grid_y, int distance)
   _walk.Clear ();
 
 }
-
-void CTerrain::Render ()
-{
-
-  if (_front_texture && _valid) {
-    //glColor3fv (&_color.red);
-    glBindTexture (GL_TEXTURE_2D, _front_texture);
-    _vbo.Render ();
-  }
-
-}
\ No newline at end of file
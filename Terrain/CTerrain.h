@@ -29,7 +29,7 @@ enum
 };
 
 #ifndef GRID
-#include "cgrid.h"
+#include "CGrid.h"
 #endif
 
 class CTerrain : public GridData
@@ -64,8 +64,6 @@ private:
 
 
   void              DoStitch ();
-  void              DoPatch (int x, int y);
-  void              DoTexture ();
   void              DoHeightmap ();
   void              DoNormals ();
   void              DoQuad (int x1, int y1, int size);
@@ -75,6 +73,10 @@ private:
   void              TrianglePush (int i1, int i2, int i3);
   void              PointActivate (int x, int y);
   void              Invalidate () { _valid = false; }
+  //These need a GL context.  See CTerrainRender.cpp.
+  void              DoPatch (int x, int y);
+  void              DoTexture ();
+  void              TextureDelete (unsigned* texture);
 
 public:
   CTerrain ();
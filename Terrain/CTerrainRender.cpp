@@ -0,0 +1,236 @@
+/*-----------------------------------------------------------------------------
+
+  CTerrainRender.cpp
+
+-------------------------------------------------------------------------------
+
+  The parts of CTerrain that need a GL context: painting the terrain texture,
+  and drawing it.  The mesh is built in CTerrain.cpp, which is part of the 
+  core library.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include "Cache.h"
+#include "CTerrain.h"
+#include "Render.h"
+#include "Texture.h"
+
+#define LAYERS            (sizeof (layers) / sizeof (LayerAttributes))
+
+static struct LayerAttributes
+{
+  unsigned      texture_frame;
+  float         luminance;
+  float         opacity;
+  float         size;
+  SurfaceType   surface;
+  SurfaceColor   color;
+} layers [] = 
+{
+  {7,     0.7f,  0.3f,   1.3f,  SURFACE_SAND,       SURFACE_COLOR_SAND},
+  {7,     0.8f,  0.3f,   1.2f,  SURFACE_SAND,       SURFACE_COLOR_SAND},
+  {7,     1.0f,  1.0f,   1.1f,  SURFACE_SAND,       SURFACE_COLOR_SAND},
+
+  {4,     0.6f,  1.0f,   1.5f,  SURFACE_SAND_DARK,  SURFACE_COLOR_SAND},
+  {4,    1.0f,  1.0f,   1.4f,   SURFACE_DIRT,       SURFACE_COLOR_DIRT},
+  {4,    0.6f,  1.0f,   1.6f,   SURFACE_DIRT_DARK,  SURFACE_COLOR_DIRT},
+
+  {3,  1.0f,  1.0f,   1.6f,     SURFACE_FOREST,     SURFACE_COLOR_DIRT},
+
+  {6,   0.0f,  0.3f,   2.3f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
+  {6,   0.0f,  0.5f,   2.2f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
+  {6,   0.0f,  0.5f,   2.1f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
+  {5,   0.0f,  0.3f,   1.7f,    SURFACE_GRASS,      SURFACE_COLOR_GRASS},
+  {5,   0.0f,  0.5f,   1.5f,    SURFACE_GRASS,      SURFACE_COLOR_GRASS},
+  {5,   1.0f,  1.0f,   1.4f,    SURFACE_GRASS,      SURFACE_COLOR_GRASS},
+  {6,   1.0f,  1.0f,   2.0f,    SURFACE_GRASS_EDGE, SURFACE_COLOR_GRASS},
+  
+  {2,    0.0f,  0.3f,   1.9f,   SURFACE_SNOW,       SURFACE_COLOR_SNOW},
+  {2,    0.6f,  0.8f,   1.6f,   SURFACE_SNOW,       SURFACE_COLOR_SNOW},
+  {2,    0.8f,  0.8f,   1.55f,  SURFACE_SNOW,       SURFACE_COLOR_SNOW},
+  {2,    1.0f,  1.0f,   1.5f,   SURFACE_SNOW,       SURFACE_COLOR_SNOW}
+};
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void CTerrain::DoPatch (int patch_z, int patch_y)
+{
+
+  float       tile;
+  int         x, y;
+  int         world_x, world_y;
+  GLvector    pos;
+  int         stage ;
+  GLrgba      col;
+  SurfaceType surface;
+  int         angle;
+  GLrgba      surface_color;
+  GLcoord     start, end;
+  GLuvbox     uvb;
+  GLvector2   uv;
+  int         width, height;
+  int         cell;
+  vector<GLrgba>      colors;
+  vector<SurfaceType> surfaces;
+
+  glDisable (GL_CULL_FACE);
+  glDisable (GL_FOG);
+  glEnable (GL_BLEND);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	
+  if (_patch_steps > 1) {
+    int     texture_step = TERRAIN_SIZE / _patch_steps;
+    start.x = _walk.x * texture_step - 3;
+    start.y = _walk.y * texture_step - 3;
+    end.x = start.x + texture_step + 5;
+    end.y = start.y + texture_step + 6;
+  } else {
+    start.x = start.y = -2;
+    end.x = end.y = TERRAIN_EDGE + 2;
+  }
+  //Grab all the cell data we'll need up front. Rows run from start.y to end.y - 1 inclusive.
+  width = end.x - start.x;
+  height = end.y - start.y;
+  colors.resize (width * height);
+  surfaces.resize (width * height);
+  CacheSurfaceColorRect (_origin.x + start.x, _origin.y + start.y, width, height, &colors[0]);
+  CacheSurfaceRect (_origin.x + start.x, _origin.y + start.y, width, height, &surfaces[0]);
+  glBindTexture (GL_TEXTURE_2D, TextureIdFromName ("terrain_rock.png"));
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  for (y = start.y; y < end.y - 1; y++) {
+    glBegin (GL_QUAD_STRIP);
+    for (x = start.x; x < end.x; x++) {
+      cell = (x - start.x) * height + (y - start.y);
+      glTexCoord2f ((float)x / 8, (float)y / 8);
+      surface_color = colors[cell];
+      glColor3fv (&surface_color.red);
+      glVertex2f ((float)x, (float)y);
+      glTexCoord2f ((float)x / 8, (float)(y + 1) / 8);
+      surface_color = colors[cell + 1];
+      glColor3fv (&surface_color.red);
+      glVertex2f ((float)x, (float)(y + 1));
+    }
+    glEnd ();
+  }
+  for (stage = 0; stage < LAYERS; stage++) {
+    //Special layer to give the sand & rock some more depth
+    if (stage == 3) {
+      glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      glColor4f (1,1,1, 0.5f);
+      glColor3f (1,1,1);
+      glBlendFunc (GL_DST_COLOR, GL_SRC_COLOR);
+      glBindTexture (GL_TEXTURE_2D, TextureIdFromName ("terrain_shading.png"));
+	    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
+      glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	
+      glBegin (GL_QUADS);
+      glTexCoord2f (0, 0); glVertex2i (0, 0);
+      glTexCoord2f (0, 2); glVertex2i (TERRAIN_SIZE, 0);
+      glTexCoord2f (2, 2); glVertex2i (TERRAIN_SIZE, TERRAIN_SIZE);
+      glTexCoord2f (2, 0); glVertex2i (0, TERRAIN_SIZE);
+      glEnd ();
+      glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    if (!_surface_used[layers[stage].surface])
+      continue;
+    glBindTexture (GL_TEXTURE_2D, TextureIdFromName ("terrain.png"));
+    uvb.Set (0, layers[stage].texture_frame, 1, 8);
+	  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
+    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+    for (y = start.y; y < end.y - 1; y++) {
+      for (x = start.x; x < end.x; x++) {
+        cell = (x - start.x) * height + (y - start.y);
+        surface = surfaces[cell];
+        if (surface != layers[stage].surface)
+          continue;
+        world_x = _origin.x + x;
+        world_y = _origin.y + y;
+        pos.x = (float)x;
+        pos.y = (float)y;
+        tile = 0.66f * layers[stage].size; 
+        glPushMatrix ();
+        glTranslatef (pos.x - 0.5f, pos.y - 0.5f, 0);
+        angle = (world_x + world_y * 2) * 25;
+        angle %= 360;
+        glRotatef ((float)angle, 0.0f, 0.0f, 1.0f);
+        glTranslatef (-pos.x, -pos.y, 0);
+        if (layers[stage].color == SURFACE_COLOR_BLACK)
+          surface_color = glRgba (0.0f);
+        else
+          surface_color = colors[cell];
+        col = surface_color * layers[stage].luminance;
+        col.alpha = layers[stage].opacity;
+        glColor4fv (&col.red);
+        glBegin (GL_QUADS);
+        uv = uvb.Corner (0); glTexCoord2fv (&uv.x); glVertex2f (pos.x - tile, pos.y - tile);
+        uv = uvb.Corner (1); glTexCoord2fv (&uv.x); glVertex2f (pos.x + tile, pos.y - tile);
+        uv = uvb.Corner (2); glTexCoord2fv (&uv.x); glVertex2f (pos.x + tile, pos.y + tile);
+        uv = uvb.Corner (3); glTexCoord2fv (&uv.x); glVertex2f (pos.x - tile, pos.y + tile);
+        glEnd ();
+        glPopMatrix ();
+      }
+    }
+  }
+
+
+
+
+}
+
+void CTerrain::DoTexture ()
+{
+
+
+
+  if (!_back_texture) {
+    glGenTextures (1, &_back_texture); 
+    glBindTexture(GL_TEXTURE_2D, _back_texture);
+ 	  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
+    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+    //We draw the terrain texture in squares called patches, but how big should they be?
+    //We can't draw more than will fit in the viewport
+    _patch_size = min (RenderMaxDimension (), _texture_desired_size);
+    _patch_steps = _texture_desired_size / _patch_size;
+    //We also don't want to do much at once. Walking a 128x128 grid in a singe frame creates stuttering. 
+    while (TERRAIN_SIZE / _patch_steps > 32) {
+      _patch_size /= 2;
+      _patch_steps = _texture_desired_size / _patch_size;
+    }
+    //_patch_steps = max (_patch_steps, 1);//Avoid div by zero. Trust me, it's bad.
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, _texture_desired_size, _texture_desired_size, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+  }
+  RenderCanvasBegin (_walk.x * TERRAIN_PATCH, _walk.x * TERRAIN_PATCH + TERRAIN_PATCH, _walk.y * TERRAIN_PATCH, _walk.y * TERRAIN_PATCH + TERRAIN_PATCH, _patch_size);
+  DoPatch (_walk.x, _walk.y);
+  glBindTexture(GL_TEXTURE_2D, _back_texture);
+  glCopyTexSubImage2D (GL_TEXTURE_2D, 0, _walk.x * _patch_size, _walk.y * _patch_size, 0, 0, _patch_size, _patch_size);
+  RenderCanvasEnd ();
+  if (_walk.Walk (_patch_steps))
+    _stage++;
+    
+}
+
+void CTerrain::TextureDelete (unsigned* texture)
+{
+
+  if (*texture) 
+    glDeleteTextures (1, texture); 
+  *texture = 0;
+
+}
+
+void CTerrain::Render ()
+{
+
+  if (_front_texture && _valid) {
+    //glColor3fv (&_color.red);
+    glBindTexture (GL_TEXTURE_2D, _front_texture);
+    _vbo.Render ();
+  }
+
+}
@@ -1,4 +1,7 @@
 #define TREE_ALTS   3
+//Trees are painted onto a strip of four square textures.  See CTreeRender.cpp.
+#define TEXTURE_SIZE          256
+#define TEXTURE_HALF          (TEXTURE_SIZE / 2)
 
 enum TreeTrunkStyle
 {
@@ -105,12 +108,13 @@ class CTree
   void              DoBranch (GLmesh* m, BranchAnchor anchor, float angle, LOD lod);
   void              DoTrunk (GLmesh* m, unsigned local_seed, LOD lod);
   void              DoLeaves ();
-  void              DoTexture ();
   GLvector          TrunkPosition (float delta, float* radius);
   void              Build ();
 public:
   unsigned          _texture;
   void              Create (bool canopy, float moisture, float temperature, int seed);
+  void              DoTexture ();
+  void              Plan (bool canopy, float moisture, float temperature, int seed);
   void              Render (GLvector pos, unsigned alt, LOD lod);
   unsigned          Texture () { return _texture; };
   void              TexturePurge ();
@@ -0,0 +1,265 @@
+/*-----------------------------------------------------------------------------
+
+  CTreeRender.cpp
+
+-------------------------------------------------------------------------------
+
+  The parts of CTree that need a GL context: drawing the tree, and painting
+  its texture.  The geometry is built in CTree.cpp, which is part of the 
+  core library.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include "CTree.h"
+#include "Render.h"
+#include "Text.h"
+#include "Texture.h"
+#include "World.h"
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+//Render a single tree. Very slow. Used for debugging. 
+void CTree::Render (GLvector pos, unsigned alt, LOD lod)
+{
+
+  glEnable (GL_BLEND);
+  glEnable (GL_TEXTURE_2D);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glBindTexture (GL_TEXTURE_2D, _texture);
+  glPushMatrix ();
+  glTranslatef (pos.x, pos.y, pos.z);
+  _meshes[alt][lod].Render ();
+  glPopMatrix ();
+
+}
+
+void CTree::DrawFacer ()
+{
+
+  GLbbox    box;
+  GLvector  size, center;
+
+  glDisable (GL_BLEND);
+  //We get the bounding box for the high-res tree, but we cut off the roots.  No reason to 
+  //waste texture pixels on that.
+  _meshes[0][LOD_HIGH].RecalculateBoundingBox ();
+  box = _meshes[0][LOD_HIGH]._bbox;
+  box.pmin.z = 0.0f;//Cuts off roots
+  center = box.Center ();
+  size = box.Size ();
+  //Move our viewpoint to the middle of the texture frame 
+  glTranslatef (TEXTURE_HALF, TEXTURE_HALF, 0.0f);
+  glRotatef (-90.0f, 1.0f, 0.0f, 0.0f);
+  //Scale so that the tree will exactly fill the rectangle
+  glScalef ((1.0f / size.x) * TEXTURE_SIZE, 1.0f, (1.0f / size.z) * TEXTURE_SIZE);
+  glTranslatef (-center.x, 0.0f, -center.z);
+  glColor3f (1,1,1);
+  Render (glVector (0.0f, 0.0f, 0.0f), 0, LOD_HIGH);
+
+}
+
+void CTree::DrawVines ()
+{
+
+  GLtexture*  t;
+  GLuvbox     uvframe;
+  int         frames;
+  int         frame;
+  float       frame_size;
+  GLvector2   uv;
+  GLrgba      color;
+
+  glColor3fv (&_bark_color1.red);
+  glBindTexture (GL_TEXTURE_2D, 0);
+  t = TextureFromName ("vines.png");
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  frames = max (t->height / t->width, 1);
+  frame_size = 1.0f / (float)frames;
+  frame = WorldNoisei (_seed_current++) % frames;
+  uvframe.Set (glVector (0.0f, (float)frame * frame_size), glVector (1.0f, (float)(frame + 1) * frame_size));
+  glBindTexture (GL_TEXTURE_2D, t->id);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  color = _leaf_color * 0.75f;
+  glColor3fv (&_leaf_color.red);
+  glBegin (GL_QUADS);
+  uv = uvframe.Corner (3); glTexCoord2fv (&uv.x); glVertex2i (0, 0);
+  uv = uvframe.Corner (0); glTexCoord2fv (&uv.x); glVertex2i (TEXTURE_SIZE, 0);
+  uv = uvframe.Corner (1); glTexCoord2fv (&uv.x); glVertex2i (TEXTURE_SIZE, TEXTURE_SIZE);
+  uv = uvframe.Corner (2); glTexCoord2fv (&uv.x); glVertex2i (0, TEXTURE_SIZE);
+  glEnd ();
+
+
+}
+
+void CTree::DrawLeaves ()
+{
+
+  GLtexture*  t;
+  GLuvbox     uvframe;
+  int         frames;
+  int         frame;
+  float       frame_size;
+  GLvector2   uv;
+  unsigned    i;
+
+  if (_leaf_style == TREE_LEAF_SCATTER) {
+    GLrgba c;
+
+    c = _bark_color1;
+    c *= 0.5f;
+    glBindTexture (GL_TEXTURE_2D, 0);
+    glLineWidth (3.0f);
+    glColor3fv (&c.red);
+
+    glBegin (GL_LINES);
+    for (i = 0; i < _leaf_list.size (); i++) {
+      glVertex2fv (&_leaf_list[_leaf_list[i].neighbor].position.x);
+      glVertex2fv (&_leaf_list[i].position.x);
+    }
+    glEnd ();
+
+  }
+  
+  Leaf              l;
+  //GLrgba            color;
+    
+  t = TextureFromName ("foliage.png");
+  frames = max (t->height / t->width, 1);
+  frame_size = 1.0f / (float)frames;
+  frame = WorldNoisei (_seed_current++) % frames;
+  uvframe.Set (glVector (0.0f, (float)frame * frame_size), glVector (1.0f, (float)(frame + 1) * frame_size));
+  glBindTexture (GL_TEXTURE_2D, t->id);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+ 	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+ 	//glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);	
+  //glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);	
+  for (i = 0; i < _leaf_list.size (); i++) {
+    l = _leaf_list[i];
+    glPushMatrix ();
+    glTranslatef (l.position.x, l.position.y, 0);
+    glRotatef (l.angle, 0.0f, 0.0f, 1.0f);
+    glTranslatef (-l.position.x, -l.position.y, 0);
+
+    //color = _leaf_color * l.brightness;
+    glColor3fv (&l.color.red);
+    glBegin (GL_QUADS);
+    uv = uvframe.Corner (0); glTexCoord2fv (&uv.x); glVertex2f (l.position.x - l.size, l.position.y - l.size);
+    uv = uvframe.Corner (1); glTexCoord2fv (&uv.x); glVertex2f (l.position.x + l.size, l.position.y - l.size);
+    uv = uvframe.Corner (2); glTexCoord2fv (&uv.x); glVertex2f (l.position.x + l.size, l.position.y + l.size);
+    uv = uvframe.Corner (3); glTexCoord2fv (&uv.x); glVertex2f (l.position.x - l.size, l.position.y + l.size);
+    glEnd ();
+    glPopMatrix ();
+  }
+
+
+
+}
+
+void CTree::DrawBark ()
+{
+
+  GLtexture*  t;
+  GLuvbox     uvframe;
+  int         frames;
+  int         frame;
+  float       frame_size;
+  GLvector2   uv;
+
+  glColor3fv (&_bark_color1.red);
+  glBindTexture (GL_TEXTURE_2D, 0);
+  glBegin (GL_QUADS);
+  glTexCoord2f (0, 0); glVertex2i (0, 0);
+  glTexCoord2f (1, 0); glVertex2i (TEXTURE_SIZE, 0);
+  glTexCoord2f (1, 1); glVertex2i (TEXTURE_SIZE, TEXTURE_SIZE);
+  glTexCoord2f (0, 1); glVertex2i (0, TEXTURE_SIZE);
+  glEnd ();
+  
+  t = TextureFromName ("bark1.bmp");
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  frames = max (t->height / t->width, 1);
+  frame_size = 1.0f / (float)frames;
+  frame = WorldNoisei (_seed_current++) % frames;
+  uvframe.Set (glVector (0.0f, (float)frame * frame_size), glVector (1.0f, (float)(frame + 1) * frame_size));
+  glBindTexture (GL_TEXTURE_2D, t->id);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glColorMask (true, true, true, false);
+  glColor3fv (&_bark_color2.red);
+  glBegin (GL_QUADS);
+  uv = uvframe.Corner (0); glTexCoord2fv (&uv.x); glVertex2i (0, 0);
+  uv = uvframe.Corner (1); glTexCoord2fv (&uv.x); glVertex2i (TEXTURE_SIZE, 0);
+  uv = uvframe.Corner (2); glTexCoord2fv (&uv.x); glVertex2i (TEXTURE_SIZE, TEXTURE_SIZE);
+  uv = uvframe.Corner (3); glTexCoord2fv (&uv.x); glVertex2i (0, TEXTURE_SIZE);
+  glEnd ();
+  glColorMask (true, true, true, true);
+
+
+}
+
+void CTree::DoTexture ()
+{
+
+  unsigned  i;
+
+  glDisable (GL_CULL_FACE);
+  glDisable (GL_FOG);
+  glDisable (GL_LIGHTING);
+  glEnable (GL_BLEND);
+  glEnable (GL_TEXTURE_2D);
+  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+ 	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  if (_texture)
+    glDeleteTextures (1, &_texture); 
+  glGenTextures (1, &_texture); 
+  glBindTexture(GL_TEXTURE_2D, _texture);
+  glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, TEXTURE_SIZE * 4, TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  RenderCanvasBegin (0, TEXTURE_SIZE, 0, TEXTURE_SIZE, TEXTURE_SIZE);
+ 	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+  char* buffer = new char[TEXTURE_SIZE * TEXTURE_SIZE * 4];
+  for (i = 0; i < 4; i++) {
+    glClearColor (1.0f, 0.0f, 1.0f, 0.0f);
+    glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (i == 0)       
+      DrawBark ();
+    else if (i == 1)
+      DrawLeaves ();
+    else if (i == 2)
+      DrawVines ();
+    else
+      DrawFacer ();    
+    //CgShaderSelect (FSHADER_MASK_TRANSFER);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+ 	  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
+    glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
+    //glCopyTexSubImage2D (GL_TEXTURE_2D, 0, TEXTURE_SIZE * i, 0, 0, 0, TEXTURE_SIZE, TEXTURE_SIZE);
+    glReadPixels (0, 0, TEXTURE_SIZE, TEXTURE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+    //CgShaderSelect (FSHADER_MASK_TRANSFER);
+    glTexSubImage2D (GL_TEXTURE_2D, 0, TEXTURE_SIZE * i, 0, TEXTURE_SIZE, TEXTURE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+    //CgShaderSelect (FSHADER_NONE);
+  }
+  delete buffer;
+  RenderCanvasEnd ();
+  
+}
+
+void CTree::Info ()
+{
+
+  TextPrint ("TREE:\nSeed:%d Moisture: %f Temp: %f", _seed, _moisture, _temperature);
+
+}
+
+void CTree::TexturePurge ()
+{
+
+  if (_texture)
+    DoTexture ();
+
+}
\ No newline at end of file
@@ -6,25 +6,112 @@
 
   This generates, stores, and fetches the pages of terrain data.
 
+  Pages are built by a pool of worker threads.  Asking for a page that isn't
+  resident just puts it in the queue.  When a worker finishes a page, it goes
+  on the finished list, and CacheUpdate () publishes it to the page table on
+  the main thread.  Only finished pages are ever visible to the lookup 
+  functions, so nothing outside this module needs to worry about threads.
+
+  Requests are ordered by priority: distance from the avatar, with pages 
+  in view of the camera pulled forward.  The queue is re-sorted every frame
+  as the camera moves.  A request that nobody has asked about for a while
+  is dropped, so the workers don't waste time on pages we've left behind.
+
+  Besides what's asked for, we also prefetch the pages the avatar is headed
+  towards, judging by its velocity, and the pages the camera is looking at.
+
+  Resident pages are kept in a list, ordered by when they were last used.
+  When the cache goes over its memory budget, pages are evicted from the 
+  cold end of the list.
+
+  Saving is done by a writer thread.  Newly built pages are handed to it,
+  and it packs and stores everything that's piled up since its last pass.
+  An evicted page that's still waiting to be written is left for the writer
+  to delete, so evicting (or purging the whole cache) never waits on disk.
+
 -----------------------------------------------------------------------------*/
 
 
-#include "stdafx.h"
-#include <io.h>
-#include "console.h"
-#include "cpage.h"
-#include "entropy.h"
-#include "game.h"
-#include "sdl.h"
-#include "text.h"
-#include "world.h"
+#include "Core.h"
+#include <float.h>
+#include "Cache.h"
+#include "Console.h"
+#include "Cpage.h"
+#include "Entropy.h"
+#include "Platform.h"
+#include "Store.h"
+#include "World.h"
 
 #define PAGE_GRID   (WORLD_SIZE_METERS / PAGE_SIZE)
+#define MAX_WORKERS 8
+//How many pages CacheSize will load to measure decode speed.
+#define CACHE_SIZE_SAMPLE   64
+//How many times CacheNormalBenchmark recomputes the page.
+#define NORMAL_PASSES       20
+//Pages used this recently are never evicted, even if we're over budget.
+#define CACHE_PROTECT       2000 //milliseconds
+#define MEGABYTE            (1024 * 1024)
+#define KILOBYTE            1024
+//How many byte counts one log line can format.
+#define BYTES_SCRATCH       4
+//Requests not asked for again in this long are cancelled.
+#define CACHE_CANCEL        1500 //milliseconds
+//Pages within this angle of where the camera is looking count as in view.
+#define VIEW_CONE           0.5f //cosine of 60 degrees
+//How far ahead (in seconds of travel) to prefetch pages.
+#define PREFETCH_TIME       4.0f
+//Below this speed we prefetch along the camera instead of the path.
+#define PREFETCH_SPEED      1.0f
+//How many pages out along the camera view to prefetch.
+#define PREFETCH_LOOK       2
+//Raycasts step through the smallest pyramid blocks this far at a time.
+#define RAY_STEP            0.5f
+//How many times to halve the step once we know we've hit the ground.
+#define RAY_REFINE          6
+#define RAY_EPSILON         0.001f
+
+struct PageRequest
+{
+  GLcoord     pos;
+  float       priority;
+};
 
 
 static CPage*       page[PAGE_GRID][PAGE_GRID];
+static bool         requested[PAGE_GRID][PAGE_GRID];
+static long         wanted[PAGE_GRID][PAGE_GRID];
 static int          page_count;
-static GLcoord      walk;
+static CPage*       lru_head;
+static CPage*       lru_tail;
+static long         now;
+static int          budget = 128;
+static bool         save_pages;
+static bool         view_prefetch;
+static GLvector     view_position;
+static GLvector     view_angle;
+static GLvector     view_velocity;
+static unsigned     hits;
+static unsigned     misses;
+static unsigned     evictions;
+static unsigned     cancelled;
+static unsigned     prefetches;
+//Everything below is shared with the worker threads, and guarded by queue_lock.
+static PlatformMutex*   queue_lock;
+static PlatformCond*    queue_signal;
+static PlatformThread*  worker[MAX_WORKERS];
+static int          worker_count;
+static int          worker_busy;
+static bool         worker_quit;
+static vector<PageRequest>  queue; //Sorted so the most urgent is at the back.
+static vector<CPage*>   finished;
+//The writer thread, and everything guarded by write_lock.
+static PlatformMutex*   write_lock;
+static PlatformCond*    write_signal;
+static PlatformThread*  writer;
+static bool         writer_quit;
+static bool         write_close;
+static vector<CPage*>   writes;
+static unsigned     written;
 
 /* Static Functions *************************************************************/
 
@@ -35,10 +122,88 @@ inline int CPageFromPos (int cell)
 
 }
 
+//A byte count in readable units, for the console.  
+static char* bytes_text (unsigned long long bytes)
+{
+
+  static char   scratch[BYTES_SCRATCH][16];
+  static int    current;
+
+  current = (current + 1) % BYTES_SCRATCH;
+  if (bytes > MEGABYTE) 
+    sprintf (scratch[current], "%1.1fMb", (float)bytes / MEGABYTE);
+  else if (bytes > KILOBYTE) 
+    sprintf (scratch[current], "%1.1fKb", (float)bytes / KILOBYTE);
+  else
+    sprintf (scratch[current], "%u Bytes", (unsigned)bytes);
+  return scratch[current];
+
+}
+
+static void lru_unlink (CPage* p)
+{
+
+  if (p->_lru_prev)
+    p->_lru_prev->_lru_next = p->_lru_next;
+  else
+    lru_head = p->_lru_next;
+  if (p->_lru_next)
+    p->_lru_next->_lru_prev = p->_lru_prev;
+  else
+    lru_tail = p->_lru_prev;
+  p->_lru_prev = p->_lru_next = NULL;
+
+}
+
+static void lru_push (CPage* p)
+{
+
+  p->_lru_prev = NULL;
+  p->_lru_next = lru_head;
+  if (lru_head)
+    lru_head->_lru_prev = p;
+  lru_head = p;
+  if (!lru_tail)
+    lru_tail = p;
+
+}
+
+//Mark the page as used, and move it to the front of the list.
+static void page_touch (CPage* p)
+{
+
+  p->Touch (now);
+  if (p == lru_head)
+    return;
+  lru_unlink (p);
+  lru_push (p);
+
+}
+
+static void page_evict (CPage* p)
+{
+
+  GLcoord   pos;
+
+  pos = p->Origin ();
+  lru_unlink (p);
+  page[pos.x][pos.y] = NULL;
+  PlatformMutexLock (write_lock);
+  if (p->_saving) {
+    p->_evicted = true;
+    p = NULL;
+  }
+  PlatformMutexUnlock (write_lock);
+  delete p;
+  page_count--;
+
+}
+
 static CPage* page_lookup (int world_x, int world_y) 
 {
 
   int     page_x, page_y;
+  CPage*  p;
   
   if (world_x < 0 || world_y < 0)
     return NULL;
@@ -46,8 +211,330 @@ static CPage* page_lookup (int world_x, int world_y)
   page_y = CPageFromPos (world_y);
   if (page_x < 0 || page_x >= PAGE_GRID || page_y < 0 || page_y >= PAGE_GRID)
     return NULL;
-  return page[page_x][page_y];
+  p = page[page_x][page_y];
+  if (p)
+    page_touch (p);
+  return p;
 
+}
+
+static char* store_file_name (char* name)
+{
+
+  sprintf (name, "%spages.dat", WorldDirectory ());
+  return name;
+
+}
+
+//Block until the writer has closed the store, if we've asked it to.
+static void store_wait ()
+{
+
+  PlatformMutexLock (write_lock);
+  while (write_close)
+    PlatformCondWait (write_signal, write_lock);
+  PlatformMutexUnlock (write_lock);
+
+}
+
+//Make sure the page store for the current world is open.
+static void store_check ()
+{
+
+  char    filename[256];
+
+  //If the last world's store is still being written out, let it finish.
+  store_wait ();
+  if (StoreIsOpen ())
+    return;
+  StoreOpen (store_file_name (filename), PAGE_GRID, WorldPtr ()->seed, WorldGenerator ());
+
+}
+
+/*-----------------------------------------------------------------------------
+  Request priorities.  Smaller numbers get built first.
+-----------------------------------------------------------------------------*/
+
+static float request_priority (GLcoord pos, GLvector2 avatar, GLvector2 view)
+{
+
+  GLvector2   to_page;
+  float       distance;
+
+  to_page.x = (float)(pos.x * PAGE_SIZE + PAGE_HALF) - avatar.x;
+  to_page.y = (float)(pos.y * PAGE_SIZE + PAGE_HALF) - avatar.y;
+  distance = to_page.Length ();
+  //Anything close enough to be under our feet is always in view.
+  if (distance < PAGE_SIZE)
+    return distance * 0.5f;
+  to_page /= distance;
+  if (to_page.x * view.x + to_page.y * view.y > VIEW_CONE)
+    return distance * 0.5f;
+  return distance;
+
+}
+
+static int request_sort (const void* a, const void* b)
+{
+
+  float     pa, pb;
+
+  pa = ((const PageRequest*)a)->priority;
+  pb = ((const PageRequest*)b)->priority;
+  if (pa > pb)
+    return -1;
+  if (pa < pb)
+    return 1;
+  return 0;
+
+}
+
+//Where the avatar is, and which way the camera is looking, flattened to 2D.
+static void request_view (GLvector2* avatar, GLvector2* view)
+{
+
+  GLvector    pos, angle;
+
+  pos = view_position;
+  angle = view_angle;
+  avatar->x = pos.x;
+  avatar->y = pos.y;
+  //The camera sits behind the avatar, so it looks the opposite way it's offset.
+  view->x = -sin (angle.z * DEGREES_TO_RADIANS);
+  view->y = -cos (angle.z * DEGREES_TO_RADIANS);
+
+}
+
+//Ask for the given page. Returns true if this is a new request.
+static bool page_request (int page_x, int page_y)
+{
+
+  PageRequest r;
+  GLvector2   avatar, view;
+
+  if (page_x < 0 || page_x >= PAGE_GRID || page_y < 0 || page_y >= PAGE_GRID)
+    return false;
+  if (page[page_x][page_y]) {
+    page_touch (page[page_x][page_y]);
+    return false;
+  }
+  //Let the queue know someone is still waiting on this.
+  wanted[page_x][page_y] = PlatformTick ();
+  if (requested[page_x][page_y])
+    return false;
+  store_check ();
+  requested[page_x][page_y] = true;
+  request_view (&avatar, &view);
+  r.pos.x = page_x;
+  r.pos.y = page_y;
+  r.priority = request_priority (r.pos, avatar, view);
+  //It goes at the back for now. The next update will sort it into place.
+  PlatformMutexLock (queue_lock);
+  queue.push_back (r);
+  PlatformCondSignal (queue_signal);
+  PlatformMutexUnlock (queue_lock);
+  return true;
+
+}
+
+static void prefetch_point (float world_x, float world_y)
+{
+
+  if (world_x < 0.0f || world_y < 0.0f)
+    return;
+  if (page_request (CPageFromPos ((int)world_x), CPageFromPos ((int)world_y)))
+    prefetches++;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Request the pages we're going to need soon: the ones along the path the 
+  avatar is travelling, and the ones the camera is looking at.  These keep 
+  getting asked for as long as they're ahead of us, so if we turn around 
+  they age out of the queue like any other request.
+-----------------------------------------------------------------------------*/
+
+static void cache_prefetch ()
+{
+
+  GLvector    travel;
+  GLvector2   avatar, view, heading;
+  float       speed, reach, step;
+  int         x, y;
+
+  if (!view_prefetch)
+    return;
+  request_view (&avatar, &view);
+  travel = view_velocity;
+  heading.x = travel.x;
+  heading.y = travel.y;
+  speed = heading.Length ();
+  if (speed > PREFETCH_SPEED) {
+    heading /= speed;
+    reach = speed * PREFETCH_TIME;
+    for (step = PAGE_HALF; step < reach; step += PAGE_HALF)
+      prefetch_point (avatar.x + heading.x * step, avatar.y + heading.y * step);
+    //Fill in around where we expect to end up.
+    for (x = -1; x <= 1; x++) {
+      for (y = -1; y <= 1; y++) 
+        prefetch_point (avatar.x + heading.x * reach + x * PAGE_SIZE, avatar.y + heading.y * reach + y * PAGE_SIZE);
+    }
+  }
+  for (x = 1; x <= PREFETCH_LOOK; x++) 
+    prefetch_point (avatar.x + view.x * x * PAGE_SIZE, avatar.y + view.y * x * PAGE_SIZE);
+
+}
+
+//Drop requests nobody wants any more, and re-sort the rest.
+static void queue_update ()
+{
+
+  GLvector2   avatar, view;
+  unsigned    i, keep;
+  GLcoord     pos;
+
+  request_view (&avatar, &view);
+  PlatformMutexLock (queue_lock);
+  keep = 0;
+  for (i = 0; i < queue.size (); i++) {
+    pos = queue[i].pos;
+    if (now - wanted[pos.x][pos.y] > CACHE_CANCEL) {
+      requested[pos.x][pos.y] = false;
+      cancelled++;
+      continue;
+    }
+    queue[i].priority = request_priority (pos, avatar, view);
+    queue[keep++] = queue[i];
+  }
+  queue.resize (keep);
+  if (!queue.empty ())
+    qsort (&queue[0], queue.size (), sizeof (PageRequest), request_sort);
+  PlatformMutexUnlock (queue_lock);
+
+}
+
+/*-----------------------------------------------------------------------------
+  The page worker.  Pull a page off the queue, load or build it, and put it 
+  on the finished list.  Repeat until the module shuts down.
+-----------------------------------------------------------------------------*/
+
+static int page_worker (void* data)
+{
+
+  GLcoord   pos;
+  CPage*    p;
+
+  PlatformMutexLock (queue_lock);
+  while (!worker_quit) {
+    if (queue.empty ()) {
+      PlatformCondWait (queue_signal, queue_lock);
+      continue;
+    }
+    pos = queue.back ().pos;
+    queue.pop_back ();
+    worker_busy++;
+    PlatformMutexUnlock (queue_lock);
+    p = new CPage;
+    p->Cache (pos.x, pos.y);
+    p->Build ();
+    PlatformMutexLock (queue_lock);
+    worker_busy--;
+    finished.push_back (p);
+    //Wake anyone waiting for the queue to drain.
+    PlatformCondBroadcast (queue_signal);
+  }
+  PlatformMutexUnlock (queue_lock);
+  return 0;
+
+}
+
+/*-----------------------------------------------------------------------------
+  The page writer.  Take every page waiting to be saved, and store them as a 
+  batch.  Pages that were evicted while they waited are ours to delete.  
+  When the cache is purged, we're also the one to close the store, once 
+  everything before it has been written.
+-----------------------------------------------------------------------------*/
+
+static int page_writer (void* data)
+{
+
+  vector<CPage*>  batch;
+  unsigned        i;
+
+  PlatformMutexLock (write_lock);
+  while (true) {
+    if (writes.empty ()) {
+      if (write_close) {
+        PlatformMutexUnlock (write_lock);
+        StoreClose ();
+        PlatformMutexLock (write_lock);
+        write_close = false;
+        PlatformCondBroadcast (write_signal);
+        continue;
+      }
+      if (writer_quit)
+        break;
+      PlatformCondWait (write_signal, write_lock);
+      continue;
+    }
+    batch.swap (writes);
+    PlatformMutexUnlock (write_lock);
+    for (i = 0; i < batch.size (); i++)
+      batch[i]->Store ();
+    PlatformMutexLock (write_lock);
+    for (i = 0; i < batch.size (); i++) {
+      batch[i]->_saving = false;
+      if (batch[i]->_evicted)
+        delete batch[i];
+    }
+    written += batch.size ();
+    batch.clear ();
+  }
+  PlatformMutexUnlock (write_lock);
+  return 0;
+
+}
+
+//Move finished pages from the workers into the page table.
+static void page_publish ()
+{
+
+  vector<CPage*>  done;
+  vector<CPage*>  dirty;
+  CPage*          p;
+  GLcoord         pos;
+  unsigned        i;
+  bool            save;
+
+  PlatformMutexLock (queue_lock);
+  done.swap (finished);
+  PlatformMutexUnlock (queue_lock);
+  save = save_pages;
+  for (i = 0; i < done.size (); i++) {
+    p = done[i];
+    pos = p->Origin ();
+    requested[pos.x][pos.y] = false;
+    //Throw away a page that was built for some other world, or one that's
+    //already been replaced by another copy.
+    if (!p->Current () || page[pos.x][pos.y]) {
+      delete p;
+      continue;
+    }
+    page[pos.x][pos.y] = p;
+    page_count++;
+    p->Touch (now);
+    lru_push (p);
+    if (save && p->Dirty ()) {
+      p->_saving = true;
+      dirty.push_back (p);
+    }
+  }
+  if (dirty.empty ())
+    return;
+  PlatformMutexLock (write_lock);
+  writes.insert (writes.end (), dirty.begin (), dirty.end ());
+  PlatformCondSignal (write_signal);
+  PlatformMutexUnlock (write_lock);
 
 }
 
@@ -127,8 +614,8 @@ GLvector CacheNormal (int world_x, int world_y)
 bool CachePointAvailable (int world_x, int world_y)
 {
 
-  int     page_x, page_y;
-  CPage*  p;
+  int         page_x, page_y;
+  CPage*      p;
 
   world_x = max (0, world_x);
   world_y = max (0, world_y);
@@ -137,13 +624,14 @@ bool CachePointAvailable (int world_x, int world_y)
   if (page_x < 0 || page_x >= PAGE_GRID || page_y < 0 || page_y >= PAGE_GRID)
     return false;
   p = page[page_x][page_y];
-  if (!p) {
-    p = new CPage;
-    p->Cache (page_x, page_y);
-    page[page_x][page_y] = p;
-    page_count++;
+  if (p) {
+    hits++;
+    page_touch (p);
+    return p->Ready ();
   }
-  return p->Ready ();
+  if (page_request (page_x, page_y))
+    misses++;
+  return false;
 
 }
 
@@ -197,129 +685,615 @@ GLrgba CacheSurfaceColor (int world_x, int world_y)
 
 }
 
-/* Module functions ******************************************************/
+/*-----------------------------------------------------------------------------
+  Rectangle queries.  These fill the caller's array with a block of cells,
+  looking up and touching each page only once, instead of once per cell.
+  The output is laid out like the page planes, [x][y], so that:
 
-void CachePurge ()
+    out[(x - world_x) * height + (y - world_y)]
+
+  A query one cell wide gives a column, one cell high gives a row.  Cells 
+  with no page get the same values as the single-cell lookups.
+-----------------------------------------------------------------------------*/
+
+static int next_page_edge (int n)
 {
 
-  int     x, y;
+  if (n < 0)
+    return 0;
+  return (n / PAGE_SIZE + 1) * PAGE_SIZE;
+
+}
+
+template <class T>
+static void rect_fill (int world_x, int world_y, int width, int height, T* out, T fallback, void (CPage::*span)(int, int, int, T*))
+{
 
-  for (y = 0; y < PAGE_GRID; y++) {
-    for (x = 0; x < PAGE_GRID; x++) {
-      if (page[x][y]) {
-        page_count--;
-        page[x][y]->Save ();
-        delete page[x][y];
+  int     x, y, i, n;
+  int     x_end, y_end;
+  CPage*  p;
+  T*      dest;
+
+  for (x = world_x; x < world_x + width; x = x_end) {
+    x_end = min (next_page_edge (x), world_x + width);
+    for (y = world_y; y < world_y + height; y = y_end) {
+      y_end = min (next_page_edge (y), world_y + height);
+      p = page_lookup (x, y);
+      for (i = x; i < x_end; i++) {
+        dest = out + (i - world_x) * height + (y - world_y);
+        if (p) 
+          (p->*span) (i % PAGE_SIZE, y % PAGE_SIZE, y_end - y, dest);
+        else for (n = 0; n < y_end - y; n++) 
+          dest[n] = fallback;
       }
-      page[x][y] = NULL;
     }
   }
 
 }
 
-bool CacheSize (vector<string> *args)
+void CacheElevationRect (int world_x, int world_y, int width, int height, float* out)
 {
 
-  char          filespec[256];
-  _finddata32_t fd;
-  long          handle;
-  bool          more;
-  int           bytes;
-  int           files;
-
-  sprintf (filespec, "%s*.pag", GameDirectory ());
-  more = true;
-  bytes = 0;
-  files = 0;
-  handle = _findfirst (filespec, &fd);
-  while (handle && more) {
-    bytes += fd.size;  
-    files++;
-    if (_findnext (handle, &fd) != 0)
-      more = false;
-  }
-  _findclose(handle);
-  ConsoleLog ("Cache contains %d files, %d bytes used.", files, bytes);
-  return true;
+  rect_fill (world_x, world_y, width, height, out, -99.0f, &CPage::ElevationSpan);
 
 }
 
-bool CacheDump (vector<string> *args)
+void CacheNormalRect (int world_x, int world_y, int width, int height, GLvector* out)
 {
 
-  char          filespec[256];
-  char          file[256];
-  _finddata32_t fd;
-  long          handle;
-  bool          more;
+  rect_fill (world_x, world_y, width, height, out, glVector (0.0f, 0.0f, 1.0f), &CPage::NormalSpan);
 
-  CachePurge ();
-  sprintf (filespec, "%s*.pag", GameDirectory ());
-  more = true;
-  handle = _findfirst (filespec, &fd);
-  while (handle && more) {
-    sprintf (file, "%s%s", GameDirectory (), fd.name);
-    _unlink (file);
-    ConsoleLog (file);
-    if (_findnext (handle, &fd) != 0)
-      more = false;
+}
+
+void CacheSurfaceRect (int world_x, int world_y, int width, int height, SurfaceType* out)
+{
+
+  rect_fill (world_x, world_y, width, height, out, SURFACE_NULL, &CPage::SurfaceSpan);
+
+}
+
+void CacheSurfaceColorRect (int world_x, int world_y, int width, int height, GLrgba* out)
+{
+
+  rect_fill (world_x, world_y, width, height, out, glRgba (1.0f, 0.0f, 1.0f), &CPage::ColorSpan);
+
+}
+
+void CacheTreeRect (int world_x, int world_y, int width, int height, unsigned* out)
+{
+
+  rect_fill (world_x, world_y, width, height, out, 0u, &CPage::TreeSpan);
+
+}
+
+/*-----------------------------------------------------------------------------
+  Ray and range queries.  Each page has a pyramid of elevation bounds (see 
+  CPage.cpp), so we can throw out a whole block of terrain as soon as we see
+  the ray passes over the top of it.  Only at the smallest blocks do we 
+  actually step along the ray and compare it to the ground.
+
+  Pages that aren't resident are treated as empty, since we have no way of
+  knowing what's in them.
+-----------------------------------------------------------------------------*/
+
+//Clip the ray to the square at x,y with the given size. Returns false if it misses.
+static bool ray_clip (float x, float y, float size, GLvector start, GLvector dir, float* t0, float* t1)
+{
+
+  float   near_t, far_t, swap;
+
+  if (dir.x == 0.0f) {
+    if (start.x < x || start.x > x + size)
+      return false;
+  } else {
+    near_t = (x - start.x) / dir.x;
+    far_t = (x + size - start.x) / dir.x;
+    if (near_t > far_t) {
+      swap = near_t;
+      near_t = far_t;
+      far_t = swap;
+    }
+    *t0 = max (*t0, near_t);
+    *t1 = min (*t1, far_t);
   }
-  _findclose(handle);
-  return true;
+  if (dir.y == 0.0f) {
+    if (start.y < y || start.y > y + size)
+      return false;
+  } else {
+    near_t = (y - start.y) / dir.y;
+    far_t = (y + size - start.y) / dir.y;
+    if (near_t > far_t) {
+      swap = near_t;
+      near_t = far_t;
+      far_t = swap;
+    }
+    *t0 = max (*t0, near_t);
+    *t1 = min (*t1, far_t);
+  }
+  return *t0 <= *t1;
 
 }
 
+//Step along the ray through a single block, looking for where it meets the ground.
+static bool ray_march (GLvector start, GLvector dir, float t0, float t1, float* hit)
+{
 
-void CacheRenderDebug ()
+  GLvector  p;
+  float     t, above_t, mid;
+  int       i;
+
+  above_t = t0;
+  for (t = t0; ; t = min (t + RAY_STEP, t1)) {
+    p = start + dir * t;
+    if (p.z <= CacheElevation (p.x, p.y)) {
+      if (t == t0) {
+        *hit = t;
+        return true;
+      }
+      //We know it's between the last point above ground and here. Narrow it down.
+      for (i = 0; i < RAY_REFINE; i++) {
+        mid = (above_t + t) * 0.5f;
+        p = start + dir * mid;
+        if (p.z <= CacheElevation (p.x, p.y))
+          t = mid;
+        else
+          above_t = mid;
+      }
+      *hit = t;
+      return true;
+    }
+    above_t = t;
+    if (t >= t1)
+      return false;
+  }
+
+}
+
+static bool ray_node (CPage* p, int level, int bx, int by, GLvector start, GLvector dir, float t0, float t1, float* hit)
 {
 
-  int     x, y;
+  GLcoord   origin;
+  float     size, low, high;
+  float     child_t0[4], child_t1[4];
+  int       child_x[4], child_y[4];
+  int       order[4];
+  int       i, j, n, swap;
+
+  origin = p->Origin ();
+  size = (float)(PYRAMID_LEAF << level);
+  if (!ray_clip (origin.x * PAGE_SIZE + bx * size, origin.y * PAGE_SIZE + by * size, size, start, dir, &t0, &t1))
+    return false;
+  //If the ray is above the highest point in this block, it can't hit anything.
+  p->Bounds (level, bx, by, &low, &high);
+  if (min (start.z + dir.z * t0, start.z + dir.z * t1) > high)
+    return false;
+  if (level == 0)
+    return ray_march (start, dir, t0, t1, hit);
+  //Visit the children in the order the ray passes through them.
+  n = 0;
+  for (i = 0; i < 4; i++) {
+    child_x[n] = bx * 2 + i / 2;
+    child_y[n] = by * 2 + i % 2;
+    child_t0[n] = t0;
+    child_t1[n] = t1;
+    size = (float)(PYRAMID_LEAF << (level - 1));
+    if (!ray_clip (origin.x * PAGE_SIZE + child_x[n] * size, origin.y * PAGE_SIZE + child_y[n] * size, size, start, dir, &child_t0[n], &child_t1[n]))
+      continue;
+    order[n] = n;
+    for (j = n; j > 0 && child_t0[order[j - 1]] > child_t0[order[j]]; j--) {
+      swap = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = swap;
+    }
+    n++;
+  }
+  for (i = 0; i < n; i++) {
+    if (ray_node (p, level - 1, child_x[order[i]], child_y[order[i]], start, dir, child_t0[order[i]], child_t1[order[i]], hit))
+      return true;
+  }
+  return false;
+
+}
+
+//Cast a ray from start along dir, which must be normalized. If it hits the
+//ground within range, returns true and fills in how far along it hit.
+bool CacheRaycast (GLvector start, GLvector dir, float range, float* distance)
+{
 
-  for (y = 0; y < PAGE_GRID; y++) {
-    for (x = 0; x < PAGE_GRID; x++) {
-      if (page[x][y])
-        page[x][y]->Render ();
+  GLcoord   pos;
+  CPage*    p;
+  float     t, t_exit, hit;
+  float     next_x, next_y;
+
+  t = 0.0f;
+  while (t < range) {
+    //Which page are we in, and how far until we leave it?
+    p = NULL;
+    pos.x = (int)floor ((start.x + dir.x * t) / PAGE_SIZE);
+    pos.y = (int)floor ((start.y + dir.y * t) / PAGE_SIZE);
+    next_x = next_y = range;
+    if (dir.x > 0.0f)
+      next_x = ((pos.x + 1) * PAGE_SIZE - start.x) / dir.x;
+    else if (dir.x < 0.0f)
+      next_x = (pos.x * PAGE_SIZE - start.x) / dir.x;
+    if (dir.y > 0.0f)
+      next_y = ((pos.y + 1) * PAGE_SIZE - start.y) / dir.y;
+    else if (dir.y < 0.0f)
+      next_y = (pos.y * PAGE_SIZE - start.y) / dir.y;
+    t_exit = min (min (next_x, next_y), range);
+    if (pos.x >= 0 && pos.x < PAGE_GRID && pos.y >= 0 && pos.y < PAGE_GRID)
+      p = page[pos.x][pos.y];
+    if (p && p->Ready ()) {
+      page_touch (p);
+      if (ray_node (p, PYRAMID_LEVELS - 1, 0, 0, start, dir, t, t_exit, &hit)) {
+        if (distance)
+          *distance = hit;
+        return true;
+      }
     }
+    //Nudge past the edge so we don't land in the same page again.
+    t = max (t_exit, t + RAY_EPSILON);
   }
+  return false;
 
 }
 
-void CacheUpdate (long stop)
+//True if nothing but air lies between the two points.
+bool CacheLineOfSight (GLvector from, GLvector to)
 {
 
-  int   count;
+  GLvector  dir;
+  float     range;
 
-  //TextPrint ("%d pages. (%s)", page_count, TextBytes (sizeof (CPage) * page_count));
-  count = 0;
-  //Pass over the table a bit at a time and do garbage collection
-  while (count < (PAGE_GRID / 4) && SdlTick () < stop) {
-    if (page[walk.x][walk.y] && page[walk.x][walk.y]->Expired ()) {
-      page[walk.x][walk.y]->Save ();
-      delete page[walk.x][walk.y];
-      page[walk.x][walk.y] = NULL;
-      page_count--;
+  dir = to - from;
+  range = dir.Length ();
+  if (range == 0.0f)
+    return true;
+  dir /= range;
+  return !CacheRaycast (from, dir, range, NULL);
+
+}
+
+//Find the lowest and highest ground within the given block of cells. These
+//are bounds, not exact values: they may be a little wider than the truth.
+//Returns false if any of the block isn't resident yet.
+bool CacheElevationRange (int world_x, int world_y, int width, int height, float* low, float* high)
+{
+
+  int       x, y, x_end, y_end;
+  int       level, size;
+  int       bx, by, bx_end, by_end;
+  CPage*    p;
+  GLcoord   origin;
+  float     block_low, block_high;
+  bool      complete;
+
+  *low = FLT_MAX;
+  *high = -FLT_MAX;
+  complete = true;
+  for (x = max (world_x, 0); x < world_x + width; x = x_end) {
+    x_end = min (next_page_edge (x), world_x + width);
+    for (y = max (world_y, 0); y < world_y + height; y = y_end) {
+      y_end = min (next_page_edge (y), world_y + height);
+      p = page_lookup (x, y);
+      if (!p || !p->Ready ()) {
+        complete = false;
+        continue;
+      }
+      origin = p->Origin ();
+      //Use the coarsest level whose blocks still fit inside the query.
+      for (level = PYRAMID_LEVELS - 1; level > 0; level--) {
+        size = PYRAMID_LEAF << level;
+        if (size <= x_end - x && size <= y_end - y)
+          break;
+      }
+      size = PYRAMID_LEAF << level;
+      bx_end = (x_end - origin.x * PAGE_SIZE - 1) / size;
+      by_end = (y_end - origin.y * PAGE_SIZE - 1) / size;
+      for (bx = (x - origin.x * PAGE_SIZE) / size; bx <= bx_end; bx++) {
+        for (by = (y - origin.y * PAGE_SIZE) / size; by <= by_end; by++) {
+          p->Bounds (level, bx, by, &block_low, &block_high);
+          *low = min (*low, block_low);
+          *high = max (*high, block_high);
+        }
+      }
     }
-    count++;
-    walk.Walk (PAGE_GRID);
-  }  
+  }
+  return complete;
 
 }
 
+/* Module functions ******************************************************/
+
+void CacheInit ()
+{
+
+  int           i;
+
+  StoreInit ();
+  //Force the entropy map to load now, before the workers start asking for it.
+  Entropy (0, 0);
+  queue_lock = PlatformMutexCreate ();
+  queue_signal = PlatformCondCreate ();
+  worker_quit = false;
+  write_lock = PlatformMutexCreate ();
+  write_signal = PlatformCondCreate ();
+  writer_quit = false;
+  write_close = false;
+  writer = PlatformThreadCreate (page_writer, NULL);
+  //Leave one core for the main thread.
+  worker_count = PlatformCores () - 1;
+  worker_count = clamp (worker_count, 1, MAX_WORKERS);
+  for (i = 0; i < worker_count; i++)
+    worker[i] = PlatformThreadCreate (page_worker, NULL);
+  ConsoleLog ("CacheInit: %d page workers.", worker_count);
+
+}
+
+void CacheTerm ()
+{
+
+  int     i;
+
+  PlatformMutexLock (queue_lock);
+  worker_quit = true;
+  queue.clear ();
+  PlatformCondBroadcast (queue_signal);
+  PlatformMutexUnlock (queue_lock);
+  for (i = 0; i < worker_count; i++)
+    PlatformThreadWait (worker[i]);
+  worker_count = 0;
+  for (i = 0; i < (int)finished.size (); i++)
+    delete finished[i];
+  finished.clear ();
+  PlatformCondDestroy (queue_signal);
+  PlatformMutexDestroy (queue_lock);
+  //The writer finishes whatever is left, and closes the store on its way out.
+  PlatformMutexLock (write_lock);
+  writer_quit = true;
+  write_close = true;
+  PlatformCondBroadcast (write_signal);
+  PlatformMutexUnlock (write_lock);
+  PlatformThreadWait (writer);
+  PlatformCondDestroy (write_signal);
+  PlatformMutexDestroy (write_lock);
+  StoreTerm ();
+
+}
+
+void CachePurge ()
+{
+
+  unsigned  i;
+
+  //Cancel anything still waiting, and let the workers finish what they're doing. 
+  PlatformMutexLock (queue_lock);
+  queue.clear ();
+  while (worker_busy) 
+    PlatformCondWait (queue_signal, queue_lock);
+  for (i = 0; i < finished.size (); i++)
+    delete finished[i];
+  finished.clear ();
+  PlatformMutexUnlock (queue_lock);
+  while (lru_head)
+    page_evict (lru_head);
+  memset (requested, 0, sizeof (requested));
+  //The world is about to change, so we're done with this store. The writer
+  //will close it once it's caught up.
+  PlatformMutexLock (write_lock);
+  write_close = true;
+  PlatformCondSignal (write_signal);
+  PlatformMutexUnlock (write_lock);
+
+}
 
 /*-----------------------------------------------------------------------------
-  Request an update to a specific zone.  This can be called by Terrains, 
-  which are waiting for the zone.
+  Build every page in the given block (in pages, which are one region each) 
+  and write it to the store for the current world, using all the workers.  
+  Pages already in the store are left alone.  Nothing goes into the page 
+  table, so this is only for filling the store ahead of time.  Returns the 
+  number of pages built, and how many bytes they took up on disk.
 -----------------------------------------------------------------------------*/
 
-void CacheUpdatePage (int world_x, int world_y, long stop)
+int CacheBake (GLcoord origin, GLcoord size, unsigned long long* bytes)
 {
 
-  CPage*   p;
-  
-  p = page_lookup (world_x, world_y);
-  if (!p) 
-    return;
-  p->Build (stop);
+  vector<CPage*>  done;
+  PageRequest     r;
+  int             x, y;
+  int             built;
+  int             pages;
+  unsigned long long  bytes_used, bytes_before, bytes_file;
+  unsigned        i;
+
+  store_check ();
+  StoreInfo (&pages, &bytes_before, &bytes_file);
+  built = 0;
+  PlatformMutexLock (queue_lock);
+  r.priority = 0.0f;
+  for (x = max (origin.x, 0); x < min (origin.x + size.x, PAGE_GRID); x++) {
+    for (y = max (origin.y, 0); y < min (origin.y + size.y, PAGE_GRID); y++) {
+      r.pos.x = x;
+      r.pos.y = y;
+      queue.push_back (r);
+    }
+  }
+  PlatformCondBroadcast (queue_signal);
+  //The workers wake us each time they finish a page.
+  while (!queue.empty () || worker_busy || !finished.empty ()) {
+    if (finished.empty ()) {
+      PlatformCondWait (queue_signal, queue_lock);
+      continue;
+    }
+    done.swap (finished);
+    PlatformMutexUnlock (queue_lock);
+    for (i = 0; i < done.size (); i++) {
+      if (done[i]->Dirty ()) {
+        done[i]->Store ();
+        built++;
+      }
+      delete done[i];
+    }
+    done.clear ();
+    PlatformMutexLock (queue_lock);
+  }
+  PlatformMutexUnlock (queue_lock);
+  StoreFlush ();
+  StoreInfo (&pages, &bytes_used, &bytes_file);
+  *bytes = bytes_used > bytes_before ? bytes_used - bytes_before : 0;
+  return built;
+
+}
+
+bool CacheStats (vector<string> *args)
+{
+
+  unsigned    total;
+  unsigned    waiting, unwritten, stored;
+
+  //The workers and the writer change these, so take a copy under their locks.
+  PlatformMutexLock (queue_lock);
+  waiting = (unsigned)queue.size ();
+  PlatformMutexUnlock (queue_lock);
+  PlatformMutexLock (write_lock);
+  unwritten = (unsigned)writes.size ();
+  stored = written;
+  PlatformMutexUnlock (write_lock);
+  total = hits + misses;
+  ConsoleLog ("%d pages resident, %s of %dMb budget.", page_count, bytes_text (page_count * (int)sizeof (CPage)), budget);
+  ConsoleLog ("%u hits, %u misses (%1.1f%% hit rate), %u evictions.", 
+    hits, misses, total ? (float)hits * 100.0f / (float)total : 0.0f, evictions);
+  ConsoleLog ("%u requests waiting, %u cancelled, %u prefetched.", waiting, cancelled, prefetches);
+  ConsoleLog ("%u pages waiting to be written, %u written.", unwritten, stored);
+  return true;
+
+}
+
+bool CacheSize (vector<string> *args)
+{
+
+  int           x, y;
+  int           pages;
+  unsigned long long  bytes_used, bytes_file;
+  int           decoded;
+  CPage*        p;
+  double        seconds;
+
+  if (!StoreIsOpen ()) {
+    ConsoleLog ("No page store is open.");
+    return true;
+  }
+  StoreInfo (&pages, &bytes_used, &bytes_file);
+  ConsoleLog ("Page store holds %d pages, %s in use, %s on disk. (%s per page, %s in memory)", 
+    pages, bytes_text (bytes_used), bytes_text (bytes_file), 
+    bytes_text (pages ? bytes_used / pages : 0), bytes_text (sizeof (CPage)));
+  //Time how long it takes to unpack a sample of the pages.
+  decoded = 0;
+  p = new CPage;
+  seconds = PlatformSeconds ();
+  for (y = 0; y < PAGE_GRID && decoded < CACHE_SIZE_SAMPLE; y++) {
+    for (x = 0; x < PAGE_GRID && decoded < CACHE_SIZE_SAMPLE; x++) {
+      if (p->Load (x, y))
+        decoded++;
+    }
+  }
+  delete p;
+  seconds = PlatformSeconds () - seconds;
+  if (decoded && seconds > 0.0) 
+    ConsoleLog ("Decoded %d pages in %1.2fms: %1.1f pages/sec, %s/sec unpacked.", 
+      decoded, seconds * 1000.0, decoded / seconds, bytes_text ((unsigned long long)(decoded * sizeof (CPage) / seconds)));
+  return true;
+
+}
+
+bool CacheNormalBenchmark (vector<string> *args)
+{
+
+  GLvector    pos;
+  CPage*      p;
+  double      reference, kernel;
+  int         scalar_differ, reference_differ;
+
+  pos = view_position;
+  p = page_lookup ((int)pos.x, (int)pos.y);
+  if (!p || !p->Ready ()) {
+    ConsoleLog ("The page under the avatar isn't ready.");
+    return true;
+  }
+  p->NormalBenchmark (NORMAL_PASSES, &reference, &kernel, &scalar_differ, &reference_differ);
+  ConsoleLog ("Normals for %d pages: %1.2fms per page cell by cell, %1.2fms per page in rows (%1.1fx faster).", 
+    NORMAL_PASSES, reference * 1000.0 / NORMAL_PASSES, kernel * 1000.0 / NORMAL_PASSES, 
+    kernel > 0.0 ? reference / kernel : 0.0);
+  ConsoleLog ("%d cells differ from the plain C kernel, %d from the cell by cell path.", 
+    scalar_differ, reference_differ);
+  return true;
+
+}
+
+bool CacheDump (vector<string> *args)
+{
+
+  char          filename[256];
+
+  CachePurge ();
+  store_wait ();
+  remove (store_file_name (filename));
+  ConsoleLog ("Deleted %s", filename);
+  return true;
 
 }
 
+
+//Every resident page, for the debug view.
+void CacheResident (vector<CPage*>* out)
+{
+
+  CPage*  p;
+
+  out->clear ();
+  for (p = lru_head; p; p = p->_lru_next)
+    out->push_back (p);
+
+}
+
+//How much memory to spend on pages, and whether to save the ones we build.
+void CacheConfigure (int budget_in, bool save)
+{
+
+  budget = max (budget_in, 1);
+  save_pages = save;
+
+}
+
+//Where the avatar is, where the camera is pointed, and how fast we're going.
+//Requests are ordered by this, and we only prefetch if asked to.
+void CacheView (GLvector position, GLvector camera_angle, GLvector velocity, bool prefetch)
+{
+
+  view_position = position;
+  view_angle = camera_angle;
+  view_velocity = velocity;
+  view_prefetch = prefetch;
+
+}
+
+void CacheUpdate (long stop)
+{
+
+  int   limit;
+
+  now = PlatformTick ();
+  page_publish ();
+  cache_prefetch ();
+  queue_update ();
+  //TextPrint ("%d pages. (%s)", page_count, TextBytes (sizeof (CPage) * page_count));
+  //Throw out the coldest pages until we're back under budget.
+  limit = (budget * MEGABYTE) / sizeof (CPage);
+  while (page_count > limit && lru_tail && PlatformTick () < stop) {
+    if (lru_tail->LastTouched () + CACHE_PROTECT > now)
+      break;
+    page_evict (lru_tail);
+    evictions++;
+  }
+
+}
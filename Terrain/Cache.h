@@ -1,8 +1,14 @@
 //Module functions
+int  CacheBake (GLcoord origin, GLcoord size, unsigned long long* bytes);
+void CacheConfigure (int budget, bool save);
+void CacheInit ();
 void CachePurge ();
-void CacheRenderDebug ();
+void CacheResident (vector<class CPage*>* out);
+void CacheTerm ();
 void CacheUpdate (long stop);
-void CacheUpdatePage (int world_x, int world_y, long stop);
+void CacheView (GLvector position, GLvector camera_angle, GLvector velocity, bool prefetch);
+//This one is in CacheRender.cpp, with the game.
+void CacheRenderDebug ();
 
 //Look up individual cell data
 
@@ -12,9 +18,23 @@ bool        CacheDump (vector<string> *args);
 float       CacheElevation (int world_x, int world_y);
 float       CacheElevation (float x, float y);
 GLvector    CacheNormal (int world_x, int world_y);
+bool        CacheNormalBenchmark (vector<string> *args);
 bool        CachePointAvailable (int world_x, int world_y);
 GLvector    CachePosition (int world_x, int world_y);
 bool        CacheSize (vector<string> *args);
+bool        CacheStats (vector<string> *args);
 SurfaceType CacheSurface (int world_x, int world_y);
 GLrgba      CacheSurfaceColor (int world_x, int world_y);
-unsigned    CacheTree (int world_x, int world_y);
\ No newline at end of file
+unsigned    CacheTree (int world_x, int world_y);
+
+//Look up blocks of cells. Output is [x][y]: out[x * height + y]
+void        CacheElevationRect (int world_x, int world_y, int width, int height, float* out);
+void        CacheNormalRect (int world_x, int world_y, int width, int height, GLvector* out);
+void        CacheSurfaceRect (int world_x, int world_y, int width, int height, SurfaceType* out);
+void        CacheSurfaceColorRect (int world_x, int world_y, int width, int height, GLrgba* out);
+void        CacheTreeRect (int world_x, int world_y, int width, int height, unsigned* out);
+
+//Queries against the pyramid of elevation bounds kept by each page.
+bool        CacheElevationRange (int world_x, int world_y, int width, int height, float* low, float* high);
+bool        CacheLineOfSight (GLvector from, GLvector to);
+bool        CacheRaycast (GLvector start, GLvector dir, float range, float* distance);
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*-----------------------------------------------------------------------------
+
+  CacheRender.cpp
+
+-------------------------------------------------------------------------------
+
+  The debug view of the page cache: a box around each resident page, going
+  from green to red as it goes unused.  The cache itself is part of the core
+  library, and doesn't draw anything.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include "Cache.h"
+#include "Cpage.h"
+#include "Platform.h"
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void CPage::Render ()
+{
+
+  int     elapsed;
+  float   n;
+
+  glDisable (GL_TEXTURE_2D);
+  glDisable (GL_LIGHTING);
+  elapsed = PlatformTick () - _last_touched;
+  n = (float)elapsed / PAGE_EXPIRE;
+  n = clamp (n, 0.0f, 1.0f);
+  glColor3f (n, 1.0f - n, 0.0f);
+  _bbox.Render ();
+
+}
+
+void CacheRenderDebug ()
+{
+
+  vector<CPage*>  resident;
+  unsigned        i;
+
+  CacheResident (&resident);
+  for (i = 0; i < resident.size (); i++)
+    resident[i]->Render ();
+
+}
@@ -0,0 +1,121 @@
+/*-----------------------------------------------------------------------------
+
+  Core.h
+
+-------------------------------------------------------------------------------
+
+  The common header for the engine core: the world, the pages, and the 
+  meshes built from them.  Unlike stdafx.h, this pulls in nothing from SDL, 
+  OpenGL, or Windows, so the core can be built on its own.  What the core 
+  needs from the platform, it asks for through platform.h.
+
+-----------------------------------------------------------------------------*/
+
+#ifndef CORE_H
+#define CORE_H
+
+#define WRAP(x,y)                 ((unsigned)x % y)
+#define SIGN(x)                   (((x) > 0) ? 1 : ((x) < 0) ? -1 : 0)
+#define SIGNF(x)                  (((x) > NEGLIGIBLE) ? 1 : ((x) < -NEGLIGIBLE) ? -1 : 0)
+#define ABS(x)                    (((x) < 0 ? (-x) : (x)))
+#define SMALLEST(x,y)             (ABS(x) < ABS(y) ? 0 : x)                
+#define SWAP(a,b)                 {int temp = a;a = b; b = temp;}
+#define SWAPF(a,b)                {float temp = a;a = b; b = temp;}
+#define ARGS(text, args)          { va_list		ap;	text[0] = 0; if (args != NULL)	{ va_start(ap, args); vsprintf(text, args, ap); va_end(ap);}	}
+#define ISNAN(x)                  ((x) != (x))
+#define INTERPOLATE(a,b,delta)    (a * (1.0f - delta) + b * delta)
+#define clamp(n,lower,upper)      (max (min(n,(upper)), (lower)))
+
+#define FREEZING                  0.32f
+#define TEMP_COLD                 0.45f
+#define TEMP_TEMPERATE            0.6f
+#define TEMP_HOT                  0.9f
+#define MIN_TEMP                  0.0f
+#define MAX_TEMP                  1.0f
+#define DEGREES_TO_RADIANS        .017453292F
+#define RADIANS_TO_DEGREES        57.29577951F
+#define NEGLIGIBLE                0.000000000001f
+#define PI                        (3.1415926535f)
+#define GRAVITY                   9.5f
+
+//This is used to scale the z value of normals
+//Nower numbers make the normals more extreme, exaggerate the lighting
+#define NORMAL_SCALING    0.6f
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+//The game gets these from windows.h, which defines them the same way.  They
+//have to come after the standard headers, which won't compile around them.
+#ifndef max
+#define max(a,b)                  (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a,b)                  (((a) < (b)) ? (a) : (b))
+#endif
+
+typedef unsigned char             UCHAR;
+typedef unsigned char             byte;
+typedef unsigned int              UINT;
+
+#include "glTypes.h"
+
+enum SurfaceColor
+{
+  SURFACE_COLOR_BLACK,
+  SURFACE_COLOR_SAND,
+  SURFACE_COLOR_DIRT,
+  SURFACE_COLOR_GRASS,
+  SURFACE_COLOR_ROCK,
+  SURFACE_COLOR_SNOW,
+};
+
+enum SurfaceType
+{
+  SURFACE_NULL,
+  SURFACE_SAND_DARK,
+  SURFACE_SAND,
+  SURFACE_DIRT_DARK,
+  SURFACE_DIRT,
+  SURFACE_FOREST,
+  SURFACE_EDGE,
+  SURFACE_GRASS,
+  SURFACE_GRASS_EDGE,
+  SURFACE_DEEPGRASS,
+  SURFACE_ROCK,
+  SURFACE_SNOW,
+  SURFACE_TYPES
+};
+
+enum LOD
+{
+  LOD_LOW,
+  LOD_MED,
+  LOD_HIGH,
+  LOD_LEVELS
+};
+
+enum
+{
+  NORTH,
+  SOUTH,
+  EAST,
+  WEST
+};
+
+struct Cell
+{
+  float elevation;
+  float water_level;
+  float detail;
+};
+
+#endif
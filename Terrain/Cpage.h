@@ -1,6 +1,6 @@
 #define PAGE_SIZE       128
 #define PAGE_HALF       (PAGE_SIZE / 2)
-#define PAGE_EXPIRE     30000 //milliseconds
+#define PAGE_EXPIRE     30000 //milliseconds. Only used to color the debug view.
 #define TREE_SPACING    8 //Power of 2, how far apart trees should be. (Roughly)
 #define TREE_MAP        (PAGE_SIZE / TREE_SPACING)
 
@@ -17,33 +17,81 @@ enum
   PAGE_STAGE_DONE
 };
 
-struct pcell
+//Elevations are stored as unsigned shorts, in steps of 1/ELEVATION_STEPS meters
+//above ELEVATION_FLOOR.  That gives a range of -512 to +1536 meters.
+#define ELEVATION_STEPS   32
+#define ELEVATION_FLOOR   -512.0f
+
+//Each page keeps a pyramid of elevation bounds.  The bottom level splits the 
+//page into blocks of PYRAMID_LEAF cells on a side, and each level above 
+//merges four blocks into one, up to a single block for the whole page.
+#define PYRAMID_LEAF      4
+#define PYRAMID_BASE      (PAGE_SIZE / PYRAMID_LEAF)
+#define PYRAMID_LEVELS    6
+#define PYRAMID_NODES     (32*32 + 16*16 + 8*8 + 4*4 + 2*2 + 1)
+
+//Values only needed while the page is being built.  These are thrown away
+//once the page is done, so they never take up space in the cache.
+struct pscratch
 {
-  UCHAR       surface;
-  float       water_level;
-  float       elevation;
-  float       detail;
-  GLrgba      color;
-  GLvector    normal;
-  short       tree_id;
+  float       elevation[PAGE_SIZE][PAGE_SIZE];
+  float       detail[PAGE_SIZE][PAGE_SIZE];
+  float       water_level[PAGE_SIZE][PAGE_SIZE];
+  //Elevations of the cells just outside the page, taken from the world. 
+  //East includes the far corner, at y = PAGE_SIZE.
+  float       apron_west[PAGE_SIZE];
+  float       apron_east[PAGE_SIZE + 1];
+  float       apron_south[PAGE_SIZE];
+  float       apron_north[PAGE_SIZE];
+  //Lowest and highest elevation in the neighborhood of each cell.
+  float       low[PAGE_SIZE][PAGE_SIZE];
+  float       high[PAGE_SIZE][PAGE_SIZE];
 };
 
 class CPage
 {
   GLcoord         _origin;
+  //The world this page was made for.  It's written out on another thread,
+  //which may not get to it until the world has changed.
+  unsigned        _seed;
+  unsigned        _generator;
   GLcoord         _walk;
   int             _stage;
-  pcell           _cell[PAGE_SIZE][PAGE_SIZE];
   GLbbox          _bbox;
-  int             _last_touched;
+  long            _last_touched;
+  pscratch*       _scratch;
+  bool            _dirty;
+  //Each property of a cell is kept in its own plane.
+  unsigned short  _elevation[PAGE_SIZE][PAGE_SIZE];
+  UCHAR           _detail[PAGE_SIZE][PAGE_SIZE];
+  UCHAR           _normal[PAGE_SIZE][PAGE_SIZE][2];
+  UCHAR           _color[PAGE_SIZE][PAGE_SIZE][3];
+  UCHAR           _surface[PAGE_SIZE][PAGE_SIZE];
+  UCHAR           _tree[PAGE_SIZE][PAGE_SIZE];
+  //Low and high elevation bounds for each block in the pyramid.
+  unsigned short  _bound[PYRAMID_NODES][2];
 
+  void            DoApron ();
+  void            DoBounds ();
   void            DoTrees ();
   void            DoPosition ();
   void            DoSurface ();
   void            DoColor ();
   void            DoNormal ();
+  void            Encode (UCHAR* out);
+  void            Decode (const UCHAR* in);
 public:
+  //Cache.cpp keeps resident pages in a list, most recently used first.
+  CPage*          _lru_prev;
+  CPage*          _lru_next;
+  //Set while Cache.cpp's writer thread has this page queued. If the page is
+  //evicted meanwhile, the writer deletes it once it's written.
+  bool            _saving;
+  bool            _evicted;
+
   void            Cache (int origin_x, int origin_y);
+  GLcoord         Origin () { return _origin; };
+  bool            Load (int origin_x, int origin_y);
   float           Elevation (int x, int y);
   float           Detail (int x, int y);
   GLvector        Position (int x, int y);
@@ -51,9 +99,23 @@ public:
   unsigned        Tree (int x, int y);
   GLrgba          Color (int x, int y);
   SurfaceType     Surface (int x, int y);
-  void            Save ();
-  void            Build (int stop);
+  //Copy count cells, starting at x,y and running along y.
+  void            ElevationSpan (int x, int y, int count, float* out);
+  void            NormalSpan (int x, int y, int count, GLvector* out);
+  void            ColorSpan (int x, int y, int count, GLrgba* out);
+  void            SurfaceSpan (int x, int y, int count, SurfaceType* out);
+  void            TreeSpan (int x, int y, int count, unsigned* out);
+  //Elevation range of block x,y at the given pyramid level. Level 0 is finest.
+  void            Bounds (int level, int x, int y, float* low, float* high);
+  //Time the normal kernel against the old cell-at-a-time path, and compare them.
+  void            NormalBenchmark (int passes, double* reference, double* kernel, int* scalar_differ, int* reference_differ);
+  void            Store ();
+  void            Build ();
+  bool            Dirty () { return _dirty; };
+  //True if this page was made for the world we have now.
+  bool            Current ();
   void            Render ();
   bool            Ready ();
-  bool            Expired ();
+  void            Touch (long now) { _last_touched = now; };
+  long            LastTouched () { return _last_touched; };
 };
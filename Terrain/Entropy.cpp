@@ -9,10 +9,9 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 #include <stdio.h>
-#include "file.h"
-#include "texture.h"
+#include "File.h"
 
 #define ENTROPY_FILE      "entropy.raw"
 #define BLUR_RADIUS       3
@@ -155,7 +154,7 @@ static void entropy_erode ()
 
 }
 
-static void entropy_create (char* filename)
+static void entropy_create (const char* filename)
 {
 
   FILE*           file;
@@ -173,6 +172,8 @@ static void entropy_create (char* filename)
     return;
 	fclose (file);
   buffer = FileImageLoad (filename, &size);
+  if (!buffer)
+    return;
   elements = size.x * size.y;
   emap = new float [elements];
   for (y = 0; y < size.y; y++) {
@@ -216,7 +217,7 @@ static void entropy_load ()
     fclose (file);
     loaded = true;
   } else
-    entropy_create ("textures/noise256.bmp");
+    entropy_create ("Textures/noise256.bmp");
 
 }
 
@@ -4,20 +4,14 @@
 
 -------------------------------------------------------------------------------
 
-  Various useful file i/o functions.
+  Various useful file i/o functions.  Anything that isn't plain stdio goes 
+  through the platform layer, so this is part of the engine core.
 
 -----------------------------------------------------------------------------*/
 
-#include "StdAfx.h"
-#include <windows.h>
-#include <direct.h>
-#include <stdio.h>
-#include <io.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/utime.h>
+#include "Core.h"
+#include "File.h"
+#include "Platform.h"
 
 /*-----------------------------------------------------------------------------
 
@@ -26,16 +20,7 @@
 long FileModified (char *filename)
 {
 
-  long                search;
-  struct _finddata_t  info;
-  DWORD               timestamp;
-
-  timestamp = 0;
-  if ((search = _findfirst (filename, &info)) != -1) {
-    timestamp = info.time_write;
-    _findclose (search);
-  } 
-  return timestamp;
+  return PlatformFileModified (filename);
 
 }
 
@@ -46,7 +31,7 @@ long FileModified (char *filename)
 bool FileDelete (char* name)
 {
 
-  if (!_unlink (name))
+  if (!remove (name))
     return true;
   return false;
 
@@ -59,16 +44,16 @@ bool FileDelete (char* name)
 bool FileSave (char *name, char *buf, int size)
 {
 
-  int fd;
+  FILE*   f;
 
-  if ((fd = _open (name, O_WRONLY | O_BINARY | O_CREAT | O_TRUNC, S_IREAD | S_IWRITE)) == -1)
+  if (!(f = fopen (name, "wb")))
     return false;
-  if (_write (fd, buf, size) != size) {
-    _close (fd);
-    _unlink (name);
+  if (fwrite (buf, 1, size, f) != (size_t)size) {
+    fclose (f);
+    remove (name);
     return false;
   }
-  _close (fd);
+  fclose (f);
   return true;
 
 }
@@ -77,22 +62,31 @@ bool FileSave (char *name, char *buf, int size)
 
 -----------------------------------------------------------------------------*/
 
+static int file_length (FILE* f)
+{
+
+  long      len;
+
+  fseek (f, 0, SEEK_END);
+  len = ftell (f);
+  fseek (f, 0, SEEK_SET);
+  return (int)len;
+
+}
+
 char* FileLoad (char* name, long* size)
 {
   FILE*     f;
   char*     buffer;
-  int       h;
   int       len;
 
   buffer = NULL;
   len = 0;
-  h = _open (name, _O_RDONLY | O_BINARY);
-  if (h != -1) {
+  f = fopen (name, "rb");
+  if (f) {
     //set file size
-    len = _filelength (h) + 1;
-    _close (h);
+    len = file_length (f) + 1;
     buffer = (char*)malloc (len);
-    f = fopen (name, "rb");
     fread (buffer, 1, len, f);
     fclose (f);
     //terminate string
@@ -109,18 +103,15 @@ char* FileBinaryLoad (char* name, long* size)
 {
   FILE*     f;
   char*     buffer;
-  int       h;
   int       len;
 
   buffer = NULL;
   len = 0;
-  h = _open (name, _O_RDONLY | O_BINARY);
-  if (h != -1) {
+  f = fopen (name, "rb");
+  if (f) {
     //set file size
-    len = _filelength (h);
-    _close (h);
+    len = file_length (f);
     buffer = (char*)malloc (len);
-    f = fopen (name, "rb");
     fread (buffer, 1, len, f);
     fclose (f);
   }
@@ -155,7 +146,7 @@ bool FileExists (const char *name)
 void FileTouch (char *filename)
 {
 
-  _utime (filename, NULL);
+  PlatformFileTouch (filename);
 
 }
 
@@ -168,30 +159,20 @@ void FileMakeDirectory (char* folder)
 
   char*   dir;
   char*   p;
-  char*   p1;
-  int     errcode;
+  char    separator;
 
+  //Make each folder along the way, in case they don't exist yet.
   dir = (char*)malloc (strlen (folder) + 1);
   strcpy (dir, folder);
-  if (!(p = strchr (dir, '\\')))
-    p = strchr (dir, '/');
-  p1 = p;
-  while (p && p1) {
+  for (p = dir; *p; p++) {
+    if (p == dir || (*p != '\\' && *p != '/'))
+      continue;
+    separator = *p;
     *p = '\0';
-    _mkdir (dir);
-    *p = '\\';
-    p1++;
-    if (p == NULL || p1 == NULL ||  *p == 0x0 || *p1 == 0x0)
-      break;
-    if (!(p = strchr (p1, '\\')))    
-      if (!(p = strchr (p1, '/')))
-        break;
-    p1 = p;
+    PlatformFolderMake (dir);
+    *p = separator;
   }
-
-  errcode = 0;
-  if (_mkdir (folder))
-    errcode = errno;
+  PlatformFolderMake (dir);
   free (dir);
 
-}
\ No newline at end of file
+}
@@ -8,5 +8,6 @@ long  FileModified (char *filename);
 bool  FileSave (char *name, char *buf, int size);
 void  FileTouch (char *filename);
 bool  FileXLoad (char* filename, class CFigure* fig);
-char* FileImageLoad (char* filename, GLcoord* size_in);
+char* FileImageLoad (const char* filename, GLcoord* size_in);
+bool  FileImageSave (char* filename, unsigned char* rgb, GLcoord size);
 
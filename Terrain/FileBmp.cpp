@@ -0,0 +1,161 @@
+/*-----------------------------------------------------------------------------
+
+  FileBmp.cpp
+
+-------------------------------------------------------------------------------
+
+  The core library's image files.  The game opens images with devIL (see
+  FileImage.cpp) but the core only ever needs the entropy bitmap, so this
+  reads uncompressed 24 and 32 bit BMP files and nothing else.  Images come
+  back the same way devIL gives them to the game: RGBA, bottom row first.
+  Unlike the devIL loader, this returns NULL if it can't read the file.
+
+  Saved images are always 24 bit BMP files, whatever the filename says.
+
+-----------------------------------------------------------------------------*/
+
+#include "Core.h"
+#include "File.h"
+
+#define BMP_MAGIC         0x4D42 //"BM"
+#define BMP_HEADER        54
+#define BMP_UNCOMPRESSED  0
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+//BMP fields are little-endian, whatever the machine is.
+static unsigned read_short (const UCHAR* p)
+{
+
+  return p[0] | (p[1] << 8);
+
+}
+
+static unsigned read_long (const UCHAR* p)
+{
+
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+
+}
+
+static void write_short (UCHAR* p, unsigned val)
+{
+
+  p[0] = (UCHAR)(val & 0xFF);
+  p[1] = (UCHAR)((val >> 8) & 0xFF);
+
+}
+
+static void write_long (UCHAR* p, unsigned val)
+{
+
+  write_short (p, val & 0xFFFF);
+  write_short (p + 2, val >> 16);
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+char* FileImageLoad (const char* filename, GLcoord* size_in)
+{
+
+  FILE*           f;
+  UCHAR           header[BMP_HEADER];
+  UCHAR*          row;
+  UCHAR*          out;
+  GLcoord         size;
+  int             x, y, yy;
+  int             bpp, pitch;
+  unsigned        offset;
+  bool            top_down;
+
+  if (!(f = fopen (filename, "rb")))
+    return NULL;
+  if (fread (header, 1, BMP_HEADER, f) != BMP_HEADER || read_short (header) != BMP_MAGIC) {
+    fclose (f);
+    return NULL;
+  }
+  offset = read_long (header + 10);
+  size.x = (int)read_long (header + 18);
+  size.y = (int)read_long (header + 22);
+  bpp = read_short (header + 28) / 8;
+  if ((bpp != 3 && bpp != 4) || read_long (header + 30) != BMP_UNCOMPRESSED || size.x <= 0 || size.y == 0) {
+    fclose (f);
+    return NULL;
+  }
+  //A negative height means the rows are stored top to bottom.
+  top_down = size.y < 0;
+  size.y = abs (size.y);
+  //Rows are padded out to 4 bytes.
+  pitch = (size.x * bpp + 3) & ~3;
+  row = new UCHAR[pitch];
+  out = new UCHAR[size.x * size.y * 4];
+  fseek (f, offset, SEEK_SET);
+  for (y = 0; y < size.y; y++) {
+    if (fread (row, 1, pitch, f) != (size_t)pitch) {
+      delete[] row;
+      delete[] out;
+      fclose (f);
+      return NULL;
+    }
+    yy = top_down ? (size.y - 1) - y : y;
+    for (x = 0; x < size.x; x++) {
+      out[(x + yy * size.x) * 4 + 0] = row[x * bpp + 2];
+      out[(x + yy * size.x) * 4 + 1] = row[x * bpp + 1];
+      out[(x + yy * size.x) * 4 + 2] = row[x * bpp + 0];
+      out[(x + yy * size.x) * 4 + 3] = bpp == 4 ? row[x * bpp + 3] : 255;
+    }
+  }
+  delete[] row;
+  fclose (f);
+  if (size_in)
+    *size_in = size;
+  return (char*)out;
+
+}
+
+//Save an RGB image, bottom row first.
+bool FileImageSave (char* filename, unsigned char* rgb, GLcoord size)
+{
+
+  FILE*           f;
+  UCHAR           header[BMP_HEADER];
+  UCHAR*          row;
+  int             x, y;
+  int             pitch;
+  bool            ok;
+
+  if (!(f = fopen (filename, "wb")))
+    return false;
+  pitch = (size.x * 3 + 3) & ~3;
+  memset (header, 0, BMP_HEADER);
+  write_short (header, BMP_MAGIC);
+  write_long (header + 2, BMP_HEADER + pitch * size.y);
+  write_long (header + 10, BMP_HEADER);
+  write_long (header + 14, BMP_HEADER - 14);
+  write_long (header + 18, size.x);
+  write_long (header + 22, size.y);
+  write_short (header + 26, 1);
+  write_short (header + 28, 24);
+  write_long (header + 30, BMP_UNCOMPRESSED);
+  write_long (header + 34, pitch * size.y);
+  ok = fwrite (header, 1, BMP_HEADER, f) == BMP_HEADER;
+  row = new UCHAR[pitch];
+  memset (row, 0, pitch);
+  for (y = 0; y < size.y && ok; y++) {
+    for (x = 0; x < size.x; x++) {
+      row[x * 3 + 0] = rgb[(x + y * size.x) * 3 + 2];
+      row[x * 3 + 1] = rgb[(x + y * size.x) * 3 + 1];
+      row[x * 3 + 2] = rgb[(x + y * size.x) * 3 + 0];
+    }
+    ok = fwrite (row, 1, pitch, f) == (size_t)pitch;
+  }
+  delete[] row;
+  fclose (f);
+  return ok;
+
+}
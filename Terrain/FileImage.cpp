@@ -55,7 +55,7 @@ static char* do_default_image (GLcoord* size_in)
 
 }
 
-char* FileImageLoad (char* filename, GLcoord* size_in)
+char* FileImageLoad (const char* filename, GLcoord* size_in)
 {
 
   GLcoord size;
@@ -67,7 +67,7 @@ char* FileImageLoad (char* filename, GLcoord* size_in)
     ilOriginFunc(IL_ORIGIN_LOWER_LEFT);
   //else
     //ilOriginFunc(IL_ORIGIN_UPPER_LEFT);
-  ok = ilLoadImage (filename);
+  ok = ilLoadImage ((ILstring)filename);
   if (!ok)
     return do_default_image (size_in);
   size.x = ilGetInteger (IL_IMAGE_WIDTH);
@@ -80,3 +80,20 @@ char* FileImageLoad (char* filename, GLcoord* size_in)
 
 }
 
+//Save an RGB image. The format comes from the extension on the filename.
+bool FileImageSave (char* filename, unsigned char* rgb, GLcoord size)
+{
+
+  ILuint  id;
+  bool    ok;
+
+  ilGenImages (1, &id);
+  ilBindImage (id);
+  ilTexImage (size.x, size.y, 1, 3, IL_RGB, IL_UNSIGNED_BYTE, rgb);
+  ilEnable (IL_FILE_OVERWRITE);
+  ok = ilSaveImage (filename) != 0;
+  ilDeleteImages (1, &id);
+  return ok;
+
+}
+
@@ -57,12 +57,14 @@ static void precache ()
   PlayerUpdate ();
   do {
     SceneProgress (&ready, &total);
+    CacheUpdate (SDL_GetTicks () + 5);
     SceneUpdate (SDL_GetTicks () + 20);
     loading (((float)ready / (float)total) * 0.5f);
   } while (ready < total && !MainIsQuit ());
   SceneRestartProgress ();
   do {
     SceneProgress (&ready, &total);
+    CacheUpdate (SDL_GetTicks () + 5);
     SceneUpdate (SDL_GetTicks () + 20);
     loading (0.5f + ((float)ready / (float)total) * 0.5f);
   } while (ready < total && !MainIsQuit ());
@@ -101,6 +103,7 @@ void GameLoad (unsigned seed_in)
   CVarUtils::Load (filename, sub_group);
   AvatarPositionSet (PlayerPositionGet ());
   WorldLoad (seed);
+  WorldTextureBuild ();
   WorldSave ();
   seconds = 0;
   GameUpdate ();
@@ -126,6 +129,29 @@ void GameSave ()
 
 }
 
+/*-----------------------------------------------------------------------------
+  Generate the world for this seed without starting a game, and fill its page 
+  store for the given block of pages.  Everything lands in the seed's save 
+  directory, just where a real game would look for it.  Returns how many 
+  pages were built.
+-----------------------------------------------------------------------------*/
+
+int GameBake (unsigned seed_in, GLcoord origin, GLcoord size, unsigned long long* bytes)
+{
+
+  int       built;
+
+  seed = seed_in;
+  FileMakeDirectory (GameDirectory ());
+  WorldBake (seed);
+  built = CacheBake (origin, size, bytes);
+  //This closes the store, so the next seed gets its own.
+  CachePurge ();
+  seed = 0;
+  return built;
+
+}
+
 void GameInit ()
 {
   CVarUtils::AttachCVar ("game.days", &days, "");
@@ -169,8 +195,6 @@ void GameNew (unsigned seed_in)
   World*    w;
   int       start, end, step;
   int       region_x;
-  Region    region;
-  Region    region_neighbor;
   GLvector  av_pos;
   GLcoord   world_pos;
   float     elevation;
@@ -194,6 +218,7 @@ void GameNew (unsigned seed_in)
   SceneClear ();
   CachePurge ();
   WorldGenerate (seed);
+  WorldTextureBuild ();
   WorldSave ();
   //Now the world is ready.  Look for a good starting point.
   //Start in the center
@@ -208,10 +233,11 @@ void GameNew (unsigned seed_in)
     step = 1;
   }
   region_x = WORLD_GRID_CENTER;
+  //Beaches are the regions one step from the ocean.  Look for one that's 
+  //still a beach, with the ocean just past it.
   for (x = start; x != end; x += step) {
-    region = WorldRegionGet (x, WORLD_GRID_CENTER);
-    region_neighbor = WorldRegionGet (x + step, WORLD_GRID_CENTER);
-    if (region.climate == CLIMATE_COAST && region_neighbor.climate == CLIMATE_OCEAN) {
+    if (w->shore_distance[x][WORLD_GRID_CENTER] == 1 && w->shore_distance[x + step][WORLD_GRID_CENTER] == 0 &&
+      w->climate[x][WORLD_GRID_CENTER] == CLIMATE_COAST) {
       region_x = x;
       break;
     }
@@ -231,7 +257,7 @@ void GameNew (unsigned seed_in)
     TextPrint ("Scanning %d", world_pos.x);
     loading (0.02f);
     if (!CachePointAvailable (world_pos.x, world_pos.y)) {
-      CacheUpdatePage (world_pos.x, world_pos.y, SDL_GetTicks () + 20);
+      CacheUpdate (SDL_GetTicks () + 20);
       continue;
     }
     points_checked++;
@@ -1,3 +1,4 @@
+int   GameBake (unsigned seed_in, GLcoord origin, GLcoord size, unsigned long long* bytes);
 bool  GameCmd (vector<string> *args);
 char* GameDirectory ();
 void  GameInit ();
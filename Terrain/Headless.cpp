@@ -0,0 +1,121 @@
+/*-----------------------------------------------------------------------------
+
+  Headless.cpp
+
+-------------------------------------------------------------------------------
+
+  What the mesh builders get in the core library, in place of the renderer
+  and the scene.  A VBO keeps the size of the mesh sent to it, instead of
+  loading it into GL.  Terrain textures are never painted, nothing is drawn,
+  and a terrain has no neighbors to stitch to.  The game gets all of these
+  from VBO.cpp, Scene.cpp, and the render files of each class.
+
+-----------------------------------------------------------------------------*/
+
+#include "Core.h"
+#include "VBO.h"
+#include "CBrush.h"
+#include "CGrass.h"
+#include "CTerrain.h"
+#include "Scene.h"
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+VBO::VBO ()
+{
+
+  _id_vertex = _id_index = _size_vertex = _size_uv = _size_normal = _size_buffer = _index_count = 0;
+  _ready = false;
+  _use_color = false;
+  _size_color = 0;
+  _polygon = 0;
+
+}
+
+VBO::~VBO ()
+{
+
+}
+
+void VBO::Clear ()
+{
+
+  _use_color = false;
+  _size_color = 0;
+  _polygon = 0;
+  _ready = false;
+
+}
+
+void VBO::Create (int polygon, int index_count, int vert_count, unsigned* index_list, GLvector* vert_list, GLvector* normal_list, GLrgba* color_list, GLvector2* uv_list)
+{
+
+  if (!index_count || !vert_count)
+    return;
+  _polygon = polygon;
+  _use_color = color_list != NULL;
+  _size_vertex = sizeof (GLvector) * vert_count;
+  _size_normal = sizeof (GLvector) * vert_count;
+  _size_uv = sizeof (GLvector2) * vert_count;
+  _size_color = _use_color ? sizeof (GLrgba) * vert_count : 0;
+  _size_buffer = _size_vertex + _size_normal + _size_uv + _size_color;
+  _index_count = index_count;
+  _ready = true;
+
+}
+
+void VBO::Create (GLmesh* m)
+{
+
+  Create (GL_TRIANGLES, m->_index.size (), m->Vertices (), NULL, NULL, NULL, m->_color.size () ? &m->_color[0] : NULL, NULL);
+
+}
+
+void VBO::Render ()
+{
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+//With nothing to paint, go straight to the final stage, which records the
+//texture as done.
+void CTerrain::DoTexture ()
+{
+
+  _stage++;
+
+}
+
+void CTerrain::TextureDelete (unsigned* texture)
+{
+
+  *texture = 0;
+
+}
+
+void CTerrain::Render ()
+{
+
+}
+
+void CGrass::Render ()
+{
+
+}
+
+void CBrush::Render ()
+{
+
+}
+
+CTerrain* SceneTerrainGet (int x, int y)
+{
+
+  return NULL;
+
+}
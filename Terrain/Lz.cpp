@@ -0,0 +1,187 @@
+/*-----------------------------------------------------------------------------
+
+  Lz.cpp
+
+-------------------------------------------------------------------------------
+
+  A small, fast LZ77 codec, used for the page cache.  It favors decode speed
+  over ratio, so there's no entropy coding, just literal runs and back 
+  references.
+
+  The stream is a series of sequences.  Each one begins with a token byte: 
+  the high nibble is the number of literals, the low nibble is the match
+  length minus LZ_MIN_MATCH.  A nibble of 15 means more length bytes follow,
+  each adding up to 255.  After the literals comes a 2-byte offset and then
+  any extra match length.  The last sequence has literals only.
+
+-----------------------------------------------------------------------------*/
+
+#include "Core.h"
+#include "Lz.h"
+
+#define LZ_MIN_MATCH      4
+#define LZ_MAX_OFFSET     65535
+#define LZ_HASH_BITS      12
+#define LZ_HASH_SIZE      (1 << LZ_HASH_BITS)
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+static unsigned read32 (const UCHAR* p)
+{
+
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+
+}
+
+static unsigned hash (unsigned n)
+{
+
+  return (n * 2654435761u) >> (32 - LZ_HASH_BITS);
+
+}
+
+static UCHAR* write_length (UCHAR* out, int len)
+{
+
+  while (len >= 255) {
+    *out++ = 255;
+    len -= 255;
+  }
+  *out++ = (UCHAR)len;
+  return out;
+
+}
+
+static UCHAR* write_sequence (UCHAR* out, const UCHAR* literals, int literal_count, int offset, int match)
+{
+
+  UCHAR*  token;
+
+  token = out++;
+  *token = (UCHAR)(min (literal_count, 15) << 4);
+  if (literal_count >= 15)
+    out = write_length (out, literal_count - 15);
+  memcpy (out, literals, literal_count);
+  out += literal_count;
+  if (!match)
+    return out;
+  match -= LZ_MIN_MATCH;
+  *token |= (UCHAR)min (match, 15);
+  *out++ = (UCHAR)(offset & 0xff);
+  *out++ = (UCHAR)(offset >> 8);
+  if (match >= 15)
+    out = write_length (out, match - 15);
+  return out;
+
+}
+
+static bool read_length (const UCHAR** in, const UCHAR* end, int* len)
+{
+
+  UCHAR   b;
+
+  do {
+    if (*in >= end)
+      return false;
+    b = *(*in)++;
+    *len += b;
+  } while (b == 255);
+  return true;
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+//Worst case output size for an input of the given size.
+int LzBound (int size)
+{
+
+  return size + size / 255 + 16;
+
+}
+
+//Returns the number of bytes written to out, which must hold LzBound (size).
+int LzCompress (const UCHAR* in, int size, UCHAR* out)
+{
+
+  int     table[LZ_HASH_SIZE];
+  int     ip, anchor, ref, len;
+  unsigned  h;
+  UCHAR*  op;
+
+  memset (table, 0, sizeof (table));
+  op = out;
+  ip = anchor = 0;
+  while (ip + LZ_MIN_MATCH <= size) {
+    h = hash (read32 (in + ip));
+    //Table entries are stored +1, so zero means empty.
+    ref = table[h] - 1;
+    table[h] = ip + 1;
+    if (ref < 0 || ip - ref > LZ_MAX_OFFSET || read32 (in + ref) != read32 (in + ip)) {
+      ip++;
+      continue;
+    }
+    len = LZ_MIN_MATCH;
+    while (ip + len < size && in[ref + len] == in[ip + len])
+      len++;
+    op = write_sequence (op, in + anchor, ip - anchor, ip - ref, len);
+    ip += len;
+    anchor = ip;
+  }
+  op = write_sequence (op, in + anchor, size - anchor, 0, 0);
+  return (int)(op - out);
+
+}
+
+//Returns the number of bytes decoded, or -1 if the stream is damaged.
+int LzDecompress (const UCHAR* in, int in_size, UCHAR* out, int out_size)
+{
+
+  const UCHAR*  ip;
+  const UCHAR*  end;
+  UCHAR*        op;
+  UCHAR*        op_end;
+  UCHAR*        ref;
+  int           token;
+  int           len;
+  int           offset;
+
+  ip = in;
+  end = in + in_size;
+  op = out;
+  op_end = out + out_size;
+  while (ip < end) {
+    token = *ip++;
+    len = token >> 4;
+    if (len == 15 && !read_length (&ip, end, &len))
+      return -1;
+    if (len > end - ip || len > op_end - op)
+      return -1;
+    memcpy (op, ip, len);
+    ip += len;
+    op += len;
+    //The final sequence has no match.
+    if (ip >= end)
+      break;
+    if (end - ip < 2)
+      return -1;
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    len = token & 15;
+    if (len == 15 && !read_length (&ip, end, &len))
+      return -1;
+    len += LZ_MIN_MATCH;
+    if (offset == 0 || offset > op - out || len > op_end - op)
+      return -1;
+    //Matches may overlap the output, so this has to go a byte at a time.
+    ref = op - offset;
+    while (len--)
+      *op++ = *ref++;
+  }
+  return (int)(op - out);
+
+}
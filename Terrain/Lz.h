@@ -0,0 +1,3 @@
+int   LzBound (int size);
+int   LzCompress (const UCHAR* in, int size, UCHAR* out);
+int   LzDecompress (const UCHAR* in, int in_size, UCHAR* out, int out_size);
@@ -32,6 +32,7 @@ http://www.bramstein.com/projects/gui/
 #include "console.h"
 #include "cg.h"
 #include "env.h"
+#include "file.h"
 #include "game.h"
 #include "sdl.h"
 #include "il\il.h"
@@ -59,6 +60,10 @@ http://www.bramstein.com/projects/gui/
 #endif
 
 #define SETTINGS_FILE   "user.set"
+#define PREVIEW_DIR     "preview//"
+#define BAKE_LOG        "bake.txt"
+//How many pages on a side to bake if we aren't told.
+#define BAKE_SIZE       16
 
 static bool           quit;
 
@@ -82,6 +87,7 @@ static void init ()
   AvatarInit ();
   TextureInit ();
   WorldInit ();
+  CacheInit ();
   SceneInit ();
   SkyInit ();
   TextInit ();
@@ -97,6 +103,7 @@ static void term ()
 {
 
   GameTerm ();
+  CacheTerm ();
   TextureTerm ();
   SdlTerm ();
 
@@ -122,6 +129,7 @@ static void run ()
     EnvUpdate ();
     SkyUpdate ();
     SceneUpdate (stop);
+    CacheConfigure (CVarUtils::GetCVar<int> ("cache.budget"), CVarUtils::GetCVar<bool> ("cache.active"));
     CacheUpdate (stop);
     ParticleUpdate ();
     RenderUpdate ();
@@ -152,6 +160,104 @@ bool MainIsQuit ()
 
 }
 
+/*-----------------------------------------------------------------------------
+  Flip through a range of seeds without starting the game. Run as:
+
+    frontier -preview <first seed> <count>
+
+  Each seed gets a small map in the preview folder, and a line in 
+  summary.txt describing it.
+-----------------------------------------------------------------------------*/
+
+static void preview (char* args)
+{
+
+  unsigned      first, count, i;
+  char          filename[256];
+  FILE*         f;
+  WorldSummary  summary;
+  long          start, elapsed;
+
+  first = 1;
+  count = 100;
+  sscanf (args, "%u %u", &first, &count);
+  ilInit ();
+  WorldInit ();
+  FileMakeDirectory (PREVIEW_DIR);
+  if (!(f = fopen (PREVIEW_DIR "summary.txt", "w")))
+    return;
+  fprintf (f, "seed\tland\tbeach\ttemp\tmoist\twind\themisphere\trivers planned\tlakes planned\n");
+  start = GetTickCount ();
+  for (i = 0; i < count; i++) {
+    sprintf (filename, "%sseed%u.png", PREVIEW_DIR, first + i);
+    WorldPreview (first + i, filename, &summary);
+    fprintf (f, "%u\t%.3f\t%.3f\t%.2f\t%.2f\t%s\t%s\t%u\t%u\n", summary.seed, 
+      summary.land, summary.beach, summary.temperature, summary.moisture,
+      summary.wind_from_west ? "west" : "east", 
+      summary.northern_hemisphere ? "north" : "south", 
+      summary.rivers_planned, summary.lakes_planned);
+  }
+  elapsed = GetTickCount () - start;
+  fprintf (f, "%u seeds in %ldms\n", count, elapsed);
+  fclose (f);
+
+}
+
+/*-----------------------------------------------------------------------------
+  Generate worlds and fill their page stores ahead of time, without starting
+  the game. Run as:
+
+    frontier -bake <first seed> <count> [<x> <y> <width> <height>]
+
+  The block is in pages, which are one region each. By default it's a square
+  in the middle of the world, where new games begin. How long each seed took
+  and what it wrote goes in bake.txt.
+-----------------------------------------------------------------------------*/
+
+static void bake (char* args)
+{
+
+  unsigned      first, count, i;
+  GLcoord       origin, size;
+  FILE*         f;
+  int           built;
+  unsigned long long  bytes, total_bytes;
+  int           total_built;
+  long          start, seed_start, elapsed;
+
+  first = 1;
+  count = 1;
+  size.x = size.y = BAKE_SIZE;
+  origin.x = origin.y = (WORLD_GRID - BAKE_SIZE) / 2;
+  sscanf (args, "%u %u %d %d %d %d", &first, &count, &origin.x, &origin.y, &size.x, &size.y);
+  if (!(f = fopen (BAKE_LOG, "w")))
+    return;
+  ilInit ();
+  WorldInit ();
+  CacheInit ();
+  fprintf (f, "seed\tpages\tbytes\tms\tpages/sec\n");
+  total_built = 0;
+  total_bytes = 0;
+  start = GetTickCount ();
+  for (i = 0; i < count; i++) {
+    seed_start = GetTickCount ();
+    built = GameBake (first + i, origin, size, &bytes);
+    elapsed = GetTickCount () - seed_start;
+    fprintf (f, "%u\t%d\t%llu\t%ld\t%.1f\n", first + i, built, bytes, elapsed, 
+      elapsed ? (float)built * 1000.0f / (float)elapsed : 0.0f);
+    fflush (f);
+    total_built += built;
+    total_bytes += bytes;
+  }
+  elapsed = GetTickCount () - start;
+  fprintf (f, "%u seeds, %d pages, %s written in %ldms: %.1f pages/sec\n", count, 
+    total_built, TextBytes (total_bytes), elapsed, 
+    elapsed ? (float)total_built * 1000.0f / (float)elapsed : 0.0f);
+  fclose (f);
+  CacheTerm ();
+
+}
+
 bool ConsoleCgCompile (vector<string> *args) 
 {
 
@@ -167,6 +273,14 @@ bool ConsoleCgCompile (vector<string> *args)
 int PASCAL WinMain (HINSTANCE instance_in, HINSTANCE previous_instance, LPSTR command_line, int show_style)
 {
 
+  if (!strncmp (command_line, "-preview", 8)) {
+    preview (command_line + 8);
+    return 0;
+  }
+  if (!strncmp (command_line, "-bake", 5)) {
+    bake (command_line + 5);
+    return 0;
+  }
   //Variables
   CVarUtils::CreateCVar ("avatar.expand", false, "Resize avatar proportions to be more cartoon-y.");
   CVarUtils::CreateCVar ("render.shaders", true, "Enable vertex, fragment shaders.");
@@ -178,6 +292,7 @@ int PASCAL WinMain (HINSTANCE instance_in, HINSTANCE previous_instance, LPSTR co
   CVarUtils::CreateCVar ("show.vitals", false, "Show the player statistics.");
   CVarUtils::CreateCVar ("show.region", false, "Show information about the currently occupied region.");
   CVarUtils::CreateCVar ("cache.active", false, "Controls saving of paged data.");
+  CVarUtils::CreateCVar ("cache.budget", 128, "Megabytes of memory to spend on terrain pages.");
   CVarUtils::CreateCVar ("flying", false, "Allows flight.");
   CVarUtils::CreateCVar ("mouse.invert", false, "Reverse mouse y axis.");
   CVarUtils::CreateCVar ("mouse.sensitivity", 1.0f, "Mouse tracking");
@@ -186,6 +301,9 @@ int PASCAL WinMain (HINSTANCE instance_in, HINSTANCE previous_instance, LPSTR co
   CVarUtils::CreateCVar ("compile", ConsoleCgCompile, "");
   CVarUtils::CreateCVar ("cache.dump", CacheDump, "Clear all saved data from memory & disk.");
   CVarUtils::CreateCVar ("cache.size", CacheSize, "Returns the current size of the cache.");
+  CVarUtils::CreateCVar ("cache.normals", CacheNormalBenchmark, "Time the page normal kernel against the old cell-by-cell path.");
+  CVarUtils::CreateCVar ("cache.stats", CacheStats, "Memory use, hits, misses and evictions of the page cache.");
+  CVarUtils::CreateCVar ("scene.stats", SceneStats, "How many frames were drawn with nearby terrain still unfinished.");
   CVarUtils::CreateCVar ("game", GameCmd, "Usage: Game [ new | quit ]");
   CVarUtils::CreateCVar ("particle", ParticleCmd, "Usage: particle <filename>");
   CVarUtils::Load (SETTINGS_FILE);
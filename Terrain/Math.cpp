@@ -10,10 +10,10 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 #include <math.h>
 
-#include "math.h"
+#include "Math.h"
 
 /*-----------------------------------------------------------------------------
 Keep an angle between 0 and 360
@@ -0,0 +1,52 @@
+/*-----------------------------------------------------------------------------
+
+  Platform.h
+
+-------------------------------------------------------------------------------
+
+  What the engine core needs from the operating system: the time, threads,
+  and files.  The game gets these from PlatformWin.cpp, built on SDL and
+  Windows.  The core library gets them from PlatformPosix.cpp, which needs
+  nothing but the C library and pthreads, and no display.
+
+-----------------------------------------------------------------------------*/
+
+struct PlatformCond;
+struct PlatformFile;
+struct PlatformMutex;
+struct PlatformThread;
+
+//Time
+int             PlatformCores ();
+double          PlatformSeconds ();
+long            PlatformTick ();
+
+//Threads
+PlatformCond*   PlatformCondCreate ();
+void            PlatformCondBroadcast (PlatformCond* c);
+void            PlatformCondDestroy (PlatformCond* c);
+void            PlatformCondSignal (PlatformCond* c);
+void            PlatformCondWait (PlatformCond* c, PlatformMutex* m);
+PlatformMutex*  PlatformMutexCreate ();
+void            PlatformMutexDestroy (PlatformMutex* m);
+void            PlatformMutexLock (PlatformMutex* m);
+void            PlatformMutexUnlock (PlatformMutex* m);
+PlatformThread* PlatformThreadCreate (int (*run)(void*), void* data);
+void            PlatformThreadWait (PlatformThread* t);
+
+//Files by name
+long            PlatformFileModified (const char* name);
+void            PlatformFileTouch (const char* name);
+bool            PlatformFolderMake (const char* folder);
+
+//Files opened for random access.  The whole file can be mapped for reading.
+//The view shows the file as it was when it was mapped, so unmap it before 
+//writing, and map it again afterwards to see the new data.
+PlatformFile*   PlatformFileOpen (const char* name);
+void            PlatformFileClose (PlatformFile* f);
+const UCHAR*    PlatformFileMap (PlatformFile* f);
+bool            PlatformFileRead (PlatformFile* f, unsigned offset, void* data, unsigned size);
+unsigned        PlatformFileSize (PlatformFile* f);
+void            PlatformFileTruncate (PlatformFile* f, unsigned size);
+void            PlatformFileUnmap (PlatformFile* f);
+bool            PlatformFileWrite (PlatformFile* f, unsigned offset, const void* data, unsigned size);
@@ -0,0 +1,338 @@
+/*-----------------------------------------------------------------------------
+
+  PlatformPosix.cpp
+
+-------------------------------------------------------------------------------
+
+  The platform layer for the core library on Linux and other POSIX systems.
+  There's no window and no GL context here, so this is what servers and
+  batch tools run on.  Since there's no console to write to either, console
+  messages go to stdout.
+
+-----------------------------------------------------------------------------*/
+
+#include "Core.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+#include "Console.h"
+#include "Platform.h"
+
+struct PlatformCond
+{
+  pthread_cond_t    cond;
+};
+
+struct PlatformMutex
+{
+  pthread_mutex_t   mutex;
+};
+
+struct PlatformThread
+{
+  pthread_t         thread;
+  int               (*run)(void*);
+  void*             data;
+};
+
+struct PlatformFile
+{
+  int               fd;
+  UCHAR*            view;
+  unsigned          view_size;
+};
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+static void* thread_start (void* data)
+{
+
+  PlatformThread*   t;
+
+  t = (PlatformThread*)data;
+  t->run (t->data);
+  return NULL;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Time
+-----------------------------------------------------------------------------*/
+
+int PlatformCores ()
+{
+
+  long      cores;
+
+  cores = sysconf (_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? (int)cores : 1;
+
+}
+
+double PlatformSeconds ()
+{
+
+  struct timespec   now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+
+}
+
+long PlatformTick ()
+{
+
+  static double     start;
+
+  if (start == 0.0)
+    start = PlatformSeconds ();
+  return (long)((PlatformSeconds () - start) * 1000.0);
+
+}
+
+/*-----------------------------------------------------------------------------
+  Threads
+-----------------------------------------------------------------------------*/
+
+PlatformCond* PlatformCondCreate ()
+{
+
+  PlatformCond*   c;
+
+  c = new PlatformCond;
+  pthread_cond_init (&c->cond, NULL);
+  return c;
+
+}
+
+void PlatformCondBroadcast (PlatformCond* c)
+{
+
+  pthread_cond_broadcast (&c->cond);
+
+}
+
+void PlatformCondDestroy (PlatformCond* c)
+{
+
+  pthread_cond_destroy (&c->cond);
+  delete c;
+
+}
+
+void PlatformCondSignal (PlatformCond* c)
+{
+
+  pthread_cond_signal (&c->cond);
+
+}
+
+void PlatformCondWait (PlatformCond* c, PlatformMutex* m)
+{
+
+  pthread_cond_wait (&c->cond, &m->mutex);
+
+}
+
+PlatformMutex* PlatformMutexCreate ()
+{
+
+  PlatformMutex*  m;
+
+  m = new PlatformMutex;
+  pthread_mutex_init (&m->mutex, NULL);
+  return m;
+
+}
+
+void PlatformMutexDestroy (PlatformMutex* m)
+{
+
+  pthread_mutex_destroy (&m->mutex);
+  delete m;
+
+}
+
+void PlatformMutexLock (PlatformMutex* m)
+{
+
+  pthread_mutex_lock (&m->mutex);
+
+}
+
+void PlatformMutexUnlock (PlatformMutex* m)
+{
+
+  pthread_mutex_unlock (&m->mutex);
+
+}
+
+PlatformThread* PlatformThreadCreate (int (*run)(void*), void* data)
+{
+
+  PlatformThread*   t;
+
+  t = new PlatformThread;
+  t->run = run;
+  t->data = data;
+  if (pthread_create (&t->thread, NULL, thread_start, t)) {
+    delete t;
+    return NULL;
+  }
+  return t;
+
+}
+
+void PlatformThreadWait (PlatformThread* t)
+{
+
+  if (!t)
+    return;
+  pthread_join (t->thread, NULL);
+  delete t;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Files by name
+-----------------------------------------------------------------------------*/
+
+long PlatformFileModified (const char* name)
+{
+
+  struct stat   info;
+
+  if (stat (name, &info))
+    return 0;
+  return (long)info.st_mtime;
+
+}
+
+void PlatformFileTouch (const char* name)
+{
+
+  utime (name, NULL);
+
+}
+
+bool PlatformFolderMake (const char* folder)
+{
+
+  return mkdir (folder, 0755) == 0;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Files opened for random access
+-----------------------------------------------------------------------------*/
+
+PlatformFile* PlatformFileOpen (const char* name)
+{
+
+  PlatformFile*   f;
+  int             fd;
+
+  fd = open (name, O_RDWR | O_CREAT, 0644);
+  if (fd == -1)
+    return NULL;
+  f = new PlatformFile;
+  f->fd = fd;
+  f->view = NULL;
+  f->view_size = 0;
+  return f;
+
+}
+
+void PlatformFileClose (PlatformFile* f)
+{
+
+  PlatformFileUnmap (f);
+  close (f->fd);
+  delete f;
+
+}
+
+const UCHAR* PlatformFileMap (PlatformFile* f)
+{
+
+  void*     view;
+
+  PlatformFileUnmap (f);
+  f->view_size = PlatformFileSize (f);
+  if (!f->view_size)
+    return NULL;
+  view = mmap (NULL, f->view_size, PROT_READ, MAP_SHARED, f->fd, 0);
+  if (view == MAP_FAILED) {
+    f->view_size = 0;
+    return NULL;
+  }
+  f->view = (UCHAR*)view;
+  return f->view;
+
+}
+
+bool PlatformFileRead (PlatformFile* f, unsigned offset, void* data, unsigned size)
+{
+
+  return pread (f->fd, data, size, offset) == (ssize_t)size;
+
+}
+
+unsigned PlatformFileSize (PlatformFile* f)
+{
+
+  struct stat   info;
+
+  if (fstat (f->fd, &info))
+    return 0;
+  return (unsigned)info.st_size;
+
+}
+
+void PlatformFileTruncate (PlatformFile* f, unsigned size)
+{
+
+  if (ftruncate (f->fd, size))
+    ConsoleLog ("PlatformFileTruncate: Unable to resize file.");
+
+}
+
+void PlatformFileUnmap (PlatformFile* f)
+{
+
+  if (f->view)
+    munmap (f->view, f->view_size);
+  f->view = NULL;
+  f->view_size = 0;
+
+}
+
+bool PlatformFileWrite (PlatformFile* f, unsigned offset, const void* data, unsigned size)
+{
+
+  return pwrite (f->fd, data, size, offset) == (ssize_t)size;
+
+}
+
+/*-----------------------------------------------------------------------------
+  The console
+-----------------------------------------------------------------------------*/
+
+void ConsoleLog (const char* message, ...)
+{
+
+  va_list     marker;
+
+  va_start (marker, message);
+  vprintf (message, marker);
+  va_end (marker);
+  printf ("\n");
+
+}
@@ -0,0 +1,296 @@
+/*-----------------------------------------------------------------------------
+
+  PlatformWin.cpp
+
+-------------------------------------------------------------------------------
+
+  The platform layer for the game on Windows.  Threads come from SDL, since
+  the game already has it, and everything else comes from Windows itself.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include <direct.h>
+#include <io.h>
+#include <sys/utime.h>
+#include "Platform.h"
+
+struct PlatformCond
+{
+  SDL_cond*         cond;
+};
+
+struct PlatformMutex
+{
+  SDL_mutex*        mutex;
+};
+
+struct PlatformThread
+{
+  SDL_Thread*       thread;
+};
+
+struct PlatformFile
+{
+  HANDLE            file;
+  HANDLE            mapping;
+  UCHAR*            view;
+};
+
+/*-----------------------------------------------------------------------------
+  Time
+-----------------------------------------------------------------------------*/
+
+int PlatformCores ()
+{
+
+  SYSTEM_INFO   info;
+
+  GetSystemInfo (&info);
+  return max ((int)info.dwNumberOfProcessors, 1);
+
+}
+
+double PlatformSeconds ()
+{
+
+  LARGE_INTEGER   freq, now;
+
+  QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&now);
+  return (double)now.QuadPart / (double)freq.QuadPart;
+
+}
+
+long PlatformTick ()
+{
+
+  return SDL_GetTicks ();
+
+}
+
+/*-----------------------------------------------------------------------------
+  Threads
+-----------------------------------------------------------------------------*/
+
+PlatformCond* PlatformCondCreate ()
+{
+
+  PlatformCond*   c;
+
+  c = new PlatformCond;
+  c->cond = SDL_CreateCond ();
+  return c;
+
+}
+
+void PlatformCondBroadcast (PlatformCond* c)
+{
+
+  SDL_CondBroadcast (c->cond);
+
+}
+
+void PlatformCondDestroy (PlatformCond* c)
+{
+
+  SDL_DestroyCond (c->cond);
+  delete c;
+
+}
+
+void PlatformCondSignal (PlatformCond* c)
+{
+
+  SDL_CondSignal (c->cond);
+
+}
+
+void PlatformCondWait (PlatformCond* c, PlatformMutex* m)
+{
+
+  SDL_CondWait (c->cond, m->mutex);
+
+}
+
+PlatformMutex* PlatformMutexCreate ()
+{
+
+  PlatformMutex*  m;
+
+  m = new PlatformMutex;
+  m->mutex = SDL_CreateMutex ();
+  return m;
+
+}
+
+void PlatformMutexDestroy (PlatformMutex* m)
+{
+
+  SDL_DestroyMutex (m->mutex);
+  delete m;
+
+}
+
+void PlatformMutexLock (PlatformMutex* m)
+{
+
+  SDL_LockMutex (m->mutex);
+
+}
+
+void PlatformMutexUnlock (PlatformMutex* m)
+{
+
+  SDL_UnlockMutex (m->mutex);
+
+}
+
+PlatformThread* PlatformThreadCreate (int (*run)(void*), void* data)
+{
+
+  PlatformThread*   t;
+
+  t = new PlatformThread;
+  t->thread = SDL_CreateThread (run, data);
+  if (!t->thread) {
+    delete t;
+    return NULL;
+  }
+  return t;
+
+}
+
+void PlatformThreadWait (PlatformThread* t)
+{
+
+  if (!t)
+    return;
+  SDL_WaitThread (t->thread, NULL);
+  delete t;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Files by name
+-----------------------------------------------------------------------------*/
+
+long PlatformFileModified (const char* name)
+{
+
+  long                search;
+  struct _finddata_t  info;
+  long                timestamp;
+
+  timestamp = 0;
+  if ((search = _findfirst (name, &info)) != -1) {
+    timestamp = (long)info.time_write;
+    _findclose (search);
+  }
+  return timestamp;
+
+}
+
+void PlatformFileTouch (const char* name)
+{
+
+  _utime (name, NULL);
+
+}
+
+bool PlatformFolderMake (const char* folder)
+{
+
+  return _mkdir (folder) == 0;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Files opened for random access
+-----------------------------------------------------------------------------*/
+
+PlatformFile* PlatformFileOpen (const char* name)
+{
+
+  PlatformFile*   f;
+  HANDLE          file;
+
+  file = CreateFile (name, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return NULL;
+  f = new PlatformFile;
+  f->file = file;
+  f->mapping = NULL;
+  f->view = NULL;
+  return f;
+
+}
+
+void PlatformFileClose (PlatformFile* f)
+{
+
+  PlatformFileUnmap (f);
+  CloseHandle (f->file);
+  delete f;
+
+}
+
+const UCHAR* PlatformFileMap (PlatformFile* f)
+{
+
+  PlatformFileUnmap (f);
+  f->mapping = CreateFileMapping (f->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (f->mapping)
+    f->view = (UCHAR*)MapViewOfFile (f->mapping, FILE_MAP_READ, 0, 0, 0);
+  return f->view;
+
+}
+
+bool PlatformFileRead (PlatformFile* f, unsigned offset, void* data, unsigned size)
+{
+
+  DWORD   got;
+
+  if (SetFilePointer (f->file, offset, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
+    return false;
+  return ReadFile (f->file, data, size, &got, NULL) && got == size;
+
+}
+
+unsigned PlatformFileSize (PlatformFile* f)
+{
+
+  return GetFileSize (f->file, NULL);
+
+}
+
+void PlatformFileTruncate (PlatformFile* f, unsigned size)
+{
+
+  SetFilePointer (f->file, size, NULL, FILE_BEGIN);
+  SetEndOfFile (f->file);
+
+}
+
+void PlatformFileUnmap (PlatformFile* f)
+{
+
+  if (f->view)
+    UnmapViewOfFile (f->view);
+  if (f->mapping)
+    CloseHandle (f->mapping);
+  f->view = NULL;
+  f->mapping = NULL;
+
+}
+
+bool PlatformFileWrite (PlatformFile* f, unsigned offset, const void* data, unsigned size)
+{
+
+  DWORD   written;
+
+  if (SetFilePointer (f->file, offset, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER)
+    return false;
+  return WriteFile (f->file, data, size, &written, NULL) && written == size;
+
+}
@@ -8,11 +8,16 @@
   generators. The incredible period is 2^19937 - 1, a number with about 6000
   digits; the 32-bit random numbers exhibit best possible equidistribution
   properties in dimensions up to 623; and it's fast, very fast. 
+
+  The keyed functions at the bottom are Philox4x32-10, by Salmon, Moraes, Dror
+  and Shaw. It's a counter-based generator: a block of four numbers is a pure 
+  function of a 128-bit counter and a 64-bit key, so there's no state to
+  share between threads or to keep in order.
 -----------------------------------------------------------------------------*/
 
-#include "StdAfx.h"
+#include "Core.h"
 #include <memory.h>
-#include "random.h"
+#include "Random.h"
 
 
 #define LOWER_MASK            0x7fffffff 
@@ -27,6 +32,12 @@
 #define TEMPERING_SHIFT_U(y)  (y >> 11)
 #define UPPER_MASK            0x80000000 
 
+#define PHILOX_M0             0xD2511F53
+#define PHILOX_M1             0xCD9E8D57
+#define PHILOX_W0             0x9E3779B9
+#define PHILOX_W1             0xBB67AE85
+#define PHILOX_ROUNDS         10
+
 static int              k = 1;
 static unsigned long    mag01[2] = {0x0, MATRIX_A};
 static unsigned long    ptgfsr[N];
@@ -103,3 +114,82 @@ void RandomInit (unsigned long seed)
 
 }
 
+/*-----------------------------------------------------------------------------
+The counter is (x, y, block, 0) and the key is (seed, stream), so every 
+coordinate of every stream gets its own sequence.
+-----------------------------------------------------------------------------*/
+
+static void philox (unsigned* counter, unsigned k0, unsigned k1)
+{
+
+  unsigned long long  p0, p1;
+  unsigned            c[4];
+  int                 i;
+
+  for (i = 0; i < 4; i++)
+    c[i] = counter[i];
+  for (i = 0; i < PHILOX_ROUNDS; i++) {
+    p0 = (unsigned long long)PHILOX_M0 * c[0];
+    p1 = (unsigned long long)PHILOX_M1 * c[2];
+    counter[0] = (unsigned)(p1 >> 32) ^ c[1] ^ k0;
+    counter[1] = (unsigned)p1;
+    counter[2] = (unsigned)(p0 >> 32) ^ c[3] ^ k1;
+    counter[3] = (unsigned)p0;
+    memcpy (c, counter, sizeof (c));
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void RandomFill (unsigned long seed, RandomStream stream, int x, int y, unsigned long* out, int count)
+{
+
+  unsigned    block[4];
+  int         i, n;
+
+  for (n = 0; n < count; n += 4) {
+    block[0] = (unsigned)x;
+    block[1] = (unsigned)y;
+    block[2] = (unsigned)(n / 4);
+    block[3] = 0;
+    philox (block, (unsigned)seed, (unsigned)stream);
+    for (i = 0; i < 4 && n + i < count; i++)
+      out[n + i] = block[i];
+  }
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+unsigned long RandomAt (unsigned long seed, RandomStream stream, int x, int y, unsigned index)
+{
+
+  unsigned    block[4];
+
+  block[0] = (unsigned)x;
+  block[1] = (unsigned)y;
+  block[2] = index / 4;
+  block[3] = 0;
+  philox (block, (unsigned)seed, (unsigned)stream);
+  return block[index % 4];
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+float RandomFloatAt (unsigned long seed, RandomStream stream, int x, int y, unsigned index)
+{
+
+  return (float)(RandomAt (seed, stream, x, y, index) % 10000) / 10000;
+
+}
+
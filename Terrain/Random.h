@@ -4,3 +4,21 @@ unsigned long RandomVal (int range);
 unsigned long RandomVal (void);
 void          RandomInit (unsigned long seed);
 float         RandomFloat ();
+
+//Counter-based random numbers.  Instead of drawing from one shared sequence,
+//each value is computed from a seed, a stream, a coordinate, and an index.
+//The same arguments always give the same number, no matter what order 
+//things are done in or which thread asks.
+enum RandomStream
+{
+  RANDOM_NOISE,
+  RANDOM_PREPARE,
+  RANDOM_FLOWERS,
+  RANDOM_FILL,
+  RANDOM_COLORS,
+  RANDOM_STAGE
+};
+
+unsigned long RandomAt (unsigned long seed, RandomStream stream, int x, int y, unsigned index);
+float         RandomFloatAt (unsigned long seed, RandomStream stream, int x, int y, unsigned index);
+void          RandomFill (unsigned long seed, RandomStream stream, int x, int y, unsigned long* out, int count);
@@ -17,6 +17,7 @@
 #include "cbrush.h"
 #include "cforest.h"
 #include "cg.h"
+#include "console.h"
 #include "cgrass.h"
 #include "cparticlearea.h"
 #include "cterrain.h"
@@ -49,6 +50,8 @@ static int              texture_bytes;
 static int              texture_bytes_counter;
 static int              polygons;
 static int              polygons_counter;
+static unsigned         frames;
+static unsigned         stall_frames;
 
 /*                  *************************************************************/
 
@@ -87,6 +90,7 @@ void SceneGenerate ()
 
   SceneClear ();
   WaterBuild ();
+  frames = stall_frames = 0;
   camera = AvatarPosition ();
   current.x = (int)(camera.x) / GRASS_SIZE;
 
@@ -203,7 +207,16 @@ void SceneUpdate (long stop)
   gm_grass.Update (stop);
   gm_forest.Update (stop);
   gm_brush.Update (stop);
-  TextPrint ("Scene: %d of %d terrains ready", gm_terrain.ItemsReady (), gm_terrain.ItemsViewable ());
+  TextPrint ("Scene: %d of %d terrains ready, %u stalls", gm_terrain.ItemsReady (), gm_terrain.ItemsViewable (), stall_frames);
+
+}
+
+bool SceneStats (vector<string> *args)
+{
+
+  ConsoleLog ("%u of %u frames stalled waiting on terrain (%1.2f%%).", 
+    stall_frames, frames, frames ? (float)stall_frames * 100.0f / (float)frames : 0.0f);
+  return true;
 
 }
 
@@ -212,6 +225,10 @@ void SceneRender ()
 
   if (!GameRunning ())
     return;
+  //A stall is any frame drawn while terrain in front of the camera isn't there yet.
+  frames++;
+  if (gm_terrain.Stalled ())
+    stall_frames++;
   if (!CVarUtils::GetCVar<bool> ("render.textured"))
     glDisable(GL_TEXTURE_2D);
   else
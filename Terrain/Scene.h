@@ -16,6 +16,7 @@ void            SceneProgress (unsigned* ready, unsigned* total);
 void            SceneRender ();
 void            SceneRenderDebug ();
 void            SceneRestartProgress ();
+bool            SceneStats (vector<string> *args);
 class CTerrain* SceneTerrainGet (int x, int y);
 void            SceneTexturePurge ();
 float           SceneVisibleRange ();
@@ -0,0 +1,340 @@
+/*-----------------------------------------------------------------------------
+
+  Store.cpp
+
+-------------------------------------------------------------------------------
+
+  The page store keeps every cached page for a world in a single file.  The
+  file begins with a header and an index with one slot per page, followed 
+  by the page data itself.  Data is only ever appended.  When a page is 
+  written again, the index is pointed at the new copy and the old one is
+  simply abandoned.  CacheDump is how you reclaim the space.
+
+  New pages are collected in memory and written out in batches.  The data
+  goes out first and the index second, so if we die in the middle of a 
+  flush we lose that batch and nothing else.
+
+  The file is memory-mapped, so reading a page costs nothing but the 
+  pointer.  The pointer is only good until StoreRelease (), since a flush
+  has to re-map the file to see the new data.  Flushes wait for all readers
+  to be done.
+
+-----------------------------------------------------------------------------*/
+
+#include "Core.h"
+#include "Console.h"
+#include "Platform.h"
+#include "Store.h"
+
+#define STORE_MAGIC       0x53524650 //"PFRS"
+#define STORE_VERSION     1
+//How much new data we collect before writing it out.
+#define STORE_BATCH       (4 * 1024 * 1024)
+
+struct SHeader
+{
+  unsigned    magic;
+  int         version;
+  unsigned    seed;
+  unsigned    generator;
+  int         grid;
+};
+
+struct SEntry
+{
+  unsigned    offset;
+  unsigned    size;
+};
+
+static PlatformMutex* lock;
+static PlatformCond*  idle;
+static int            readers;
+static PlatformFile*  file;
+static const UCHAR*   view;
+static unsigned       file_size;
+static int            grid;
+static SEntry*        table;   //The index, one entry per page
+//New entries which point into the batch rather than the file.  The index 
+//keeps pointing at the copy on disk until the batch is safely written.
+static SEntry*        pending;
+static vector<UCHAR>  batch;
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+static void do_unmap ()
+{
+
+  if (view)
+    PlatformFileUnmap (file);
+  view = NULL;
+
+}
+
+static void do_map ()
+{
+
+  view = PlatformFileMap (file);
+  if (!view)
+    ConsoleLog ("StoreOpen: Unable to map page store.");
+
+}
+
+static bool do_write (unsigned offset, const void* data, unsigned size)
+{
+
+  return PlatformFileWrite (file, offset, data, size);
+
+}
+
+//Must be called with the lock held, and no readers.
+static void do_flush ()
+{
+
+  int     i;
+
+  if (batch.empty () || !file)
+    return;
+  do_unmap ();
+  if (do_write (file_size, &batch[0], batch.size ())) {
+    for (i = 0; i < grid * grid; i++) {
+      if (pending[i].size) {
+        table[i].offset = pending[i].offset + file_size;
+        table[i].size = pending[i].size;
+      }
+    }
+    file_size += batch.size ();
+    do_write (sizeof (SHeader), table, sizeof (SEntry) * grid * grid);
+  } else 
+    ConsoleLog ("StoreFlush: Write failed, %d bytes lost.", (int)batch.size ());
+  //If the write failed, the index still has whatever was on disk before.
+  memset (pending, 0, sizeof (SEntry) * grid * grid);
+  batch.clear ();
+  do_map ();
+
+}
+
+//Empty the file and give it a fresh header and index.
+static void do_reset (SHeader* header)
+{
+
+  do_unmap ();
+  PlatformFileTruncate (file, 0);
+  memset (table, 0, sizeof (SEntry) * grid * grid);
+  memset (pending, 0, sizeof (SEntry) * grid * grid);
+  batch.clear ();
+  do_write (0, header, sizeof (SHeader));
+  do_write (sizeof (SHeader), table, sizeof (SEntry) * grid * grid);
+  file_size = sizeof (SHeader) + sizeof (SEntry) * grid * grid;
+
+}
+
+static void wait_for_readers ()
+{
+
+  while (readers)
+    PlatformCondWait (idle, lock);
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void StoreOpen (const char* filename, int grid_size, unsigned seed, unsigned generator)
+{
+
+  SHeader   header, expected;
+  bool      valid;
+
+  StoreClose ();
+  PlatformMutexLock (lock);
+  file = PlatformFileOpen (filename);
+  if (!file) {
+    ConsoleLog ("StoreOpen: Could not open %s", filename);
+    PlatformMutexUnlock (lock);
+    return;
+  }
+  grid = grid_size;
+  table = new SEntry[grid * grid];
+  pending = new SEntry[grid * grid];
+  expected.magic = STORE_MAGIC;
+  expected.version = STORE_VERSION;
+  expected.seed = seed;
+  expected.generator = generator;
+  expected.grid = grid;
+  file_size = PlatformFileSize (file);
+  valid = false;
+  if (file_size >= sizeof (SHeader) + sizeof (SEntry) * grid * grid) {
+    if (PlatformFileRead (file, 0, &header, sizeof (SHeader)) && !memcmp (&header, &expected, sizeof (SHeader))) 
+      valid = PlatformFileRead (file, sizeof (SHeader), table, sizeof (SEntry) * grid * grid);
+  }
+  if (valid) {
+    memset (pending, 0, sizeof (SEntry) * grid * grid);
+  } else {
+    do_reset (&expected);
+    ConsoleLog ("StoreOpen: Started new page store %s", filename);
+  }
+  do_map ();
+  PlatformMutexUnlock (lock);
+
+}
+
+void StoreClose ()
+{
+
+  PlatformMutexLock (lock);
+  wait_for_readers ();
+  if (file) {
+    do_flush ();
+    do_unmap ();
+    PlatformFileClose (file);
+    file = NULL;
+    delete[] table;
+    delete[] pending;
+    table = NULL;
+    pending = NULL;
+  }
+  PlatformMutexUnlock (lock);
+
+}
+
+//Throw away every page in the store.
+void StoreClear ()
+{
+
+  SHeader   header;
+
+  PlatformMutexLock (lock);
+  wait_for_readers ();
+  if (file) {
+    PlatformFileRead (file, 0, &header, sizeof (SHeader));
+    do_reset (&header);
+    do_map ();
+  }
+  PlatformMutexUnlock (lock);
+
+}
+
+void StoreFlush ()
+{
+
+  PlatformMutexLock (lock);
+  wait_for_readers ();
+  do_flush ();
+  PlatformMutexUnlock (lock);
+
+}
+
+bool StoreIsOpen ()
+{
+
+  return file != NULL;
+
+}
+
+/*-----------------------------------------------------------------------------
+  Get a pointer to the stored data for a page, or NULL if we don't have it.
+  If this returns data, you must call StoreRelease () when you're done.
+-----------------------------------------------------------------------------*/
+
+const UCHAR* StoreRead (int x, int y, int* size)
+{
+
+  const UCHAR*  result;
+  SEntry*       e;
+
+  result = NULL;
+  PlatformMutexLock (lock);
+  if (file && x >= 0 && x < grid && y >= 0 && y < grid) {
+    e = &pending[x + y * grid];
+    if (e->size) 
+      result = &batch[e->offset];
+    else {
+      e = &table[x + y * grid];
+      if (e->size && view && e->offset + e->size <= file_size)
+        result = view + e->offset;
+    }
+  }
+  if (result) {
+    *size = e->size;
+    readers++;
+  }
+  PlatformMutexUnlock (lock);
+  return result;
+
+}
+
+void StoreRelease ()
+{
+
+  PlatformMutexLock (lock);
+  readers--;
+  if (!readers)
+    PlatformCondBroadcast (idle);
+  PlatformMutexUnlock (lock);
+
+}
+
+void StoreWrite (int x, int y, const UCHAR* data, int size)
+{
+
+  SEntry*   e;
+
+  PlatformMutexLock (lock);
+  if (file && x >= 0 && x < grid && y >= 0 && y < grid) {
+    wait_for_readers ();
+    e = &pending[x + y * grid];
+    e->offset = batch.size ();
+    e->size = size;
+    batch.insert (batch.end (), data, data + size);
+    if (batch.size () >= STORE_BATCH)
+      do_flush ();
+  }
+  PlatformMutexUnlock (lock);
+
+}
+
+void StoreInfo (int* pages, unsigned long long* bytes_used, unsigned long long* bytes_file)
+{
+
+  int     i;
+
+  *pages = 0;
+  *bytes_used = 0;
+  PlatformMutexLock (lock);
+  *bytes_file = file_size + batch.size ();
+  for (i = 0; file && i < grid * grid; i++) {
+    if (pending[i].size) {
+      (*pages)++;
+      *bytes_used += pending[i].size;
+    } else if (table[i].size) {
+      (*pages)++;
+      *bytes_used += table[i].size;
+    }
+  }
+  PlatformMutexUnlock (lock);
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+void StoreInit ()
+{
+
+  lock = PlatformMutexCreate ();
+  idle = PlatformCondCreate ();
+
+}
+
+void StoreTerm ()
+{
+
+  StoreClose ();
+  PlatformCondDestroy (idle);
+  PlatformMutexDestroy (lock);
+
+}
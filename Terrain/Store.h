@@ -0,0 +1,11 @@
+void          StoreClear ();
+void          StoreClose ();
+void          StoreFlush ();
+void          StoreInfo (int* pages, unsigned long long* bytes_used, unsigned long long* bytes_file);
+void          StoreInit ();
+bool          StoreIsOpen ();
+void          StoreOpen (const char* filename, int grid, unsigned seed, unsigned generator);
+const UCHAR*  StoreRead (int x, int y, int* size);
+void          StoreRelease ();
+void          StoreTerm ();
+void          StoreWrite (int x, int y, const UCHAR* data, int size);
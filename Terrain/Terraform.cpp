@@ -14,11 +14,12 @@
  
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
-#include "entropy.h"
-#include "math.h"
-#include "random.h"
-#include "world.h"
+#include "Core.h"
+#include "Entropy.h"
+#include "Math.h"
+#include "Platform.h"
+#include "Random.h"
+#include "World.h"
 
 //The number of regions around the edge which should be ocean.
 #define OCEAN_BUFFER      (WORLD_GRID / 10) 
@@ -26,8 +27,32 @@
 #define FREQUENCY         1 
 //How many different colors of flowers are available
 #define FLOWER_PALETTE    (sizeof (flower_palette) / sizeof (GLrgba))
+//Most threads to split a pass between.
+#define MAX_THREADS       8
+//flow_dir for ocean regions, which don't drain anywhere.
+#define FLOW_NONE         4
+//How many regions have to drain through a spot before a river can start there.
+#define RIVER_SOURCE      4
+//How many of the best spots for a lake get a look.
+#define LAKE_CANDIDATES   256
+//Rows of the map the climate pass carries along at once.
+#define CLIMATE_BAND      16
+
+struct FloodCell
+{
+  float     level;
+  unsigned  order;
+  GLcoord   pos;
+};
+
+struct ColumnJob
+{
+  void      (*column) (int x);
+  int       first;
+  int       step;
+};
 
-static char*        direction_name[] = 
+static const char*  direction_name[] = 
 {
   "Northern",
   "Southern",
@@ -52,12 +77,90 @@ static GLrgba       flower_palette[] = {
   {1.0f, 0.0f, 0.5f, 1.0f}, //Maroon
 };
 
+//The drainage map, built once by flow_build.  For each region: which of
+//direction[] its water leaves by, how many regions drain through it
+//(itself included), and how deep it sits in a pit that would have to
+//fill up before it could drain.
+static UCHAR        flow_dir[WORLD_GRID][WORLD_GRID];
+static int          flow_accum[WORLD_GRID][WORLD_GRID];
+static float        flow_depth[WORLD_GRID][WORLD_GRID];
+
+//Which regions have been given a climate, while zones are being placed. 
+//This is a 2D Fenwick tree: each entry holds the count for a block of 
+//regions whose size depends on the low bits of its index, so counting any 
+//rectangle or marking one region touches at most 9x9 entries.
+static int          occupied[WORLD_GRID + 1][WORLD_GRID + 1];
+
+//The search outward from the sea, and the nearest bit of sea to each region
+//it reaches.  These are kept around since previews build the shore each time.
+static GLcoord      shore_queue[WORLD_GRID * WORLD_GRID];
+static GLcoord      shore_nearest[WORLD_GRID][WORLD_GRID];
+
+//Scratch space for the passes that run in parallel.  They're split up by 
+//column, and the columns can only talk to each other through these.
+static GLcoord      prepare_offset;
+
+/*-----------------------------------------------------------------------------
+Running passes in parallel.
+
+Passes that only look at one region at a time, or only read from other 
+regions, are handed out a column at a time to a group of threads.  Each 
+column is written by exactly one thread, and any random numbers come from 
+streams keyed by the region's position rather than the shared generator, 
+so the result is the same as doing the columns in order.
+-----------------------------------------------------------------------------*/
+
+static int column_thread (void* data)
+{
+
+  ColumnJob*  job;
+  int         x;
+
+  job = (ColumnJob*)data;
+  for (x = job->first; x < WORLD_GRID; x += job->step)
+    job->column (x);
+  return 0;
+
+}
+
+//Run the given function once for each column of the map, spread over all cores.
+static void for_each_column (void (*column) (int x))
+{
+
+  PlatformThread* thread[MAX_THREADS];
+  ColumnJob       job[MAX_THREADS];
+  int             count;
+  int             i;
+
+  count = clamp (PlatformCores (), 1, MAX_THREADS);
+  for (i = 0; i < count; i++) {
+    job[i].column = column;
+    job[i].first = i;
+    job[i].step = count;
+  }
+  //The calling thread takes the first share itself.
+  for (i = 1; i < count; i++)
+    thread[i] = PlatformThreadCreate (column_thread, &job[i]);
+  column_thread (&job[0]);
+  for (i = 1; i < count; i++)
+    PlatformThreadWait (thread[i]);
+
+}
+
 /*-----------------------------------------------------------------------------
 Helper functions
 -----------------------------------------------------------------------------*/
 
+//The next number in this region's sequence for the given stream.
+static unsigned long region_random (RandomStream stream, GLcoord pos, unsigned* index)
+{
+
+  return RandomAt (WorldPtr ()->seed, stream, pos.x, pos.y, (*index)++);
+
+}
+
 //In general, what part of the map is this coordinate in?
-static char* get_direction_name (int x, int y)
+static const char* get_direction_name (int x, int y)
 {
 
   GLcoord   from_center;
@@ -96,90 +199,111 @@ GLcoord get_map_side (int x, int y)
 
 }
 
-//Test the given area and see if it contains the given climate.
-static bool is_climate_present (int x, int y, int radius, Climate c) 
+//Count up which regions are already taken. Done once, before placing zones.
+static void occupied_build ()
 {
 
-  GLcoord   start, end;
-  int       xx, yy;
-  Region    r;
+  World*    w;
+  int       x, y, up;
 
-  start.x = max (x - radius, 0);
-  start.y = max (y - radius, 0);
-  end.x = min (x + radius, WORLD_GRID - 1);
-  end.y = min (y + radius, WORLD_GRID - 1);
-  for (xx = start.x; xx <= end.x; xx++) {
-    for (yy = start.y; yy <= end.y; yy++) {
-      r = WorldRegionGet (xx, yy);
-      if (r.climate == c)
-        return true;
+  w = WorldPtr ();
+  memset (occupied, 0, sizeof (occupied));
+  for (x = 0; x < WORLD_GRID; x++) {
+    for (y = 0; y < WORLD_GRID; y++)
+      occupied[x + 1][y + 1] = (w->climate[x][y] != CLIMATE_INVALID) ? 1 : 0;
+  }
+  //Push each entry up into the one that covers it, first down the columns, 
+  //then across them.
+  for (x = 1; x <= WORLD_GRID; x++) {
+    for (y = 1; y <= WORLD_GRID; y++) {
+      up = y + (y & -y);
+      if (up <= WORLD_GRID)
+        occupied[x][up] += occupied[x][y];
     }
   }
-  return false;
+  for (x = 1; x <= WORLD_GRID; x++) {
+    up = x + (x & -x);
+    if (up > WORLD_GRID)
+      continue;
+    for (y = 1; y <= WORLD_GRID; y++)
+      occupied[up][y] += occupied[x][y];
+  }
 
 }
 
-//check the regions around the given one, see if they are unused
-static bool is_free (int x, int y, int radius)
+static void occupied_mark (int x, int y)
 {
 
-  int       xx, yy;
-  Region    r;
+  int       i, j;
 
-  for (xx = -radius; xx <= radius; xx++) {
-    for (yy = -radius; yy <= radius; yy++) {
-      if (x + xx < 0 || x + xx >= WORLD_GRID)
-        return false;
-      if (y + yy < 0 || y + yy >= WORLD_GRID)
-        return false;
-      r = WorldRegionGet (x + xx, y + yy);
-      if (r.climate != CLIMATE_INVALID)
-        return false;
-    }
+  for (i = x + 1; i <= WORLD_GRID; i += i & -i) {
+    for (j = y + 1; j <= WORLD_GRID; j += j & -j)
+      occupied[i][j]++;
   }
-  return true;
 
 }
 
-
-//look around the map and find an unused area of the desired size
-static bool find_plot (int radius, GLcoord* result)
+//How many regions are taken with x below end_x and y below end_y.
+static int occupied_below (int end_x, int end_y)
 {
 
-  int       cycles;
-  GLcoord   test;
-  
-  cycles = 0;
-  while (cycles < 20) {
-    cycles++;
-    test.x = RandomVal () % WORLD_GRID;
-    test.y = RandomVal () % WORLD_GRID;
-    if (is_free (test.x, test.y, radius)) {
-      *result = test;
-      return true;
-    }
+  int       i, j;
+  int       count;
+
+  count = 0;
+  for (i = end_x; i > 0; i -= i & -i) {
+    for (j = end_y; j > 0; j -= j & -j)
+      count += occupied[i][j];
   }
-  //couldn't find a spot. Map is full, or just bad dice rolls. 
-  return false; 
+  return count;
+
+}
+
+//Write a region while placing zones, keeping track of which are taken.
+static void zone_set (int x, int y, Region r)
+{
+
+  if (WorldPtr ()->climate[x][y] == CLIMATE_INVALID && r.climate != CLIMATE_INVALID)
+    occupied_mark (x, y);
+  WorldRegionSet (x, y, r);
 
 }
 
+//check the regions around the given one, see if they are unused
+static bool is_free (int x, int y, int radius)
+{
+
+  int       x0, y0, x1, y1;
+
+  x0 = x - radius;
+  y0 = y - radius;
+  x1 = x + radius + 1;
+  y1 = y + radius + 1;
+  if (x0 < 0 || y0 < 0 || x1 > WORLD_GRID || y1 > WORLD_GRID)
+    return false;
+  return occupied_below (x1, y1) - occupied_below (x0, y1) - occupied_below (x1, y0) + occupied_below (x0, y0) == 0;
+
+}
+
+
 //Gives a 1 in 'odds' chance of adding flowers to the given region
 void add_flowers (Region* r, unsigned odds)
 {
 
   GLrgba    c;
   int       shape;
+  unsigned  n;
 
-  r->has_flowers = RandomVal () % odds == 0;
-  shape = RandomVal ();
-  c = flower_palette[RandomVal () % FLOWER_PALETTE];
+  n = 0;
+  r->has_flowers = region_random (RANDOM_FLOWERS, r->grid_pos, &n) % odds == 0;
+  shape = region_random (RANDOM_FLOWERS, r->grid_pos, &n);
+  c = flower_palette[region_random (RANDOM_FLOWERS, r->grid_pos, &n) % FLOWER_PALETTE];
   for (int i = 0; i < FLOWERS; i++) {
     r->color_flowers[i] = c;
     r->flower_shape[i] = shape;
-    if ((RandomVal () % 15) == 0) {
-      shape = RandomVal ();
-      c = flower_palette[RandomVal () % FLOWER_PALETTE];
+    if ((region_random (RANDOM_FLOWERS, r->grid_pos, &n) % 15) == 0) {
+      shape = region_random (RANDOM_FLOWERS, r->grid_pos, &n);
+      c = flower_palette[region_random (RANDOM_FLOWERS, r->grid_pos, &n) % FLOWER_PALETTE];
     }
   }
 
@@ -214,7 +338,7 @@ static void do_mountain (int x, int y, int mtn_size)
       r.geo_bias = (WorldNoisef (xx + yy) * 0.5f + (float)r.mountain_height) * REGION_SIZE / 2;
       r.flags_shape = REGION_FLAG_NOBLEND;
       r.climate = CLIMATE_MOUNTAIN;
-      WorldRegionSet (xx + x, yy + y, r);
+      zone_set (xx + x, yy + y, r);
     }
   }
 
@@ -234,7 +358,7 @@ static void do_rocky (int x, int y, int size)
       r.geo_detail = 40.0f;
       //r.flags_shape = REGION_FLAG_NOBLEND;
       r.climate = CLIMATE_ROCKY;
-      WorldRegionSet (x + xx, y + yy, r);
+      zone_set (x + xx, y + yy, r);
     }
   }
 
@@ -264,7 +388,7 @@ static void do_plains (int x, int y, int size)
       r.geo_detail = 1.5f + WorldNoisef (x + xx + (y + yy) * WORLD_GRID) * 2.0f;
       add_flowers (&r, 8);
       r.flags_shape |= REGION_FLAG_NOBLEND;
-      WorldRegionSet (x + xx, y + yy, r);
+      zone_set (x + xx, y + yy, r);
     }
   }
 
@@ -292,7 +416,7 @@ static void do_swamp (int x, int y, int size)
       r.geo_detail = 8.0f;
       r.has_flowers = false;
       r.flags_shape |= REGION_FLAG_NOBLEND;
-      WorldRegionSet (x + xx, y + yy, r);
+      zone_set (x + xx, y + yy, r);
     }
   }
 
@@ -314,7 +438,7 @@ static void do_field (int x, int y, int size)
       r.color_atmosphere = glRgba (0.8f, 0.7f, 0.2f);
       r.geo_detail = 8.0f;
       r.flags_shape |= REGION_FLAG_NOBLEND;
-      WorldRegionSet (x + xx, y + yy, r);
+      zone_set (x + xx, y + yy, r);
     }
   }
 
@@ -337,7 +461,7 @@ static void do_forest (int x, int y, int size)
       r.geo_detail = 8.0f;
       r.tree_threshold = 0.66f;
       //r.flags_shape |= REGION_FLAG_NOBLEND;
-      WorldRegionSet (x + xx, y + yy, r);
+      zone_set (x + xx, y + yy, r);
     }
   }
 
@@ -360,7 +484,7 @@ static void do_desert (int x, int y, int size)
       r.geo_detail = 8.0f;
       r.geo_bias = 4.0f;
       r.tree_threshold = 0.0f;
-      WorldRegionSet (x + xx, y + yy, r);
+      zone_set (x + xx, y + yy, r);
     }
   }
 
@@ -384,11 +508,161 @@ static void do_canyon (int x, int y, int radius)
     r.geo_detail = 5 + step * 25.0f;
     //r.geo_detail = 1;
     r.flags_shape |= REGION_FLAG_CANYON_NS | REGION_FLAG_NOBLEND;
-    WorldRegionSet (x, y + yy, r);
+    zone_set (x, y + yy, r);
   }
 
 }
 
+/*-----------------------------------------------------------------------------
+Drainage.
+
+A priority-flood: starting with the ocean, keep taking the lowest region on 
+the edge of the flooded area and flooding its unflooded neighbors.  Each 
+region drains into whichever neighbor flooded it, which is always downhill 
+or level once pits are filled.  Regions come off the queue in order from the
+sea, so going through them backwards adds up the flow in one pass.
+
+Rivers move in four directions, so this only steps to four neighbors.
+-----------------------------------------------------------------------------*/
+
+static bool flood_less (const FloodCell& a, const FloodCell& b)
+{
+
+  if (a.level != b.level)
+    return a.level < b.level;
+  return a.order < b.order;
+
+}
+
+static void flood_push (vector<FloodCell>& heap, FloodCell c)
+{
+
+  unsigned    i, parent;
+
+  heap.push_back (c);
+  i = heap.size () - 1;
+  while (i) {
+    parent = (i - 1) / 2;
+    if (!flood_less (heap[i], heap[parent]))
+      break;
+    c = heap[i];
+    heap[i] = heap[parent];
+    heap[parent] = c;
+    i = parent;
+  }
+
+}
+
+static FloodCell flood_pop (vector<FloodCell>& heap)
+{
+
+  FloodCell   result, swap;
+  unsigned    i, child;
+
+  result = heap[0];
+  heap[0] = heap.back ();
+  heap.pop_back ();
+  i = 0;
+  while ((child = i * 2 + 1) < heap.size ()) {
+    if (child + 1 < heap.size () && flood_less (heap[child + 1], heap[child]))
+      child++;
+    if (!flood_less (heap[child], heap[i]))
+      break;
+    swap = heap[i];
+    heap[i] = heap[child];
+    heap[child] = swap;
+    i = child;
+  }
+  return result;
+
+}
+
+static void flow_build ()
+{
+
+  World*            w;
+  vector<FloodCell> heap;
+  vector<GLcoord>   order;
+  FloodCell         cell, next;
+  GLcoord           pos, down;
+  unsigned          count;
+  int               x, y, i;
+  unsigned          d;
+
+  w = WorldPtr ();
+  count = 0;
+  order.reserve (WORLD_GRID * WORLD_GRID);
+  for (x = 0; x < WORLD_GRID; x++) {
+    for (y = 0; y < WORLD_GRID; y++) {
+      flow_accum[x][y] = 1;
+      flow_depth[x][y] = 0.0f;
+      flow_dir[x][y] = FLOW_NONE + 1;
+      if (w->climate[x][y] == CLIMATE_OCEAN) {
+        flow_dir[x][y] = FLOW_NONE;
+        cell.level = w->geo_water[x][y];
+        cell.order = count++;
+        cell.pos.x = x;
+        cell.pos.y = y;
+        flood_push (heap, cell);
+      }
+    }
+  }
+  while (!heap.empty ()) {
+    cell = flood_pop (heap);
+    order.push_back (cell.pos);
+    for (d = 0; d < 4; d++) {
+      pos = cell.pos + direction[d];
+      if (pos.x < 0 || pos.x >= WORLD_GRID || pos.y < 0 || pos.y >= WORLD_GRID)
+        continue;
+      if (flow_dir[pos.x][pos.y] != FLOW_NONE + 1)
+        continue;
+      //North and south are next to each other in direction[], as are east 
+      //and west, so flipping the low bit gives the way back.
+      flow_dir[pos.x][pos.y] = d ^ 1;
+      next.level = max (w->geo_water[pos.x][pos.y], cell.level);
+      next.order = count++;
+      next.pos = pos;
+      flow_depth[pos.x][pos.y] = next.level - w->geo_water[pos.x][pos.y];
+      flood_push (heap, next);
+    }
+  }
+  for (i = (int)order.size () - 1; i >= 0; i--) {
+    pos = order[i];
+    if (flow_dir[pos.x][pos.y] == FLOW_NONE)
+      continue;
+    down = pos + direction[flow_dir[pos.x][pos.y]];
+    flow_accum[down.x][down.y] += flow_accum[pos.x][pos.y];
+  }
+
+}
+
+//Sort regions by how much water drains through them, most first.
+static int flow_compare (const void* elem1, const void* elem2)
+{
+
+  const GLcoord*  a = (const GLcoord*)elem1;
+  const GLcoord*  b = (const GLcoord*)elem2;
+
+  return flow_accum[b->x][b->y] - flow_accum[a->x][a->y];
+
+}
+
+//Sort regions by how deep a pit they're in, deepest first. Ties go to the 
+//one with more water draining into it.
+static int pit_compare (const void* elem1, const void* elem2)
+{
+
+  const GLcoord*  a = (const GLcoord*)elem1;
+  const GLcoord*  b = (const GLcoord*)elem2;
+
+  if (flow_depth[a->x][a->y] > flow_depth[b->x][b->y])
+    return -1;
+  if (flow_depth[a->x][a->y] < flow_depth[b->x][b->y])
+    return 1;
+  return flow_compare (elem1, elem2);
+
+}
+
 static bool try_lake (int try_x, int try_y, int id)
 {
 
@@ -435,69 +709,45 @@ static bool try_lake (int try_x, int try_y, int id)
 
 }
 
-static bool try_river (int start_x, int start_y, int id)
+//Follow the main stem of the river that reaches the sea at mouth back up 
+//to where it starts, then trace it down again and place it.
+static bool try_river (GLcoord mouth, int id)
 {
 
   Region            r;
   Region            neighbor;
   vector<GLcoord>   path;
   GLcoord           selected;
-  GLcoord           last_move;
-  GLcoord           to_coast;
+  GLcoord           pos, up, best;
+  int               start_x, start_y;
   int               x, y;
   int               xx, yy;
   unsigned          d;
-  float             lowest;
   float             water_level;
   float             water_strength;
 
-  x = start_x;
-  y = start_y;
+  pos = mouth;
   while (1) {
-    r = WorldRegionGet (x, y);
-    //If we run into the ocean, then we're done.
-    if (r.climate == CLIMATE_OCEAN) 
-      break;
-    if (r.climate == CLIMATE_MOUNTAIN) 
-      return false;
-    //If we run into a river, we've become a tributary.
-    if (r.climate == CLIMATE_RIVER) {
-      //don't become a tributary at the start of a river. Looks odd.
-      if (r.river_segment < 7)
-        return false;
-      break;
-    }
-    lowest = r.geo_water;
-    to_coast = get_map_side (x, y);
-    //lowest = 999.9f;
-    selected.Clear ();
+    best.Clear ();
     for (d = 0; d < 4; d++) {
-      neighbor = WorldRegionGet (x + direction[d].x, y + direction[d].y);
-      //Don't reverse course into ourselves
-      if (last_move == (direction[d] * -1))
+      up = pos + direction[d];
+      if (up.x < 0 || up.x >= WORLD_GRID || up.y < 0 || up.y >= WORLD_GRID)
         continue;
-      //ALWAYS go for the ocean, if available
-      if (neighbor.climate == CLIMATE_OCEAN) {
-        selected = direction[d];
-        lowest = neighbor.geo_water;
-      } 
-      //Don't head directly AWAY from the coast
-      if (direction[d] == to_coast * -1)
+      if (flow_dir[up.x][up.y] != (d ^ 1) || flow_accum[up.x][up.y] < RIVER_SOURCE)
         continue;
-      //Go whichever way is lowest
-      if (neighbor.geo_water < lowest) {
-        selected = direction[d];
-        lowest = neighbor.geo_water;
-      }
-      //WorldRegionSet (x + direction[d].x, y + direction[d].y, neighbor);
+      if ((!best.x && !best.y) || flow_accum[up.x][up.y] > flow_accum[pos.x + best.x][pos.y + best.y])
+        best = direction[d];
     }
-    //If everthing around us is above us, we can't flow downhill
-    if (!selected.x && !selected.y) //Let's just head for the edge of the map
-      selected = to_coast;
-    last_move = selected;
-    x += selected.x;
-    y += selected.y;
+    if (!best.x && !best.y)
+      break;
+    pos += best;
+  }
+  start_x = pos.x;
+  start_y = pos.y;
+  while (flow_dir[pos.x][pos.y] != FLOW_NONE) {
+    selected = direction[flow_dir[pos.x][pos.y]];
     path.push_back (selected);
+    pos += selected;
   }
   //If the river is too short, ditch it.
   if (path.size () < (WORLD_GRID / 4))
@@ -579,93 +829,133 @@ The following functions are used when building a new world.
 -----------------------------------------------------------------------------*/
 
 //pass over the map, calculate the temp & moisture
+//This only touches a few planes, so it works on them directly instead of 
+//going through whole Regions.  Rain blows across each row from the windward
+//edge, which is always ocean, so rows don't depend on each other.  The planes
+//are laid out by column, so we carry a band of rows across together to keep 
+//from striding through memory.
 void TerraformClimate () 
 {
 
-  int       x, y;  
-  float     rainfall, rain_loss, temp;
-  Region    r;
+  int       x, y, step, band, i;
+  float     rainfall[CLIMATE_BAND];
+  float     rain_loss, temp;
+  float     moisture;
+  int       mountain_height;
+  Climate   climate;
   GLvector2 from_center;
   float     distance;
-  GLcoord   walk;
   World*    w;
 
-  rainfall = 1.0f;
   w = WorldPtr ();
-  walk.Clear ();
-  do {
-    //Wind (and thus rainfall) come from west.
-    if (w->wind_from_west) 
-      x = walk.x; 
-    else 
-      x = (WORLD_GRID - 1) - walk.x;
-    y = walk.y;
-    r = WorldRegionGet (x, y);
-    //************   TEMPERATURE *******************//
-    //The north 25% is max cold.  The south 25% is all tropical
-    //On a southern hemisphere map, this is reversed.
-    if (w->northern_hemisphere)
-      temp = ((float)y - (WORLD_GRID / 4)) / WORLD_GRID_CENTER;
-    else 
-      temp = ((float)(WORLD_GRID - y) - (WORLD_GRID / 4)) / WORLD_GRID_CENTER;
-    //Mountains are cooler at the top
-    if (r.mountain_height) 
-      temp -= (float)r.mountain_height * 0.15f;
-    //We add a slight bit of heat to the center of the map, to
-    //round off climate boundaries.
-    from_center = glVector ((float)(x - WORLD_GRID_CENTER), (float)(x - WORLD_GRID_CENTER));
-    distance = from_center.Length () / WORLD_GRID_CENTER;
-    temp += distance * 0.2f;
-    temp = clamp (temp, MIN_TEMP, MAX_TEMP);
-    //************  RAINFALL *******************//
-    //Oceans are ALWAYS WET.
-    if (r.climate == CLIMATE_OCEAN) 
-      rainfall = 1.0f;
-    rain_loss = 0.0f;
-    //We lose rainfall as we move inland.
-    if (r.climate != CLIMATE_OCEAN && r.climate != CLIMATE_COAST && r.climate != CLIMATE_LAKE)
-      rain_loss = 1.0f / WORLD_GRID_CENTER;
-    //We lose rainfall more slowly as it gets colder.
-    if (temp < 0.5f)
-      rain_loss *= temp;
-    rainfall -= rain_loss;
-    //Mountains block rainfall
-    if (r.climate == CLIMATE_MOUNTAIN) 
-      rainfall -= 0.1f * r.mountain_height;
-    r.moisture = max (rainfall, 0);
-    //Rivers always give some moisture
-    if (r.climate == CLIMATE_RIVER || r.climate == CLIMATE_RIVER_BANK) {
-      r.moisture = max (r.moisture, 0.75f);
-      rainfall += 0.05f;
-      rainfall = min (rainfall, 1);
+  for (band = 0; band < WORLD_GRID; band += CLIMATE_BAND) {
+    for (i = 0; i < CLIMATE_BAND; i++)
+      rainfall[i] = 1.0f;
+    for (step = 0; step < WORLD_GRID; step++) {
+      //Wind (and thus rainfall) come from west.
+      if (w->wind_from_west) 
+        x = step; 
+      else 
+        x = (WORLD_GRID - 1) - step;
+      //We add a slight bit of heat to the center of the map, to
+      //round off climate boundaries.
+      from_center = glVector ((float)(x - WORLD_GRID_CENTER), (float)(x - WORLD_GRID_CENTER));
+      distance = from_center.Length () / WORLD_GRID_CENTER;
+      for (i = 0; i < CLIMATE_BAND; i++) {
+        y = band + i;
+        climate = (Climate)w->climate[x][y];
+        mountain_height = w->info[x][y].mountain_height;
+        //************   TEMPERATURE *******************//
+        //The north 25% is max cold.  The south 25% is all tropical
+        //On a southern hemisphere map, this is reversed.
+        if (w->northern_hemisphere)
+          temp = ((float)y - (WORLD_GRID / 4)) / WORLD_GRID_CENTER;
+        else 
+          temp = ((float)(WORLD_GRID - y) - (WORLD_GRID / 4)) / WORLD_GRID_CENTER;
+        //Mountains are cooler at the top
+        if (mountain_height) 
+          temp -= (float)mountain_height * 0.15f;
+        temp += distance * 0.2f;
+        temp = clamp (temp, MIN_TEMP, MAX_TEMP);
+        //************  RAINFALL *******************//
+        //Oceans are ALWAYS WET.
+        if (climate == CLIMATE_OCEAN) 
+          rainfall[i] = 1.0f;
+        rain_loss = 0.0f;
+        //We lose rainfall as we move inland.
+        if (climate != CLIMATE_OCEAN && climate != CLIMATE_COAST && climate != CLIMATE_LAKE)
+          rain_loss = 1.0f / WORLD_GRID_CENTER;
+        //We lose rainfall more slowly as it gets colder.
+        if (temp < 0.5f)
+          rain_loss *= temp;
+        rainfall[i] -= rain_loss;
+        //Mountains block rainfall
+        if (climate == CLIMATE_MOUNTAIN) 
+          rainfall[i] -= 0.1f * mountain_height;
+        moisture = max (rainfall[i], 0);
+        //Rivers always give some moisture
+        if (climate == CLIMATE_RIVER || climate == CLIMATE_RIVER_BANK) {
+          moisture = max (moisture, 0.75f);
+          rainfall[i] += 0.05f;
+          rainfall[i] = min (rainfall[i], 1);
+        }
+        //oceans have a moderating effect on climate
+        if (climate == CLIMATE_OCEAN) 
+          temp = (temp + 0.5f) / 2.0f;
+        //moisture = min (1, moisture + WorldNoisef (x + y * WORLD_GRID) * 0.1f);
+        //temp = min (1, temp + WorldNoisef (x + y * WORLD_GRID) * 0.1f);
+        w->moisture[x][y] = moisture;
+        w->temperature[x][y] = temp;
+      }
     }
-    //oceans have a moderating effect on climate
-    if (r.climate == CLIMATE_OCEAN) 
-      temp = (temp + 0.5f) / 2.0f;
-    r.temperature = temp;
-    //r.moisture = min (1, r.moisture + WorldNoisef (walk.x + walk.y * WORLD_GRID) * 0.1f);
-    //r.temperature = min (1, r.temperature + WorldNoisef (walk.x + walk.y * WORLD_GRID) * 0.1f);
-    WorldRegionSet (x, y, r);
-  } while (!walk.Walk (WORLD_GRID));
+  }
 
 }
 
 
-//Figure out what plant life should grow here.
-void TerraformFlora () 
+static void flora_column (int x)
 {
 
   Region    r;
-  GLcoord   walk;
+  int       y;
 
-  walk.Clear ();
-  do {
-    r = WorldRegionGet (walk.x, walk.y);
+  for (y = 0; y < WORLD_GRID; y++) {
+    r = WorldRegionGet (x, y);
     r.tree_type =  WorldTreeType (r.moisture, r.temperature);
     if (r.climate == CLIMATE_FOREST)
       r.tree_type = WorldCanopyTree ();
-    WorldRegionSet (walk.x, walk.y, r);
-  } while (!walk.Walk (WORLD_GRID));
+    WorldRegionSet (x, y, r);
+  }
+
+}
+
+//Figure out what plant life should grow here.
+void TerraformFlora () 
+{
+
+  for_each_column (flora_column);
+
+}
+
+//Rock colors use three random numbers, which are passed in so they can
+//be drawn ahead of time.
+static GLrgba rock_color (float temperature, const float* draw)
+{
+
+  GLrgba    warm_rock, cold_rock;
+  float     fade;
+
+  //Devise a rock color
+  fade = MathScalar (temperature, FREEZING, 1.0f);
+  //Warm rock is red
+  warm_rock.red = 1.0f;
+  warm_rock.green = 1.0f - draw[0] * 0.6f;
+  warm_rock.blue = 1.0f - draw[1] * 0.6f;
+  //Cold rock is white or blue
+  cold_rock.blue = 1.0f;
+  cold_rock.green = 1.0f - draw[2] * 0.4f;
+  cold_rock.red = cold_rock.green;
+  return glRgbaInterpolate (cold_rock, warm_rock, fade);
 
 }
 
@@ -726,203 +1016,221 @@ GLrgba TerraformColorGenerate (SurfaceColor c, float moisture, float temperature
     fade = MathScalar (temperature, FREEZING, 1.0f);
     return glRgbaInterpolate (cold_dirt, warm_dirt, fade);
   case SURFACE_COLOR_ROCK:
-    GLrgba    warm_rock, cold_rock;
+    float     draw[3];
 
-    //Devise a rock color
-    fade = MathScalar (temperature, FREEZING, 1.0f);
-    //Warm rock is red
-    warm_rock.red = 1.0f;
-    warm_rock.green = 1.0f - RandomFloat () * 0.6f;
-    warm_rock.blue = 1.0f - RandomFloat () * 0.6f;
-    //Cold rock is white or blue
-    cold_rock.blue = 1.0f;
-    cold_rock.green = 1.0f - RandomFloat () * 0.4f;
-    cold_rock.red = cold_rock.green;
-    return glRgbaInterpolate (cold_rock, warm_rock, fade);
+    draw[0] = RandomFloat ();
+    draw[1] = RandomFloat ();
+    draw[2] = RandomFloat ();
+    return rock_color (temperature, draw);
   }
   //Shouldn't happen. Returns pink to flag the problem.
   return glRgba (1.0f, 0.0f, 1.0f);
 
 }
 
+static void colors_column (int x)
+{
+
+  int           y;
+  Region        r;
+  GLrgba        humid_air, dry_air, cold_air, warm_air;
+  unsigned long draw[3];
+  float         rock[3];
+
+  for (y = 0; y < WORLD_GRID; y++) {
+    r = WorldRegionGet (x, y);
+    r.color_grass = TerraformColorGenerate (SURFACE_COLOR_GRASS, r.moisture, r.temperature, r.grid_pos.x + r.grid_pos.y * WORLD_GRID);
+    r.color_dirt = TerraformColorGenerate (SURFACE_COLOR_DIRT, r.moisture, r.temperature, r.grid_pos.x + r.grid_pos.y * WORLD_GRID);
+    RandomFill (WorldPtr ()->seed, RANDOM_COLORS, x, y, draw, 3);
+    for (int i = 0; i < 3; i++)
+      rock[i] = (float)(draw[i] % 10000) / 10000;
+    r.color_rock = rock_color (r.temperature, rock);
+    //"atmosphere" is the overall color of the lighting & fog. 
+    warm_air = glRgba (0.0f, 0.2f, 1.0f);
+    cold_air = glRgba (0.7f, 0.9f, 1.0f);
+    //Only set the atmosphere color if it wasn't set elsewhere
+    if (r.color_atmosphere == glRgba (0.0f, 0.0f, 0.0f))
+      r.color_atmosphere = glRgbaInterpolate (cold_air, warm_air, r.temperature);
+    //Color the map
+    switch (r.climate) {
+    case CLIMATE_MOUNTAIN:
+      r.color_map = glRgba (0.2f + (float)r.mountain_height / 4.0f);
+      r.color_map.Normalize ();
+      break;
+    case CLIMATE_DESERT:
+      r.color_map = glRgba (0.9f, 0.7f, 0.4f);
+    case CLIMATE_COAST:
+      if (r.flags_shape & REGION_FLAG_BEACH_CLIFF)
+        r.color_map = glRgba (0.3f, 0.3f, 0.3f);
+      else
+        r.color_map = glRgba (0.9f, 0.7f, 0.4f);
+      break;
+    case CLIMATE_OCEAN:
+      r.color_map = glRgba (0.0f, 1.0f + r.geo_scale * 2.0f, 1.0f + r.geo_scale);
+      r.color_map.Clamp ();
+      break;
+    case CLIMATE_RIVER:
+    case CLIMATE_LAKE:
+      r.color_map = glRgba (0.0f, 0.0f, 0.6f);
+      break;
+    case CLIMATE_RIVER_BANK:
+      r.color_map = r.color_dirt;
+      break;
+    case CLIMATE_FIELD:
+      r.color_map = r.color_grass + glRgba (0.7f, 0.5f, 0.6f);
+      r.color_map.Normalize ();
+      break;
+    case CLIMATE_PLAINS:
+      r.color_map = r.color_grass + glRgba (0.5f, 0.5f, 0.5f);
+      r.color_map.Normalize ();
+      break;
+    case CLIMATE_FOREST:
+      r.color_map = r.color_grass + glRgba (0.0f, 0.3f, 0.0f);
+      r.color_map *= 0.5f;
+      break;
+    case CLIMATE_SWAMP:
+      r.color_grass *= 0.5f;
+      r.color_map = r.color_grass * 0.5f;
+      break;
+    case CLIMATE_ROCKY:
+      r.color_map = r.color_grass * 0.8f;
+      r.color_map += r.color_rock * 0.2f;
+      r.color_map.Normalize ();
+      r.color_map = r.color_rock;
+      break;
+    case CLIMATE_CANYON:
+      r.color_map = r.color_rock * 0.3f;
+      break;
+    default:
+      r.color_map = r.color_grass;
+      break;
+    }
+    if (r.geo_scale >= 0.0f)
+      r.color_map *= (r.geo_scale * 0.5f + 0.5f);
+    //if (r.geo_scale >= 0.0f)
+      //r.color_map = glRgbaUnique (r.tree_type);
+    //r.color_map = r.color_atmosphere;
+    WorldRegionSet (x, y, r);
+  }
+  
+}
+
 //Determine the grass, dirt, rock, and other colors used by this region.
 void TerraformColors ()
+{
+
+  for_each_column (colors_column);
+
+}
+
+#define AVERAGE_RADIUS    2
+#define AVERAGE_WIDTH     (AVERAGE_RADIUS * 2 + 1)
+
+//Sum up the square window around every region that has a full window, as 
+//two running sums: one down each column, and then one across the rows. 
+//This is the same as adding up the window directly, except for rounding.
+//The sums are left in out, and the edges of out are untouched.
+static void box_sum (float (*plane)[WORLD_GRID], float (*out)[WORLD_GRID], float (*scratch)[WORLD_GRID])
 {
 
   int       x, y;
-  Region    r;
-  GLrgba    humid_air, dry_air, cold_air, warm_air;
+  float     sum;
 
   for (x = 0; x < WORLD_GRID; x++) {
-    for (y = 0; y < WORLD_GRID; y++) {
-      r = WorldRegionGet (x, y);
-      r.color_grass = TerraformColorGenerate (SURFACE_COLOR_GRASS, r.moisture, r.temperature, r.grid_pos.x + r.grid_pos.y * WORLD_GRID);
-      r.color_dirt = TerraformColorGenerate (SURFACE_COLOR_DIRT, r.moisture, r.temperature, r.grid_pos.x + r.grid_pos.y * WORLD_GRID);
-      r.color_rock = TerraformColorGenerate (SURFACE_COLOR_ROCK, r.moisture, r.temperature, r.grid_pos.x + r.grid_pos.y * WORLD_GRID);
-      //"atmosphere" is the overall color of the lighting & fog. 
-      warm_air = glRgba (0.0f, 0.2f, 1.0f);
-      cold_air = glRgba (0.7f, 0.9f, 1.0f);
-      //Only set the atmosphere color if it wasn't set elsewhere
-      if (r.color_atmosphere == glRgba (0.0f, 0.0f, 0.0f))
-        r.color_atmosphere = glRgbaInterpolate (cold_air, warm_air, r.temperature);
-      //Color the map
-      switch (r.climate) {
-      case CLIMATE_MOUNTAIN:
-        r.color_map = glRgba (0.2f + (float)r.mountain_height / 4.0f);
-        r.color_map.Normalize ();
-        break;
-      case CLIMATE_DESERT:
-        r.color_map = glRgba (0.9f, 0.7f, 0.4f);
-      case CLIMATE_COAST:
-        if (r.flags_shape & REGION_FLAG_BEACH_CLIFF)
-          r.color_map = glRgba (0.3f, 0.3f, 0.3f);
-        else
-          r.color_map = glRgba (0.9f, 0.7f, 0.4f);
-        break;
-      case CLIMATE_OCEAN:
-        r.color_map = glRgba (0.0f, 1.0f + r.geo_scale * 2.0f, 1.0f + r.geo_scale);
-        r.color_map.Clamp ();
-        break;
-      case CLIMATE_RIVER:
-      case CLIMATE_LAKE:
-        r.color_map = glRgba (0.0f, 0.0f, 0.6f);
-        break;
-      case CLIMATE_RIVER_BANK:
-        r.color_map = r.color_dirt;
-        break;
-      case CLIMATE_FIELD:
-        r.color_map = r.color_grass + glRgba (0.7f, 0.5f, 0.6f);
-        r.color_map.Normalize ();
-        break;
-      case CLIMATE_PLAINS:
-        r.color_map = r.color_grass + glRgba (0.5f, 0.5f, 0.5f);
-        r.color_map.Normalize ();
-        break;
-      case CLIMATE_FOREST:
-        r.color_map = r.color_grass + glRgba (0.0f, 0.3f, 0.0f);
-        r.color_map *= 0.5f;
-        break;
-      case CLIMATE_SWAMP:
-        r.color_grass *= 0.5f;
-        r.color_map = r.color_grass * 0.5f;
-        break;
-      case CLIMATE_ROCKY:
-        r.color_map = r.color_grass * 0.8f;
-        r.color_map += r.color_rock * 0.2f;
-        r.color_map.Normalize ();
-        r.color_map = r.color_rock;
-        break;
-      case CLIMATE_CANYON:
-        r.color_map = r.color_rock * 0.3f;
-        break;
-      default:
-        r.color_map = r.color_grass;
-        break;
-      }
-      if (r.geo_scale >= 0.0f)
-        r.color_map *= (r.geo_scale * 0.5f + 0.5f);
-      //if (r.geo_scale >= 0.0f)
-        //r.color_map = glRgbaUnique (r.tree_type);
-      //r.color_map = r.color_atmosphere;
-      WorldRegionSet (x, y, r);
+    sum = 0.0f;
+    for (y = 0; y < AVERAGE_WIDTH; y++)
+      sum += plane[x][y];
+    scratch[x][AVERAGE_RADIUS] = sum;
+    for (y = AVERAGE_RADIUS + 1; y < WORLD_GRID - AVERAGE_RADIUS; y++) {
+      sum += plane[x][y + AVERAGE_RADIUS] - plane[x][y - AVERAGE_RADIUS - 1];
+      scratch[x][y] = sum;
     }
   }
-  
+  //Working a column at a time keeps the inner loop running through memory.
+  for (y = AVERAGE_RADIUS; y < WORLD_GRID - AVERAGE_RADIUS; y++)
+    out[AVERAGE_RADIUS][y] = 0.0f;
+  for (x = 0; x < AVERAGE_WIDTH; x++) {
+    for (y = AVERAGE_RADIUS; y < WORLD_GRID - AVERAGE_RADIUS; y++)
+      out[AVERAGE_RADIUS][y] += scratch[x][y];
+  }
+  for (x = AVERAGE_RADIUS + 1; x < WORLD_GRID - AVERAGE_RADIUS; x++) {
+    for (y = AVERAGE_RADIUS; y < WORLD_GRID - AVERAGE_RADIUS; y++)
+      out[x][y] = out[x - 1][y] + scratch[x + AVERAGE_RADIUS][y] - scratch[x - AVERAGE_RADIUS - 1][y];
+  }
+
 }
 
 //Blur the region attributes by averaging each region with its
 //neighbors.  This prevents overly harsh transitions.
+//This works right on the world's planes.  Running sums can differ from 
+//adding up each window in the last few bits, about 1e-5 of the largest 
+//value in the window.
 void TerraformAverage ()
 {
 
-  int       x, y, xx, yy, count;
-  int       radius;
-  Region    r;
-  float     (*temp)[WORLD_GRID];
+  int       x, y;
+  float     scale;
   float     (*moist)[WORLD_GRID];
-  float     (*elev)[WORLD_GRID];
-  float     (*sm)[WORLD_GRID];
+  float     (*detail)[WORLD_GRID];
   float     (*bias)[WORLD_GRID];
+  float     (*scratch)[WORLD_GRID];
+  World*    w;
 
-  temp = new float[WORLD_GRID][WORLD_GRID];
+  w = WorldPtr ();
   moist = new float[WORLD_GRID][WORLD_GRID];
-  elev = new float[WORLD_GRID][WORLD_GRID];
-  sm = new float[WORLD_GRID][WORLD_GRID];
+  detail = new float[WORLD_GRID][WORLD_GRID];
   bias = new float[WORLD_GRID][WORLD_GRID];
-
+  scratch = new float[WORLD_GRID][WORLD_GRID];
+  scale = 1.0f / (AVERAGE_WIDTH * AVERAGE_WIDTH);
   //Blur some of the attributes
   for (int passes = 0; passes < 2; passes++) {
-
-    radius = 2;
-    for (x = radius; x < WORLD_GRID - radius; x++) {
-      for (y = radius; y < WORLD_GRID - radius; y++) {
-        temp[x][y] = 0;
-        moist[x][y] = 0;
-        elev[x][y] = 0;
-        sm[x][y] = 0;
-        bias[x][y] = 0;
-        count = 0;
-        for (xx = -radius; xx <= radius; xx++) {
-          for (yy = -radius; yy <= radius; yy++) {
-            r = WorldRegionGet (x + xx, y + yy);
-            temp[x][y] += r.temperature;
-            moist[x][y] += r.moisture;
-            elev[x][y] += r.geo_water;
-            sm[x][y] += r.geo_detail;
-            bias[x][y] += r.geo_bias;
-            count++;
-          }
-        }
-        temp[x][y] /= (float)count;
-        moist[x][y] /= (float)count;
-        elev[x][y] /= (float)count;
-        sm[x][y] /= (float)count;
-        bias[x][y] /= (float)count;
-      }
-    }
+    box_sum (w->moisture, moist, scratch);
+    box_sum (w->geo_detail, detail, scratch);
+    box_sum (w->geo_bias, bias, scratch);
     //Put the blurred values back into our table
-    for (x = radius; x < WORLD_GRID - radius; x++) {
-      for (y = radius; y < WORLD_GRID - radius; y++) {
-        r = WorldRegionGet (x, y);
+    for (x = AVERAGE_RADIUS; x < WORLD_GRID - AVERAGE_RADIUS; x++) {
+      for (y = AVERAGE_RADIUS; y < WORLD_GRID - AVERAGE_RADIUS; y++) {
         //Rivers can get wetter through this process, but not drier.
-        if (r.climate == CLIMATE_RIVER) 
-          r.moisture = max (r.moisture, moist[x][y]);
-        else if (r.climate != CLIMATE_OCEAN) 
-          r.moisture = moist[x][y];//No matter how arid it is, the OCEANS STAY WET!
-        if (!(r.flags_shape & REGION_FLAG_NOBLEND)) {
-          r.geo_detail = sm[x][y];
-          r.geo_bias = bias[x][y];
+        if (w->climate[x][y] == CLIMATE_RIVER) 
+          w->moisture[x][y] = max (w->moisture[x][y], moist[x][y] * scale);
+        else if (w->climate[x][y] != CLIMATE_OCEAN) 
+          w->moisture[x][y] = moist[x][y] * scale;//No matter how arid it is, the OCEANS STAY WET!
+        if (!(w->flags_shape[x][y] & REGION_FLAG_NOBLEND)) {
+          w->geo_detail[x][y] = detail[x][y] * scale;
+          w->geo_bias[x][y] = bias[x][y] * scale;
         }
-        WorldRegionSet (x, y, r);
       }
     }
   }
-  delete []temp;
   delete []moist;
-  delete []elev;
-  delete []sm;
+  delete []detail;
   delete []bias;
+  delete []scratch;
   
 }
 
 //Indentify regions where geo_scale is negative.  These will be ocean.
+//Anything below sea level is ocean, and so is the very edge of the world.
+static bool is_ocean (int x, int y, float geo_scale)
+{
+
+  if (geo_scale <= 0.0f) 
+    return true;
+  return x == 0 || y == 0 || x == WORLD_GRID - 1 || y == WORLD_GRID - 1;
+
+}
+
 void TerraformOceans ()
 {
 
   int     x, y;
   Region  r;
-  bool    is_ocean;
   
   //define the oceans at the edge of the world
   for (x = 0; x < WORLD_GRID; x++) {
     for (y = 0; y < WORLD_GRID; y++) {
       r = WorldRegionGet (x, y);
-      is_ocean = false;
-      if (r.geo_scale <= 0.0f) 
-        is_ocean = true;
-      if (x == 0 || y == 0 || x == WORLD_GRID - 1 || y == WORLD_GRID - 1) 
-        is_ocean = true;
-      if (is_ocean) {
+      if (is_ocean (x, y, r.geo_scale)) {
         r.geo_bias = -10.0f;
         r.geo_detail = 0.3f;
         r.moisture = 1.0f;
@@ -939,72 +1247,120 @@ void TerraformOceans ()
 }
 
 //Find existing ocean regions and place costal regions beside them.
+//Find the distance from every region to the nearest ocean, and the 
+//direction to it.  This is a breadth-first search outward from all of the 
+//ocean regions at once, stepping to all eight neighbors, so each region is 
+//visited exactly once.
+static void shore_build ()
+{
+
+  World*          w;
+  GLcoord         current, next, source, offset;
+  int             i, queued;
+  int             x, y, xx, yy;
+
+  w = WorldPtr ();
+  queued = 0;
+  for (x = 0; x < WORLD_GRID; x++) {
+    for (y = 0; y < WORLD_GRID; y++) {
+      w->shore_direction[x][y] = 4;
+      if (w->climate[x][y] == CLIMATE_OCEAN) {
+        w->shore_distance[x][y] = 0;
+        current.x = x;
+        current.y = y;
+        shore_queue[queued++] = current;
+        shore_nearest[x][y] = current;
+      } else 
+        w->shore_distance[x][y] = SHORE_FAR;
+    }
+  }
+  for (i = 0; i < queued; i++) {
+    current = shore_queue[i];
+    source = shore_nearest[current.x][current.y];
+    for (xx = -1; xx <= 1; xx++) {
+      for (yy = -1; yy <= 1; yy++) {
+        next.x = current.x + xx;
+        next.y = current.y + yy;
+        if (next.x < 0 || next.x >= WORLD_GRID || next.y < 0 || next.y >= WORLD_GRID)
+          continue;
+        if (w->shore_distance[next.x][next.y] != SHORE_FAR)
+          continue;
+        w->shore_distance[next.x][next.y] = min (w->shore_distance[current.x][current.y] + 1, SHORE_FAR - 1);
+        offset = source - next;
+        offset.x = clamp (offset.x, -1, 1);
+        offset.y = clamp (offset.y, -1, 1);
+        w->shore_direction[next.x][next.y] = (offset.x + 1) + (offset.y + 1) * 3;
+        shore_nearest[next.x][next.y] = source;
+        shore_queue[queued++] = next;
+      }
+    }
+  }
+
+}
+
+//How many steps in from the sea an unassigned region is, if it's close 
+//enough to be beach (1) or coast (2).  Returns 0 for anything else.  This 
+//needs shore_build.
+static int coast_band (int x, int y)
+{
+
+  World*    w;
+
+  w = WorldPtr ();
+  if (w->climate[x][y] != CLIMATE_INVALID || w->shore_distance[x][y] > 2)
+    return 0;
+  return w->shore_distance[x][y];
+
+}
+
+//Beaches go right next to the sea, and coast goes next to the beaches.
+//This runs right after TerraformOceans, when everything that isn't ocean 
+//is still unassigned, so every region one step from the ocean becomes beach
+//and every region two steps away is touching a beach.
 void TerraformCoast ()
 {
 
   int             x, y;
   Region          r;
   int             pass;
-  unsigned        i;
   unsigned        cliff_grid;
-  bool            is_coast;
   bool            is_cliff;
-  vector<GLcoord> queue;
-  GLcoord         current;
 
   cliff_grid = WORLD_GRID / 8;
+  shore_build ();
   //now define the coast 
   for (pass = 0; pass < 2; pass++) {
-    queue.clear ();
     for (x = 0; x < WORLD_GRID; x++) {
       for (y = 0; y < WORLD_GRID; y++) {
-        r = WorldRegionGet (x, y);
         //Skip already assigned places
-        if (r.climate != CLIMATE_INVALID)
+        if (coast_band (x, y) != pass + 1)
           continue;
-        is_coast = false;
-        //On the first pass, we add beach adjoining the sea
-        if (!pass && is_climate_present (x, y, 1, CLIMATE_OCEAN)) 
-          is_coast = true;
-        //One the second pass, we add beach adjoining the beach we added on the previous step
-        if (pass && is_climate_present (x, y, 1, CLIMATE_COAST)) 
-          is_coast = true;
-        if (is_coast) {
-          current.x = x;
-          current.y = y;
-          queue.push_back (current);
-        }
-      }
-    }
-    //Now we're done scanning the map.  Run through our list and make the new regions.
-    for (i = 0; i < queue.size (); i++) {
-      current = queue[i];
-      r = WorldRegionGet (current.x, current.y);
-      is_cliff = (((current.x / cliff_grid) + (current.y / cliff_grid)) % 2) != 0;
-      if (!pass) 
-        sprintf (r.title, "%s beach", get_direction_name (current.x, current.y));
-      else
-        sprintf (r.title, "%s coast", get_direction_name (current.x, current.y));
-      //beaches are low and partially submerged
-      r.geo_detail = 5.0f + Entropy (current.x, current.y) * 10.0f;
-      if (!pass) {
-        r.geo_bias = -r.geo_detail * 0.5f;
-        if (is_cliff)
-          r.flags_shape |= REGION_FLAG_BEACH_CLIFF;
+        r = WorldRegionGet (x, y);
+        is_cliff = (((x / cliff_grid) + (y / cliff_grid)) % 2) != 0;
+        if (!pass) 
+          sprintf (r.title, "%s beach", get_direction_name (x, y));
         else
-          r.flags_shape |= REGION_FLAG_BEACH;
-      } else 
-        r.geo_bias = 0.0f;
-      r.cliff_threshold = r.geo_detail * 0.25f;
-      r.moisture = 1.0f;
-      r.geo_water = 0.0f;
-      r.flags_shape |= REGION_FLAG_NOBLEND;
-      r.climate = CLIMATE_COAST;
-      WorldRegionSet (current.x, current.y, r);
+          sprintf (r.title, "%s coast", get_direction_name (x, y));
+        //beaches are low and partially submerged
+        r.geo_detail = 5.0f + Entropy (x, y) * 10.0f;
+        if (!pass) {
+          r.geo_bias = -r.geo_detail * 0.5f;
+          if (is_cliff)
+            r.flags_shape |= REGION_FLAG_BEACH_CLIFF;
+          else
+            r.flags_shape |= REGION_FLAG_BEACH;
+        } else 
+          r.geo_bias = 0.0f;
+        r.cliff_threshold = r.geo_detail * 0.25f;
+        r.moisture = 1.0f;
+        r.geo_water = 0.0f;
+        r.flags_shape |= REGION_FLAG_NOBLEND;
+        r.climate = CLIMATE_COAST;
+        WorldRegionSet (x, y, r);
+      }
     }
   }
 
-
 }
 
 //Drop a point in the middle of the terrain and attempt to
@@ -1012,20 +1368,31 @@ void TerraformCoast ()
 void TerraformRivers (int count)
 {
 
-  int         rivers;
-  int         cycles;
-  int         x, y;
-  int         range;
-
+  vector<GLcoord>   mouths;
+  GLcoord           pos;
+  int               rivers;
+  unsigned          i;
+
+  //Every place where land drains straight into the sea is a river mouth.  
+  //The ones with the most water behind them get rivers.
+  flow_build ();
+  for (pos.x = 0; pos.x < WORLD_GRID; pos.x++) {
+    for (pos.y = 0; pos.y < WORLD_GRID; pos.y++) {
+      if (flow_dir[pos.x][pos.y] == FLOW_NONE)
+        continue;
+      if (flow_dir[pos.x + direction[flow_dir[pos.x][pos.y]].x][pos.y + direction[flow_dir[pos.x][pos.y]].y] == FLOW_NONE)
+        mouths.push_back (pos);
+    }
+  }
+  if (mouths.empty ())
+    return;
+  qsort (&mouths[0], mouths.size (), sizeof (GLcoord), flow_compare);
   rivers = 0;
-  cycles = 0;
-  range = WORLD_GRID_CENTER / 3;
-  while (rivers < count && cycles < 100) {
-    x = WORLD_GRID_CENTER + (RandomVal () % range) - range / 2;
-    y = WORLD_GRID_CENTER + (RandomVal () % range) - range / 2;
-    if (try_river (x, y, rivers)) 
+  for (i = 0; i < mouths.size () && rivers < count; i++) {
+    if (flow_accum[mouths[i].x][mouths[i].y] < RIVER_SOURCE)
+      break;
+    if (try_river (mouths[i], rivers)) 
       rivers++;
-    cycles++;
   }
 
 }
@@ -1034,25 +1401,28 @@ void TerraformRivers (int count)
 void TerraformLakes (int count)
 {
 
-  int         lakes;
-  int         cycles;
-  int         x, y;
-  int         range;
-  GLcoord     shove;
-
+  vector<GLcoord>   spots;
+  GLcoord           pos;
+  int               lakes;
+  unsigned          i;
+
+  //Lakes go where water would pool: the deepest pits in the drainage map,
+  //or failing that, where the most water collects.  The map is built again
+  //here so this pass doesn't depend on TerraformRivers having just run.
+  flow_build ();
+  for (pos.x = 0; pos.x < WORLD_GRID; pos.x++) {
+    for (pos.y = 0; pos.y < WORLD_GRID; pos.y++) {
+      if (flow_dir[pos.x][pos.y] != FLOW_NONE)
+        spots.push_back (pos);
+    }
+  }
+  if (spots.empty ())
+    return;
+  qsort (&spots[0], spots.size (), sizeof (GLcoord), pit_compare);
   lakes = 0;
-  cycles = 0;
-  range = WORLD_GRID_CENTER / 4;
-  while (lakes < count && cycles < 100) {
-    //Pick a random spot in the middle of the map
-    x = WORLD_GRID_CENTER + (WorldNoisei (cycles) % range) - range / 2;
-    y = WORLD_GRID_CENTER + (WorldNoisei (cycles * 2) % range) - range / 2;
-    //Now push that point away from the middle
-    shove = get_map_side (x, y);
-    shove *= range;
-    if (try_lake (x + shove.x, y + shove.y, lakes)) 
+  for (i = 0; i < spots.size () && i < LAKE_CANDIDATES && lakes < count; i++) {
+    if (try_lake (spots[i].x, spots[i].y, lakes)) 
       lakes++;
-    cycles++;
   }
 
 }
@@ -1069,6 +1439,7 @@ void TerraformZones ()
   GLcoord         walk;
   UINT            spinner;
 
+  occupied_build ();
   walk.Clear ();
   spinner = 0;
   do {
@@ -1143,6 +1514,7 @@ void TerraformFill ()
   int       x, y;
   Region    r;
   unsigned  rand;
+  unsigned  n;
 
   for (x = 0; x < WORLD_GRID; x++) {
     for (y = 0; y < WORLD_GRID; y++) {
@@ -1151,23 +1523,24 @@ void TerraformFill ()
       if (r.climate != CLIMATE_INVALID)
         continue;
       sprintf (r.title, "???");
+      n = 0;
       r.geo_water = r.geo_scale * 10.0f;
       r.geo_detail = 20.0f;
       //Have them trend more hilly in dry areas
-      rand = RandomVal () % 8;
+      rand = region_random (RANDOM_FILL, r.grid_pos, &n) % 8;
       if (r.moisture > 0.3f && r.temperature > 0.5f) {
         GLrgba    c;
         int       shape;
         
-        r.has_flowers = RandomVal () % 4 == 0;
-        shape = RandomVal ();
-        c = flower_palette[RandomVal () % FLOWER_PALETTE];
+        r.has_flowers = region_random (RANDOM_FILL, r.grid_pos, &n) % 4 == 0;
+        shape = region_random (RANDOM_FILL, r.grid_pos, &n);
+        c = flower_palette[region_random (RANDOM_FILL, r.grid_pos, &n) % FLOWER_PALETTE];
         for (int i = 0; i < FLOWERS; i++) {
           r.color_flowers[i] = c;
           r.flower_shape[i] = shape;
-          if ((RandomVal () % 15) == 0) {
-            shape = RandomVal ();
-            c = flower_palette[RandomVal () % FLOWER_PALETTE];
+          if ((region_random (RANDOM_FILL, r.grid_pos, &n) % 15) == 0) {
+            shape = region_random (RANDOM_FILL, r.grid_pos, &n);
+            c = flower_palette[region_random (RANDOM_FILL, r.grid_pos, &n) % FLOWER_PALETTE];
           }
         }
       }      
@@ -1202,49 +1575,120 @@ void TerraformFill ()
 
 }
 
-void TerraformPrepare () 
+//Geo scale is a number from -1 to 1. -1 is lowest ocean. 0 is sea level. 
+//+1 is highest elevation on the island. This is used to guide other derived numbers.
+static float prepare_scale (int x, int y)
 {
 
-
-  int         x, y;
-  Region      r;
   GLcoord     from_center;
   GLcoord     offset;
+  float       scale;
+
+  offset = prepare_offset;
+  from_center.x = abs (x - WORLD_GRID_CENTER);
+  from_center.y = abs (y - WORLD_GRID_CENTER);
+  scale = glVectorLength (glVector ((float)from_center.x, (float)from_center.y));
+  scale /= (WORLD_GRID_CENTER - OCEAN_BUFFER);
+  //Create a steep drop around the edge of the world
+  if (scale > 1.0f)
+    scale = 1.0f + (scale - 1.0f) * 4.0f;
+  scale = 1.0f - scale;
+  scale += (Entropy ((x + offset.x), (y + offset.y)) - 0.5f);
+  scale += (Entropy ((x + offset.x) * FREQUENCY, (y + offset.y) * FREQUENCY) - 0.2f);
+  return clamp (scale, -1.0f, 1.0f);
+
+}
+
+static void prepare_begin ()
+{
+
+  prepare_offset.x = RandomAt (WorldPtr ()->seed, RANDOM_PREPARE, 0, 0, 0) % 1024;
+  prepare_offset.y = RandomAt (WorldPtr ()->seed, RANDOM_PREPARE, 0, 0, 1) % 1024;
+  //Make sure the entropy map is loaded before the threads start asking for it.
+  Entropy (0, 0);
+
+}
+
+static void prepare_column (int x)
+{
+
+  int         y;
+  Region      r;
+
+  for (y = 0; y < WORLD_GRID; y++) {
+    memset (&r, 0, sizeof (Region));
+    sprintf (r.title, "NOTHING");
+    r.geo_bias = r.geo_detail = 0;
+    r.mountain_height = 0;
+    r.grid_pos.x = x;
+    r.grid_pos.y = y;
+    r.tree_threshold = 0.15f;
+    r.geo_scale = prepare_scale (x, y);
+    if (r.geo_scale > 0.0f)
+      r.geo_water = 1.0f + r.geo_scale * 16.0f;
+    r.color_atmosphere = glRgba (0.0f, 0.0f, 0.0f);
+    r.geo_bias = 0.0f;
+    r.geo_detail = 0.0f;
+    r.color_map = glRgba (0.0f);
+    r.climate = CLIMATE_INVALID;
+    WorldRegionSet (x, y, r);
+  }
+
+}
+
+void TerraformPrepare () 
+{
 
   //Set some defaults
-  offset.x = RandomVal () % 1024;
-  offset.y = RandomVal () % 1024;
+  prepare_begin ();
+  for_each_column (prepare_column);
+
+}
+
+static void sketch_column (int x)
+{
+
+  World*      w;
+  int         y;
+  float       scale;
+
+  w = WorldPtr ();
+  for (y = 0; y < WORLD_GRID; y++) {
+    scale = prepare_scale (x, y);
+    w->info[x][y].geo_scale = scale;
+    w->info[x][y].mountain_height = 0;
+    if (is_ocean (x, y, scale))
+      w->climate[x][y] = CLIMATE_OCEAN;
+    else
+      w->climate[x][y] = CLIMATE_INVALID;
+  }
+
+}
+
+/*-----------------------------------------------------------------------------
+  A quick sketch of the world for previews.  This gives the same land, sea, 
+  coast, temperature and moisture as TerraformPrepare, TerraformOceans, 
+  TerraformCoast and TerraformClimate, but only fills in the planes those
+  are made from, and skips everything else those passes set up.  Nothing 
+  else in the world is valid afterwards.
+-----------------------------------------------------------------------------*/
+
+void TerraformSketch () 
+{
+
+  World*    w;
+  int       x, y;
+
+  w = WorldPtr ();
+  prepare_begin ();
+  for_each_column (sketch_column);
+  shore_build ();
   for (x = 0; x < WORLD_GRID; x++) {
     for (y = 0; y < WORLD_GRID; y++) {
-      memset (&r, 0, sizeof (Region));
-      sprintf (r.title, "NOTHING");
-      r.geo_bias = r.geo_detail = 0;
-      r.mountain_height = 0;
-      r.grid_pos.x = x;
-      r.grid_pos.y = y;
-      r.tree_threshold = 0.15f;
-      from_center.x = abs (x - WORLD_GRID_CENTER);
-      from_center.y = abs (y - WORLD_GRID_CENTER);
-      //Geo scale is a number from -1 to 1. -1 is lowest ocean. 0 is sea level. 
-      //+1 is highest elevation on the island. This is used to guide other derived numbers.
-      r.geo_scale = glVectorLength (glVector ((float)from_center.x, (float)from_center.y));
-      r.geo_scale /= (WORLD_GRID_CENTER - OCEAN_BUFFER);
-      //Create a steep drop around the edge of the world
-      if (r.geo_scale > 1.0f)
-        r.geo_scale = 1.0f + (r.geo_scale - 1.0f) * 4.0f;
-      r.geo_scale = 1.0f - r.geo_scale;
-      r.geo_scale += (Entropy ((x + offset.x), (y + offset.y)) - 0.5f);
-      r.geo_scale += (Entropy ((x + offset.x) * FREQUENCY, (y + offset.y) * FREQUENCY) - 0.2f);
-      r.geo_scale = clamp (r.geo_scale, -1.0f, 1.0f);
-      if (r.geo_scale > 0.0f)
-        r.geo_water = 1.0f + r.geo_scale * 16.0f;
-      r.color_atmosphere = glRgba (0.0f, 0.0f, 0.0f);
-      r.geo_bias = 0.0f;
-      r.geo_detail = 0.0f;
-      r.color_map = glRgba (0.0f);
-      r.climate = CLIMATE_INVALID;
-      WorldRegionSet (x, y, r);
+      if (coast_band (x, y))
+        w->climate[x][y] = CLIMATE_COAST;
     }
   }
+  TerraformClimate ();
 
-}
\ No newline at end of file
+}
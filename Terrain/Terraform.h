@@ -9,4 +9,5 @@ void    TerraformLakes (int count);
 void    TerraformOceans ();
 void    TerraformPrepare ();
 void    TerraformRivers (int count);
+void    TerraformSketch ();
 void    TerraformZones ();
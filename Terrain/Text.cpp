@@ -76,7 +76,7 @@ static void text_draw (char* text)
 
 -----------------------------------------------------------------------------*/
 
-char* TextBytes (int bytes)
+char* TextBytes (unsigned long long bytes)
 {
 
   current_scratch++;
@@ -86,7 +86,7 @@ char* TextBytes (int bytes)
   else if (bytes > KILOBYTE) 
     sprintf (scratch[current_scratch].buffer, "%1.1fKb", (float)bytes / KILOBYTE);
   else
-    sprintf (scratch[current_scratch].buffer, "%d Bytes", bytes);
+    sprintf (scratch[current_scratch].buffer, "%u Bytes", (unsigned)bytes);
   return scratch[current_scratch].buffer;
   
 }
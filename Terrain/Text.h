@@ -1,5 +1,5 @@
 void  TextInit ();
 void  TextRender ();
 void  TextPrint (const char *fmt, ...);
-char* TextBytes (int bytes);
+char* TextBytes (unsigned long long bytes);
 void  TextCreate (int width, int height);
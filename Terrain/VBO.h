@@ -1,6 +1,18 @@
 #ifndef HVBO
 #define HVBO
 
+//Where the mesh builders send a finished mesh.  The game's VBO.cpp loads it
+//into a GL vertex buffer.  The core library's Headless.cpp only keeps the
+//counts, so terrain, grass, and brush can be built with no GL context.
+
+//The core has no gl.h, so name the two primitives the builders use.  These
+//are GL's own values.
+#ifndef GL_TRIANGLES
+#define GL_TRIANGLES    0x0004
+#endif
+#ifndef GL_QUADS
+#define GL_QUADS        0x0007
+#endif
 
 class VBO
 {
@@ -27,4 +39,4 @@ public:
   void      Render ();
   bool      Ready () { return _ready; };
 };
-#endif
\ No newline at end of file
+#endif
@@ -14,26 +14,43 @@
 
   This also holds tables of random numbers.  Basically, everything needed to
   re-create the world should be stored here.
+
+  Regions aren't stored whole.  The values the terrain generator reads for 
+  every cell live in their own planes, colors are packed down to bytes, and
+  titles are kept once each in a table.  WorldRegionGet and WorldRegionSet
+  put regions together and take them apart for everyone else.
  
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
-#include "ctree.h"
-#include "console.h"
-#include "entropy.h"
-#include "file.h"
-#include "game.h"
-#include "math.h"
-#include "random.h"
-#include "terraform.h"
-#include "world.h"
+#include "Core.h"
+#include <map>
+#include <string>
+#include "CTree.h"
+#include "Console.h"
+#include "Entropy.h"
+#include "File.h"
+#include "Math.h"
+#include "Platform.h"
+#include "Random.h"
+#include "Terraform.h"
+#include "World.h"
 
 //The dither map scatters surface data so that grass colorings end up in adjacent regions.
 #define DITHER_SIZE       (REGION_SIZE / 2)
 //How much space in a region is spent interpolating between itself and its neighbors.
 #define BLEND_DISTANCE    (REGION_SIZE / 4)
 
-#define FILE_VERSION      1
+#define FILE_VERSION      3
+//Bump this whenever a change to the generator would change its output.
+//Anything cached from an older generator will be thrown away.
+#define GENERATOR_VERSION 6
+//Groups of flags that do_height gets its own copies for. HEIGHT_SWAMP 
+//isn't a region flag, it stands for the swamp climate.
+#define HEIGHT_SWAMP      0x80000000
+#define HEIGHT_BEACHES    (REGION_FLAG_BEACH | REGION_FLAG_BEACH_CLIFF)
+#define HEIGHT_ALL        (REGION_FLAG_MESAS | REGION_FLAG_CRATER | HEIGHT_BEACHES | \
+                          REGION_FLAG_SINKHOLE | REGION_FLAG_CRACK | REGION_FLAG_TIERED | \
+                          REGION_FLAG_CANYON_NS | REGION_FLAG_RIVER_ANY | HEIGHT_SWAMP)
 
 struct WHeader
 {
@@ -45,11 +62,166 @@ struct WHeader
   int         map_bytes;
 };
 
+//Groups of planes in World, for saving the output of generation stages.
+#define PLANE_SHAPE       0x01
+#define PLANE_CLIMATE     0x02
+#define PLANE_COLORS      0x04
+#define PLANE_SHORE       0x08
+#define PLANE_INFO        0x10
+#define PLANE_ALL         0x1f
+
+struct Plane
+{
+  unsigned    group;
+  void*       data;
+  int         bytes;
+};
+
+//One step of generating the world.  Bump the version whenever the code for
+//a stage changes, and its saved output (and everything after it) will be 
+//thrown away.
+struct Stage
+{
+  const char* name;
+  void        (*run) ();
+  unsigned    version;
+  unsigned    output;     //Which PLANE_* groups it changes
+};
+
+struct SHeader
+{
+  unsigned    key;
+  unsigned    output;
+  int         bytes;
+};
+
+typedef float (*HeightKernel) (GLcoord r, GLvector2 offset, float water, float detail, float bias);
+
 static GLcoord      dithermap[DITHER_SIZE][DITHER_SIZE];
-static unsigned     map_id;
 static World        planet;//THE WHOLE THING!
 static CTree        tree[TREE_TYPES][TREE_TYPES];
 static unsigned     canopy;
+static map<string, unsigned>  title_index;
+static PlatformMutex* title_lock;
+
+static Plane        planes[] = 
+{
+  { PLANE_SHAPE,    planet.flags_shape,     sizeof (planet.flags_shape) },
+  { PLANE_SHAPE,    planet.geo_water,       sizeof (planet.geo_water) },
+  { PLANE_SHAPE,    planet.geo_bias,        sizeof (planet.geo_bias) },
+  { PLANE_SHAPE,    planet.geo_detail,      sizeof (planet.geo_detail) },
+  { PLANE_SHAPE,    planet.cliff_threshold, sizeof (planet.cliff_threshold) },
+  { PLANE_SHAPE,    planet.river_width,     sizeof (planet.river_width) },
+  { PLANE_SHAPE,    planet.climate,         sizeof (planet.climate) },
+  { PLANE_CLIMATE,  planet.temperature,     sizeof (planet.temperature) },
+  { PLANE_CLIMATE,  planet.moisture,        sizeof (planet.moisture) },
+  { PLANE_COLORS,   planet.color_rock,      sizeof (planet.color_rock) },
+  { PLANE_COLORS,   planet.color_dirt,      sizeof (planet.color_dirt) },
+  { PLANE_COLORS,   planet.color_grass,     sizeof (planet.color_grass) },
+  { PLANE_SHORE,    planet.shore_distance,  sizeof (planet.shore_distance) },
+  { PLANE_SHORE,    planet.shore_direction, sizeof (planet.shore_direction) },
+  { PLANE_INFO,     planet.info,            sizeof (planet.info) },
+  { PLANE_INFO,     &planet.title_count,    sizeof (planet.title_count) },
+  { PLANE_INFO,     planet.titles,          sizeof (planet.titles) },
+};
+
+#define PLANES            (sizeof (planes) / sizeof (Plane))
+
+/*-----------------------------------------------------------------------------
+Packing region data for storage.
+-----------------------------------------------------------------------------*/
+
+//Clamped here rather than with GLrgba::Clamp, since every region set packs
+//eight colors and the call adds up.
+inline unsigned color_channel (float c)
+{
+
+  return (unsigned)(clamp (c, 0.0f, 1.0f) * 255.0f + 0.5f);
+
+}
+
+static unsigned color_pack (GLrgba c)
+{
+
+  return color_channel (c.red) | 
+    (color_channel (c.green) << 8) |
+    (color_channel (c.blue) << 16) |
+    (color_channel (c.alpha) << 24);
+
+}
+
+static GLrgba color_unpack (unsigned c)
+{
+
+  GLrgba    result;
+
+  result.red = (float)(c & 0xff) / 255.0f;
+  result.green = (float)((c >> 8) & 0xff) / 255.0f;
+  result.blue = (float)((c >> 16) & 0xff) / 255.0f;
+  result.alpha = (float)(c >> 24) / 255.0f;
+  return result;
+
+}
+
+//Empty the title table. Title zero is always the empty string.
+static void title_clear ()
+{
+
+  title_index.clear ();
+  planet.title_count = 1;
+  planet.titles[0][0] = 0;
+  title_index[""] = 0;
+
+}
+
+//Rebuild the lookup for titles after the table has been read from disk.
+static void title_rebuild ()
+{
+
+  unsigned    i;
+
+  title_index.clear ();
+  for (i = 0; i < planet.title_count; i++)
+    title_index[planet.titles[i]] = i;
+
+}
+
+//Point id at the given title, adding it to the table if it's new.  Most 
+//passes leave the title alone, so don't look it up unless it changed.  A new 
+//world empties the table, so an index past the end is left over from the 
+//last one, and its slot may be handed out again.  Terraform passes can run 
+//on several threads at once, and another one may be adding to the table, so
+//even the check is locked.
+static void title_set (unsigned* id, const char* title)
+{
+
+  map<string, unsigned>::iterator   i;
+
+  PlatformMutexLock (title_lock);
+  if (*id >= planet.title_count || strcmp (title, planet.titles[*id])) {
+    i = title_index.find (title);
+    if (i != title_index.end ()) {
+      *id = i->second;
+    } else if (planet.title_count >= WORLD_TITLES) {
+      *id = 0;
+    } else {
+      *id = planet.title_count++;
+      strncpy (planet.titles[*id], title, TITLE_LENGTH - 1);
+      planet.titles[*id][TITLE_LENGTH - 1] = 0;
+      title_index[title] = *id;
+    }
+  }
+  PlatformMutexUnlock (title_lock);
+
+}
+
+//The regions past the far edges don't exist, so use the ones on the edge.
+static int edge (int index)
+{
+
+  return min (index, WORLD_GRID - 1);
+
+}
 
 /*-----------------------------------------------------------------------------
 The following functions are used when generating elevation data
@@ -57,20 +229,25 @@ The following functions are used when generating elevation data
 
 //This modifies the passed elevation value AFTER region cross-fading is complete,
 //For things that should not be mimicked by neighbors. (Like rivers.)
-static float do_height_noblend (float val, Region r, GLvector2 offset, float water)
+static float do_height_noblend (float val, GLcoord r, GLvector2 offset, float water)
 {
 
+  unsigned    flags;
+  float       river_width;
+
+  flags = planet.flags_shape[r.x][r.y];
+  river_width = planet.river_width[r.x][r.y];
   //return val;
-  if (r.flags_shape & REGION_FLAG_RIVER_ANY) {
+  if (flags & REGION_FLAG_RIVER_ANY) {
     GLvector2   cen;
     float       strength;
     float       delta;
     GLvector2   new_off;
 
     //if this river is strictly north / south
-    if (r.flags_shape & REGION_FLAG_RIVERNS && !(r.flags_shape & REGION_FLAG_RIVEREW)) {
+    if (flags & REGION_FLAG_RIVERNS && !(flags & REGION_FLAG_RIVEREW)) {
       //This makes the river bend side-to-side
-      switch ((r.grid_pos.x + r.grid_pos.y) % 6) {
+      switch ((r.x + r.y) % 6) {
       case 0:
         offset.x += abs (sin (offset.y * 180.0f * DEGREES_TO_RADIANS)) * 0.25f;break;
       case 1:
@@ -86,9 +263,9 @@ static float do_height_noblend (float val, Region r, GLvector2 offset, float wat
       }
     }
     //if this river is strictly east / west
-    if (r.flags_shape & REGION_FLAG_RIVEREW && !(r.flags_shape & REGION_FLAG_RIVERNS)) {
+    if (flags & REGION_FLAG_RIVEREW && !(flags & REGION_FLAG_RIVERNS)) {
       //This makes the river bend side-to-side
-      switch ((r.grid_pos.x + r.grid_pos.y) % 4) {
+      switch ((r.x + r.y) % 4) {
       case 0:
         offset.y -= abs (sin (offset.x * 180.0f * DEGREES_TO_RADIANS)) * 0.25f;break;
       case 1:
@@ -100,21 +277,21 @@ static float do_height_noblend (float val, Region r, GLvector2 offset, float wat
       }
     }
     //if this river curves around a bend
-    if (r.flags_shape & REGION_FLAG_RIVERNW && !(r.flags_shape & REGION_FLAG_RIVERSE)) 
+    if (flags & REGION_FLAG_RIVERNW && !(flags & REGION_FLAG_RIVERSE)) 
       offset.x = offset.y = offset.Length ();
-    if (r.flags_shape & REGION_FLAG_RIVERSE && !(r.flags_shape & REGION_FLAG_RIVERNW)) {
+    if (flags & REGION_FLAG_RIVERSE && !(flags & REGION_FLAG_RIVERNW)) {
       new_off.x = 1.0f - offset.x;
       new_off.y = 1.0f - offset.y;
       new_off.x = new_off.y = new_off.Length ();
       offset = new_off;
     }    
-    if (r.flags_shape & REGION_FLAG_RIVERNE && !(r.flags_shape & REGION_FLAG_RIVERSW)) {
+    if (flags & REGION_FLAG_RIVERNE && !(flags & REGION_FLAG_RIVERSW)) {
       new_off.x = 1.0f - offset.x;
       new_off.y = offset.y;
       new_off.x = new_off.y = new_off.Length ();
       offset = new_off;
     }    
-    if (r.flags_shape & REGION_FLAG_RIVERSW && !(r.flags_shape & REGION_FLAG_RIVERNE)) {
+    if (flags & REGION_FLAG_RIVERSW && !(flags & REGION_FLAG_RIVERNE)) {
       new_off.x = offset.x;
       new_off.y = 1.0f - offset.y;
       new_off.x = new_off.y = new_off.Length ();
@@ -123,17 +300,17 @@ static float do_height_noblend (float val, Region r, GLvector2 offset, float wat
     cen.x = abs ((offset.x - 0.5f) * 2.0f);
     cen.y = abs ((offset.y - 0.5f) * 2.0f);
     strength = glVectorLength (cen);
-    if (r.flags_shape & REGION_FLAG_RIVERN && offset.y < 0.5f)
+    if (flags & REGION_FLAG_RIVERN && offset.y < 0.5f)
       strength = min (strength, cen.x);
-    if (r.flags_shape & REGION_FLAG_RIVERS && offset.y >= 0.5f)
+    if (flags & REGION_FLAG_RIVERS && offset.y >= 0.5f)
       strength = min (strength, cen.x);
-    if (r.flags_shape & REGION_FLAG_RIVERW && offset.x < 0.5f) 
+    if (flags & REGION_FLAG_RIVERW && offset.x < 0.5f) 
       strength = min (strength, cen.y);
-    if (r.flags_shape & REGION_FLAG_RIVERE && offset.x >= 0.5f) 
+    if (flags & REGION_FLAG_RIVERE && offset.x >= 0.5f) 
       strength = min (strength, cen.y);
-    if (strength < (r.river_width / 2)) {
-      strength *= 1.0f / (r.river_width / 2);
-      delta = (val - water) + 4.0f * r.river_width;
+    if (strength < (river_width / 2)) {
+      strength *= 1.0f / (river_width / 2);
+      delta = (val - water) + 4.0f * river_width;
       val -= (delta) * (1.0f - strength);
     }
   }
@@ -145,28 +322,38 @@ static float do_height_noblend (float val, Region r, GLvector2 offset, float wat
 //according to the local region rules.
 // Water is the water level.  Detail is the height of the rolling hills. Bias
 //is a direct height added on to these.
-static float do_height (Region r, GLvector2 offset, float water, float detail, float bias)
+//KERNEL is the set of flags this copy knows how to handle.  The region's flags
+//are masked down to it, so the compiler throws away every test that can't
+//pass.  With no flags at all, this is just the line marked "Apply the values".
+template <unsigned KERNEL>
+static float do_height (GLcoord r, GLvector2 offset, float water, float detail, float bias)
 {
 
   float     val;
+  unsigned  flags;
+  float     geo_detail;
+  float     cliff;
 
+  flags = planet.flags_shape[r.x][r.y] & KERNEL;
+  geo_detail = planet.geo_detail[r.x][r.y];
+  cliff = planet.cliff_threshold[r.x][r.y];
   //Modify the detail values before they are applied
-  if (r.flags_shape & REGION_FLAG_CRATER) {
+  if (flags & REGION_FLAG_CRATER) {
     if (detail > 0.5f)
       detail = 0.5f;
   }
-  if (r.flags_shape & REGION_FLAG_TIERED) {
+  if (flags & REGION_FLAG_TIERED) {
     if (detail < 0.2f)
       detail += 0.2f;
     else
     if (detail < 0.5f)
       detail -= 0.2f;
   }
-  if (r.flags_shape & REGION_FLAG_CRACK) {
+  if (flags & REGION_FLAG_CRACK) {
     if (detail > 0.2f && detail < 0.3f)
       detail = 0.0f;
   }
-  if (r.flags_shape & REGION_FLAG_SINKHOLE) {
+  if (flags & REGION_FLAG_SINKHOLE) {
     float    x = abs (offset.x - 0.5f);
     float    y = abs (offset.y - 0.5f);
     if (detail > max (x, y))
@@ -174,7 +361,7 @@ static float do_height (Region r, GLvector2 offset, float water, float detail, f
   }
   
   //Soften up the banks of a river 
-  if (r.flags_shape & REGION_FLAG_RIVER_ANY) {
+  if (flags & REGION_FLAG_RIVER_ANY) {
     GLvector2   cen;
     float       strength;
 
@@ -189,32 +376,32 @@ static float do_height (Region r, GLvector2 offset, float water, float detail, f
 
 
   //Apply the values!
-  val = water + detail * r.geo_detail + bias;
-  if (r.climate == CLIMATE_SWAMP) {
-    val -= r.geo_detail / 2.0f;
-    val = max (val, r.geo_water - 0.5f);
+  val = water + detail * geo_detail + bias;
+  if ((KERNEL & HEIGHT_SWAMP) && planet.climate[r.x][r.y] == CLIMATE_SWAMP) {
+    val -= geo_detail / 2.0f;
+    val = max (val, planet.geo_water[r.x][r.y] - 0.5f);
   }
   //Modify the final value.
-  if (r.flags_shape & REGION_FLAG_MESAS) {
+  if (flags & REGION_FLAG_MESAS) {
     float    x = abs (offset.x - 0.5f) / 5;
     float    y = abs (offset.y - 0.5f) / 5;
     if ((detail + 0.01f) < (x + y)) {
       val += 5;
     }
   }
-  if (r.flags_shape & REGION_FLAG_CANYON_NS) {
+  if (flags & REGION_FLAG_CANYON_NS) {
     float    x = abs (offset.x - 0.5f) * 2.0f;;
     if (x + detail < 0.5f)
-      val -= min (r.geo_detail, 10.0f);
+      val -= min (geo_detail, 10.0f);
   }
-  if ((r.flags_shape & REGION_FLAG_BEACH) && val < r.cliff_threshold && val > 0.0f) {
-    val /= r.cliff_threshold;
+  if ((flags & REGION_FLAG_BEACH) && val < cliff && val > 0.0f) {
+    val /= cliff;
     val *= val;
-    val *= r.cliff_threshold;
+    val *= cliff;
     val += 0.2f;
   }
-  if ((r.flags_shape & REGION_FLAG_BEACH_CLIFF) && val < r.cliff_threshold && val > -0.1f) {
-    val -= min (r.cliff_threshold, 10.0f);
+  if ((flags & REGION_FLAG_BEACH_CLIFF) && val < cliff && val > -0.1f) {
+    val -= min (cliff, 10.0f);
   }
   //if a point dips below the water table, make sure it's not too close to the water,
   //to avoid ugly z-fighting
@@ -224,7 +411,30 @@ static float do_height (Region r, GLvector2 offset, float water, float detail, f
 
 }
 
-static void build_trees ()
+//Pick the smallest copy of do_height that covers everything this region does.
+//Flags are constant for a region, so this only needs doing when a span of 
+//cells crosses into a new one.
+static HeightKernel height_kernel (GLcoord r)
+{
+
+  unsigned    flags;
+
+  if (planet.climate[r.x][r.y] == CLIMATE_SWAMP)
+    return do_height<HEIGHT_ALL>;
+  flags = planet.flags_shape[r.x][r.y] & HEIGHT_ALL;
+  if (!flags)
+    return do_height<0>;
+  if (!(flags & ~REGION_FLAG_RIVER_ANY))
+    return do_height<REGION_FLAG_RIVER_ANY>;
+  if (!(flags & ~HEIGHT_BEACHES))
+    return do_height<HEIGHT_BEACHES>;
+  return do_height<HEIGHT_ALL>;
+
+}
+
+//Without geometry, the trees are only planned: enough for the pages, but 
+//nothing that needs a GL context.
+static void build_trees (bool geometry)
 {
 
   unsigned    m, t;
@@ -239,44 +449,15 @@ static void build_trees ()
         canopy = m + t * TREE_TYPES;
       } else
         is_canopy = false;
-      tree[m][t].Create (is_canopy, (float)m / TREE_TYPES, (float)t / TREE_TYPES, rotator++);
+      if (geometry)
+        tree[m][t].Create (is_canopy, (float)m / TREE_TYPES, (float)t / TREE_TYPES, rotator++);
+      else
+        tree[m][t].Plan (is_canopy, (float)m / TREE_TYPES, (float)t / TREE_TYPES, rotator++);
     }
   }
 
 }
 
-static void build_map_texture ()
-{
-
-  int       x, y, yy;
-  Region    r;
-
-  if (!map_id) 
-    glGenTextures (1, &map_id); 
-  glBindTexture(GL_TEXTURE_2D, map_id);
-	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);	
-  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);	
-  unsigned char* buffer; 
-  unsigned char*  ptr;
-
-  buffer = new unsigned char[WORLD_GRID * WORLD_GRID * 3];
-
-  for (x = 0; x < WORLD_GRID; x++) {
-    for (y = 0; y < WORLD_GRID; y++) {
-      //Flip it vertically, because the OpenGL texture coord system is retarded.
-      yy = (WORLD_GRID - 1) - y;
-      r = planet.map[x][yy];
-      ptr = &buffer[(x + y * WORLD_GRID) * 3];
-      ptr[0] = (unsigned char)(r.color_map.red * 255.0f);
-      ptr[1] = (unsigned char)(r.color_map.green * 255.0f);
-      ptr[2] = (unsigned char)(r.color_map.blue * 255.0f);
-    }
-  }
-  glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, WORLD_GRID, WORLD_GRID, 0, GL_RGB, GL_UNSIGNED_BYTE, &buffer[0]);
-  delete buffer;
-
-}
-
 /*-----------------------------------------------------------------------------
 
 -----------------------------------------------------------------------------*/
@@ -286,7 +467,6 @@ float WorldWaterLevel (int world_x, int world_y)
 
   GLcoord   origin;
   GLvector2 offset;
-  Region    rul, rur, rbl, rbr;//Four corners: upper left, upper right, etc.
 
   world_x += REGION_HALF;
   world_y += REGION_HALF;
@@ -296,11 +476,12 @@ float WorldWaterLevel (int world_x, int world_y)
   origin.y = clamp (origin.y, 0, WORLD_GRID - 1);
   offset.x = (float)((world_x) % REGION_SIZE) / REGION_SIZE;
   offset.y = (float)((world_y) % REGION_SIZE) / REGION_SIZE;
-  rul = WorldRegionGet (origin.x, origin.y);
-  rur = WorldRegionGet (origin.x + 1, origin.y);
-  rbl = WorldRegionGet (origin.x, origin.y + 1);
-  rbr = WorldRegionGet (origin.x + 1, origin.y + 1);
-  return MathInterpolateQuad (rul.geo_water, rur.geo_water, rbl.geo_water, rbr.geo_water, offset, ((origin.x + origin.y) %2) == 0);
+  //Four corners: upper left, upper right, etc.
+  return MathInterpolateQuad (planet.geo_water[origin.x][origin.y], 
+    planet.geo_water[edge (origin.x + 1)][origin.y], 
+    planet.geo_water[origin.x][edge (origin.y + 1)], 
+    planet.geo_water[edge (origin.x + 1)][edge (origin.y + 1)], 
+    offset, ((origin.x + origin.y) %2) == 0);
 
 }
 
@@ -309,7 +490,6 @@ float WorldBiasLevel (int world_x, int world_y)
 
   GLcoord   origin;
   GLvector2 offset;
-  Region    rul, rur, rbl, rbr;//Four corners: upper left, upper right, etc.
 
   world_x += REGION_HALF;
   world_y += REGION_HALF;
@@ -319,67 +499,123 @@ float WorldBiasLevel (int world_x, int world_y)
   origin.y = clamp (origin.y, 0, WORLD_GRID - 1);
   offset.x = (float)((world_x) % REGION_SIZE) / REGION_SIZE;
   offset.y = (float)((world_y) % REGION_SIZE) / REGION_SIZE;
-  rul = WorldRegionGet (origin.x, origin.y);
-  rur = WorldRegionGet (origin.x + 1, origin.y);
-  rbl = WorldRegionGet (origin.x, origin.y + 1);
-  rbr = WorldRegionGet (origin.x + 1, origin.y + 1);
-  return MathInterpolateQuad (rul.geo_bias, rur.geo_bias, rbl.geo_bias, rbr.geo_bias, offset, ((origin.x + origin.y) %2) == 0);
+  return MathInterpolateQuad (planet.geo_bias[origin.x][origin.y], 
+    planet.geo_bias[edge (origin.x + 1)][origin.y], 
+    planet.geo_bias[origin.x][edge (origin.y + 1)], 
+    planet.geo_bias[edge (origin.x + 1)][edge (origin.y + 1)], 
+    offset, ((origin.x + origin.y) %2) == 0);
+
+}
+
+/*-----------------------------------------------------------------------------
+  Evaluate count cells, starting at world_x, world_y and running along y.  
+  This gives the same results as calling WorldCell for each one, but the 
+  regions only get looked up when the span crosses into new ones, and only
+  the elevation planes are touched.
+-----------------------------------------------------------------------------*/
+
+void WorldCells (int world_x, int world_y, int count, Cell* out)
+{
+
+  GLcoord       rul, rur, rbl, rbr; //Four corners: upper left, upper right, etc.
+  HeightKernel  hul, hur, hbl, hbr;
+  bool          river;
+  float         water_corner[4];
+  float         bias_corner[4];
+  float         eul, eur, ebl, ebr;
+  float         detail, bias, water;
+  GLvector2     offset;
+  GLvector2     level_offset;
+  GLvector2     blend;
+  GLcoord       origin, last_origin;
+  GLcoord       level, last_level;
+  GLcoord       ul, br, last_br;
+  bool          left, level_left;
+  int           i, y;
+
+  last_level.x = last_origin.x = last_br.x = -1;
+  last_level.y = last_origin.y = last_br.y = -1;
+  //The first cell always fills these in, since nothing matches the last ones.
+  memset (water_corner, 0, sizeof (water_corner));
+  memset (bias_corner, 0, sizeof (bias_corner));
+  hul = hur = hbl = hbr = NULL;
+  river = false;
+  for (i = 0; i < count; i++) {
+    y = world_y + i;
+    //Water and bias are blended between region centers, so their corners are 
+    //offset by half a region from the ones used for elevation.
+    level.x = clamp ((world_x + REGION_HALF) / REGION_SIZE, 0, WORLD_GRID - 1);
+    level.y = clamp ((y + REGION_HALF) / REGION_SIZE, 0, WORLD_GRID - 1);
+    if (level != last_level) {
+      last_level = level;
+      water_corner[0] = planet.geo_water[level.x][level.y];
+      water_corner[1] = planet.geo_water[edge (level.x + 1)][level.y];
+      water_corner[2] = planet.geo_water[level.x][edge (level.y + 1)];
+      water_corner[3] = planet.geo_water[edge (level.x + 1)][edge (level.y + 1)];
+      bias_corner[0] = planet.geo_bias[level.x][level.y];
+      bias_corner[1] = planet.geo_bias[edge (level.x + 1)][level.y];
+      bias_corner[2] = planet.geo_bias[level.x][edge (level.y + 1)];
+      bias_corner[3] = planet.geo_bias[edge (level.x + 1)][edge (level.y + 1)];
+    }
+    level_offset.x = (float)((world_x + REGION_HALF) % REGION_SIZE) / REGION_SIZE;
+    level_offset.y = (float)((y + REGION_HALF) % REGION_SIZE) / REGION_SIZE;
+    level_left = ((level.x + level.y) %2) == 0;
+    water = MathInterpolateQuad (water_corner[0], water_corner[1], water_corner[2], water_corner[3], level_offset, level_left);
+    bias = MathInterpolateQuad (bias_corner[0], bias_corner[1], bias_corner[2], bias_corner[3], level_offset, level_left);
+    detail = Entropy (world_x, y);
+    origin.x = world_x / REGION_SIZE;
+    origin.y = y / REGION_SIZE;
+    origin.x = clamp (origin.x, 0, WORLD_GRID - 1);
+    origin.y = clamp (origin.y, 0, WORLD_GRID - 1);
+    //Get our offset from the region origin as a pair of scalars.
+    blend.x = (float)(world_x % BLEND_DISTANCE) / BLEND_DISTANCE;
+    blend.y = (float)(y % BLEND_DISTANCE) / BLEND_DISTANCE;
+    left = ((origin.x + origin.y) %2) == 0;
+    offset.x = (float)((world_x) % REGION_SIZE) / REGION_SIZE;
+    offset.y = (float)((y) % REGION_SIZE) / REGION_SIZE;
+    out[i].detail = detail;
+    out[i].water_level = water;
+    ul = origin;
+    br.x = edge ((world_x + BLEND_DISTANCE) / REGION_SIZE);
+    br.y = edge ((y + BLEND_DISTANCE) / REGION_SIZE);
+    if (ul != last_origin || br != last_br) {
+      last_origin = ul;
+      last_br = br;
+      rul = ul;
+      rur.x = br.x;
+      rur.y = ul.y;
+      rbl.x = ul.x;
+      rbl.y = br.y;
+      rbr = br;
+      hul = height_kernel (rul);
+      hur = height_kernel (rur);
+      hbl = height_kernel (rbl);
+      hbr = height_kernel (rbr);
+      river = (planet.flags_shape[ul.x][ul.y] & REGION_FLAG_RIVER_ANY) != 0;
+    }
+    if (ul == br) {
+      out[i].elevation = hul (rul, offset, water, detail, bias);
+      if (river)
+        out[i].elevation = do_height_noblend (out[i].elevation, rul, offset, water);
+      continue;
+    }
+    eul = hul (rul, offset, water, detail, bias);
+    eur = hur (rur, offset, water, detail, bias);
+    ebl = hbl (rbl, offset, water, detail, bias);
+    ebr = hbr (rbr, offset, water, detail, bias);
+    out[i].elevation = MathInterpolateQuad (eul, eur, ebl,ebr, blend, left);
+    if (river)
+      out[i].elevation = do_height_noblend (out[i].elevation, rul, offset, water);
+  }
 
 }
 
 Cell WorldCell (int world_x, int world_y)
 {
 
-  float     detail;
-  float     bias;
-  Region    rul, rur, rbl, rbr;//Four corners: upper left, upper right, etc.
-  float     eul, eur, ebl, ebr;
-  float     water;
-  GLvector2 offset;
-  GLcoord   origin;
-  GLcoord   ul, br; //Upper left and bottom-right corners
-  GLvector2 blend;
-  bool      left;
   Cell      result;
 
-  detail = Entropy (world_x, world_y);
-  bias = WorldBiasLevel (world_x, world_y);
-  water = WorldWaterLevel (world_x, world_y);
-  origin.x = world_x / REGION_SIZE;
-  origin.y = world_y / REGION_SIZE;
-  origin.x = clamp (origin.x, 0, WORLD_GRID - 1);
-  origin.y = clamp (origin.y, 0, WORLD_GRID - 1);
-  //Get our offset from the region origin as a pair of scalars.
-  blend.x = (float)(world_x % BLEND_DISTANCE) / BLEND_DISTANCE;
-  blend.y = (float)(world_y % BLEND_DISTANCE) / BLEND_DISTANCE;
-  left = ((origin.x + origin.y) %2) == 0;
-  offset.x = (float)((world_x) % REGION_SIZE) / REGION_SIZE;
-  offset.y = (float)((world_y) % REGION_SIZE) / REGION_SIZE;
-  result.detail = detail;
-  result.water_level = water;
-
-  ul.x = origin.x;
-  ul.y = origin.y;
-  br.x = (world_x + BLEND_DISTANCE) / REGION_SIZE;
-  br.y = (world_y + BLEND_DISTANCE) / REGION_SIZE;
-
-  if (ul == br) {
-    rul = WorldRegionGet (ul.x, ul.y);
-    result.elevation = do_height (rul, offset, water, detail, bias);
-    result.elevation = do_height_noblend (result.elevation, rul, offset, water);
-    return result;
-  }
-  rul = WorldRegionGet (ul.x, ul.y);
-  rur = WorldRegionGet (br.x, ul.y);
-  rbl = WorldRegionGet (ul.x, br.y);
-  rbr = WorldRegionGet (br.x, br.y);
-
-  eul = do_height (rul, offset, water, detail, bias);
-  eur = do_height (rur, offset, water, detail, bias);
-  ebl = do_height (rbl, offset, water, detail, bias);
-  ebr = do_height (rbr, offset, water, detail, bias);
-  result.elevation = MathInterpolateQuad (eul, eur, ebl,ebr, blend, left);
-  result.elevation = do_height_noblend (result.elevation, rul, offset, water);
+  WorldCells (world_x, world_y, 1, &result);
   return result;
 
 }
@@ -408,7 +644,7 @@ CTree* WorldTree (unsigned id)
 
 }
 
-char* WorldLocationName (int world_x, int world_y)
+const char* WorldLocationName (int world_x, int world_y)
 {
 
   static char   result[20];
@@ -443,6 +679,7 @@ void    WorldInit ()
 
   int         x, y;
 
+  title_lock = PlatformMutexCreate ();
   //Fill in the dither table - a table of random offsets
   for (y = 0; y < DITHER_SIZE; y++) {
     for (x = 0; x < DITHER_SIZE; x++) {
@@ -477,7 +714,7 @@ void WorldSave ()
   WHeader   header;
 
   return;
-  sprintf (filename, "%sworld.sav", GameDirectory ());
+  sprintf (filename, "%sworld.sav", WorldDirectory ());
   if (!(f = fopen (filename, "wb"))) {
     ConsoleLog ("WorldSave: Could not open file %s", filename);
     return;
@@ -503,82 +740,459 @@ void WorldLoad (unsigned seed_in)
   char      filename[256];
   WHeader   header;
 
-
-  sprintf (filename, "%sworld.sav", GameDirectory ());
+  //The directory comes from the seed, so set it before we have the rest.
+  planet.seed = seed_in;
+  sprintf (filename, "%sworld.sav", WorldDirectory ());
   if (!(f = fopen (filename, "rb"))) {
     ConsoleLog ("WorldLoad: Could not open file %s", filename);
     WorldGenerate (seed_in);
     return;
   }
   fread (&header, sizeof (header), 1, f);
+  if (header.version != FILE_VERSION || header.map_bytes != sizeof (planet) || header.world_grid != WORLD_GRID) {
+    fclose (f);
+    ConsoleLog ("WorldLoad: '%s' is out of date.", filename);
+    WorldGenerate (seed_in);
+    return;
+  }
   fread (&planet, sizeof (planet), 1, f);
   fclose (f);
   ConsoleLog ("WorldLoad: '%s' loaded.", filename);
-  build_trees ();
-  build_map_texture ();
+  //The lookup for titles isn't saved, so rebuild it from the table.
+  title_rebuild ();
+  build_trees (true);
 
 }
 
-void    WorldGenerate (unsigned seed_in)
+/*-----------------------------------------------------------------------------
+Generation stages.
+
+WorldGenerate is a list of stages, run in order.  The output of each stage
+is saved in the game directory, keyed by a hash of the seed, the generator, 
+and the version of that stage and every stage before it.  When the world is
+generated again, every stage up to the first one whose key doesn't match is
+read back from disk instead of being run.  Each stage starts the shared 
+random number generator from its own seed, so a stage gives the same result
+whether or not the ones before it actually ran.
+-----------------------------------------------------------------------------*/
+
+static void stage_rivers ()
+{
+
+  TerraformRivers (planet.river_count);
+
+}
+
+static void stage_lakes ()
 {
 
-  int         x;
+  TerraformLakes (planet.lake_count);
 
+}
+
+static Stage        stages[] = 
+{
+  { "prepare",  TerraformPrepare, 1, PLANE_SHAPE | PLANE_CLIMATE | PLANE_COLORS | PLANE_INFO },
+  { "oceans",   TerraformOceans,  1, PLANE_SHAPE | PLANE_CLIMATE | PLANE_INFO },
+  { "coast",    TerraformCoast,   1, PLANE_SHAPE | PLANE_CLIMATE | PLANE_SHORE | PLANE_INFO },
+  { "climate",  TerraformClimate, 1, PLANE_CLIMATE },
+  { "rivers",   stage_rivers,     1, PLANE_SHAPE | PLANE_CLIMATE | PLANE_INFO },
+  { "lakes",    stage_lakes,      1, PLANE_SHAPE | PLANE_INFO },
+  //Do climate a second time now that rivers are in
+  { "climate",  TerraformClimate, 1, PLANE_CLIMATE },
+  { "zones",    TerraformZones,   1, PLANE_SHAPE | PLANE_CLIMATE | PLANE_INFO },
+  //Now again, since we have added climate-modifying features (Mountains, etc.)
+  { "climate",  TerraformClimate, 1, PLANE_CLIMATE },
+  { "fill",     TerraformFill,    1, PLANE_SHAPE | PLANE_INFO },
+  { "average",  TerraformAverage, 1, PLANE_SHAPE | PLANE_CLIMATE },
+  { "flora",    TerraformFlora,   1, PLANE_INFO },
+  { "colors",   TerraformColors,  1, PLANE_COLORS | PLANE_INFO },
+};
+
+#define STAGES            (sizeof (stages) / sizeof (Stage))
+
+static int stage_bytes (unsigned output)
+{
+
+  unsigned    i;
+  int         bytes;
+
+  bytes = 0;
+  for (i = 0; i < PLANES; i++) {
+    if (planes[i].group & output)
+      bytes += planes[i].bytes;
+  }
+  return bytes;
+
+}
+
+static char* stage_filename (unsigned stage)
+{
+
+  static char     filename[256];
+
+  sprintf (filename, "%sstage%02d.dat", WorldDirectory (), stage);
+  return filename;
+
+}
+
+//Planes are only overwritten once the whole stage has been read, so a short
+//or damaged file leaves the input to the stage as it was.
+static bool stage_load (unsigned stage, unsigned key)
+{
+
+  FILE*       f;
+  SHeader     header;
+  char*       buffer;
+  char*       ptr;
+  long        length;
+  unsigned    i;
+  bool        ok;
+
+  if (!(f = fopen (stage_filename (stage), "rb")))
+    return false;
+  ok = fread (&header, sizeof (header), 1, f) == 1;
+  ok = ok && header.key == key && header.output == stages[stage].output;
+  ok = ok && header.bytes == stage_bytes (stages[stage].output);
+  if (ok) {
+    fseek (f, 0, SEEK_END);
+    length = ftell (f);
+    ok = length == (long)sizeof (header) + header.bytes;
+  }
+  if (!ok) {
+    fclose (f);
+    return false;
+  }
+  buffer = new char[header.bytes];
+  fseek (f, sizeof (header), SEEK_SET);
+  ok = fread (buffer, header.bytes, 1, f) == 1;
+  fclose (f);
+  if (ok) {
+    ptr = buffer;
+    for (i = 0; i < PLANES; i++) {
+      if (planes[i].group & stages[stage].output) {
+        memcpy (planes[i].data, ptr, planes[i].bytes);
+        ptr += planes[i].bytes;
+      }
+    }
+  }
+  delete[] buffer;
+  return ok;
+
+}
+
+//Write to a temporary file and move it into place, so a crash part way 
+//through never leaves a stage file that looks valid.
+static void stage_save (unsigned stage, unsigned key)
+{
+
+  FILE*       f;
+  SHeader     header;
+  char        temp[256 + 4]; //The stage file name, plus ".tmp"
+  unsigned    i;
+  bool        ok;
+
+  sprintf (temp, "%s.tmp", stage_filename (stage));
+  if (!(f = fopen (temp, "wb"))) {
+    ConsoleLog ("WorldGenerate: Could not save stage '%s'.", stages[stage].name);
+    return;
+  }
+  header.key = key;
+  header.output = stages[stage].output;
+  header.bytes = stage_bytes (stages[stage].output);
+  ok = fwrite (&header, sizeof (header), 1, f) == 1;
+  for (i = 0; ok && i < PLANES; i++) {
+    if (planes[i].group & stages[stage].output)
+      ok = fwrite (planes[i].data, planes[i].bytes, 1, f) == 1;
+  }
+  ok = (fclose (f) == 0) && ok;
+  if (ok) {
+    //Windows won't rename over an existing file.
+    remove (stage_filename (stage));
+    ok = rename (temp, stage_filename (stage)) == 0;
+  }
+  if (!ok) {
+    remove (temp);
+    ConsoleLog ("WorldGenerate: Could not save stage '%s'.", stages[stage].name);
+  }
+
+}
+
+//Set up everything that comes straight from the seed, before the stages run.
+static void generate_begin (unsigned seed_in)
+{
+
+  int           x;
+  unsigned long draw[2];
+
+  //Passes that search the map or carry state from region to region still use
+  //the shared generator.  Everything drawn per region uses keyed streams.
   RandomInit (seed_in);
   planet.seed = seed_in;
+  title_clear ();
   
   for (x = 0; x < NOISE_BUFFER; x++) {
-    planet.noisei[x] = RandomVal ();
-    planet.noisef[x] = RandomFloat ();
+    RandomFill (seed_in, RANDOM_NOISE, x, 0, draw, 2);
+    planet.noisei[x] = draw[0];
+    planet.noisef[x] = (float)(draw[1] % 10000) / 10000;
   }
-  build_trees ();
   planet.wind_from_west = (RandomVal () % 2) ? true : false;
   planet.northern_hemisphere = (RandomVal () % 2) ? true : false;
   planet.river_count = 4 + RandomVal () % 4;
   planet.lake_count = 1 + RandomVal () % 4;
-  TerraformPrepare ();
-  TerraformOceans ();
-  TerraformCoast ();
-  TerraformClimate ();
-  TerraformRivers (planet.river_count);
-  TerraformLakes (planet.lake_count);
-  TerraformClimate ();//Do climate a second time now that rivers are in
-  TerraformZones ();
-  TerraformClimate ();//Now again, since we have added climate-modifying features (Mountains, etc.)
-  TerraformFill ();
-  TerraformAverage ();
-  TerraformFlora ();
-  TerraformColors ();
-  build_map_texture ();
+
+}
+
+//Run the stages, picking up whatever we can from the saved ones.
+static void generate_stages (unsigned seed_in)
+{
+
+  unsigned      stage;
+  unsigned      key;
+  unsigned      loaded;
+  bool          loading;
+
+  //The stages are saved alongside the rest of the world.
+  FileMakeDirectory (WorldDirectory ());
+  key = (WorldGenerator () ^ seed_in) * 16777619u;
+  loading = true;
+  loaded = 0;
+  for (stage = 0; stage < STAGES; stage++) {
+    key = (key ^ stages[stage].version) * 16777619u;
+    key = (key ^ stage) * 16777619u;
+    //Once one stage has to run, everything after it does too.
+    if (loading && stage_load (stage, key)) {
+      loaded++;
+      if (stages[stage].output & PLANE_INFO)
+        title_rebuild ();
+      continue;
+    }
+    loading = false;
+    RandomInit (RandomAt (seed_in, RANDOM_STAGE, stage, 0, 0));
+    stages[stage].run ();
+    stage_save (stage, key);
+  }
+  if (loaded)
+    ConsoleLog ("WorldGenerate: %d of %d stages read from disk.", loaded, (int)STAGES);
+
+}
+
+void    WorldGenerate (unsigned seed_in)
+{
+
+  generate_begin (seed_in);
+  build_trees (true);
+  generate_stages (seed_in);
   
 }
 
+/*-----------------------------------------------------------------------------
+  Generate the world without any graphics, so it can be done from the command
+  line.  The stages are saved as usual.  The trees are planned but not built, 
+  and there's no map texture, so this isn't a world you can play in.  
+-----------------------------------------------------------------------------*/
+
+void    WorldBake (unsigned seed_in)
+{
+
+  generate_begin (seed_in);
+  build_trees (false);
+  generate_stages (seed_in);
+
+}
+
+//The color of one region on a preview map.
+static GLrgba preview_color (int x, int y)
+{
+
+  GLrgba    land, cold;
+
+  if (planet.climate[x][y] == CLIMATE_OCEAN) 
+    return glRgba (0.0f, 0.5f, 1.0f) * (planet.info[x][y].geo_scale + 1.0f);
+  if (planet.climate[x][y] == CLIMATE_COAST)
+    return glRgba (0.9f, 0.7f, 0.4f);
+  land = glRgbaInterpolate (glRgba (0.6f, 0.5f, 0.3f), glRgba (0.1f, 0.5f, 0.1f), planet.moisture[x][y]);
+  cold = glRgba (0.9f, 0.9f, 1.0f);
+  land = glRgbaInterpolate (cold, land, clamp (planet.temperature[x][y] / TEMP_COLD, 0.0f, 1.0f));
+  return land * (planet.info[x][y].geo_scale * 0.5f + 0.5f);
+
+}
+
+/*-----------------------------------------------------------------------------
+  Make a quick sketch of the world from the given seed: the land, the coast, 
+  and the temperature and rainfall, which is most of what tells one world 
+  from another on the map.  Save a small map of it, and sum up what it's 
+  like.  Rivers and lakes aren't placed, so only the planned counts are 
+  known.  This doesn't touch the saved stages, so it's cheap enough to flip 
+  through lots of seeds.  The image is skipped if image is NULL.
+-----------------------------------------------------------------------------*/
+
+void WorldPreview (unsigned seed, char* image, WorldSummary* summary)
+{
+
+  int             x, y, xx, yy;
+  int             land, beach, block;
+  unsigned char*  buffer;
+  unsigned char*  ptr;
+  GLrgba          c;
+  GLcoord         size;
+
+  generate_begin (seed);
+  TerraformSketch ();
+  memset (summary, 0, sizeof (WorldSummary));
+  summary->seed = seed;
+  summary->wind_from_west = planet.wind_from_west;
+  summary->northern_hemisphere = planet.northern_hemisphere;
+  summary->rivers_planned = planet.river_count;
+  summary->lakes_planned = planet.lake_count;
+  land = beach = 0;
+  for (x = 0; x < WORLD_GRID; x++) {
+    for (y = 0; y < WORLD_GRID; y++) {
+      if (planet.climate[x][y] == CLIMATE_OCEAN)
+        continue;
+      land++;
+      //The full world puts beaches one step from the sea, and coast behind.
+      if (planet.shore_distance[x][y] == 1)
+        beach++;
+      summary->temperature += planet.temperature[x][y];
+      summary->moisture += planet.moisture[x][y];
+    }
+  }
+  if (land) {
+    summary->temperature /= (float)land;
+    summary->moisture /= (float)land;
+  }
+  summary->land = (float)land / (WORLD_GRID * WORLD_GRID);
+  summary->beach = (float)beach / (WORLD_GRID * WORLD_GRID);
+  if (!image)
+    return;
+  //Each pixel is the average of a block of regions.
+  block = WORLD_GRID / PREVIEW_SIZE;
+  buffer = new unsigned char[PREVIEW_SIZE * PREVIEW_SIZE * 3];
+  for (x = 0; x < PREVIEW_SIZE; x++) {
+    for (y = 0; y < PREVIEW_SIZE; y++) {
+      c = glRgba (0.0f);
+      for (xx = 0; xx < block; xx++) {
+        for (yy = 0; yy < block; yy++) 
+          c += preview_color (x * block + xx, y * block + yy);
+      }
+      c /= (float)(block * block);
+      c.Clamp ();
+      //Flip it vertically, like the map texture.
+      ptr = &buffer[(x + ((PREVIEW_SIZE - 1) - y) * PREVIEW_SIZE) * 3];
+      ptr[0] = (unsigned char)(c.red * 255.0f);
+      ptr[1] = (unsigned char)(c.green * 255.0f);
+      ptr[2] = (unsigned char)(c.blue * 255.0f);
+    }
+  }
+  size.x = size.y = PREVIEW_SIZE;
+  FileImageSave (image, buffer, size);
+  delete[] buffer;
+
+}
+
 Region WorldRegionGet (int index_x, int index_y)
 {
 
-  return planet.map[index_x][index_y];
+  Region      r;
+  int         x, y;
+  unsigned    i;
+
+  x = clamp (index_x, 0, WORLD_GRID - 1);
+  y = clamp (index_y, 0, WORLD_GRID - 1);
+  const RegionInfo& info = planet.info[x][y];
+  strcpy (r.title, planet.titles[info.title]);
+  r.tree_type = info.tree_type;
+  r.flags_shape = planet.flags_shape[x][y];
+  r.climate = (Climate)planet.climate[x][y];
+  r.grid_pos.x = x;
+  r.grid_pos.y = y;
+  r.mountain_height = info.mountain_height;
+  r.river_id = info.river_id;
+  r.river_segment = info.river_segment;
+  r.tree_threshold = info.tree_threshold;
+  r.river_width = planet.river_width[x][y];
+  r.geo_scale = info.geo_scale;
+  r.geo_water = planet.geo_water[x][y];
+  r.geo_detail = planet.geo_detail[x][y];
+  r.geo_bias = planet.geo_bias[x][y];
+  r.temperature = planet.temperature[x][y];
+  r.moisture = planet.moisture[x][y];
+  r.cliff_threshold = planet.cliff_threshold[x][y];
+  r.color_map = color_unpack (info.color_map);
+  r.color_rock = color_unpack (planet.color_rock[x][y]);
+  r.color_dirt = color_unpack (planet.color_dirt[x][y]);
+  r.color_grass = color_unpack (planet.color_grass[x][y]);
+  r.color_atmosphere = color_unpack (info.color_atmosphere);
+  for (i = 0; i < FLOWERS; i++) {
+    r.color_flowers[i] = color_unpack (info.color_flowers[i]);
+    r.flower_shape[i] = info.flower_shape[i];
+  }
+  r.has_flowers = info.has_flowers;
+  return r;
 
 }
 
 void WorldRegionSet (int index_x, int index_y, Region val)
 {
 
-  planet.map[index_x][index_y] = val;
+  unsigned    i;
+
+  RegionInfo& info = planet.info[index_x][index_y];
+  title_set (&info.title, val.title);
+  info.tree_type = val.tree_type;
+  planet.flags_shape[index_x][index_y] = val.flags_shape;
+  planet.climate[index_x][index_y] = (UCHAR)val.climate;
+  info.mountain_height = val.mountain_height;
+  info.river_id = val.river_id;
+  info.river_segment = val.river_segment;
+  info.tree_threshold = val.tree_threshold;
+  planet.river_width[index_x][index_y] = val.river_width;
+  info.geo_scale = val.geo_scale;
+  planet.geo_water[index_x][index_y] = val.geo_water;
+  planet.geo_detail[index_x][index_y] = val.geo_detail;
+  planet.geo_bias[index_x][index_y] = val.geo_bias;
+  planet.temperature[index_x][index_y] = val.temperature;
+  planet.moisture[index_x][index_y] = val.moisture;
+  planet.cliff_threshold[index_x][index_y] = val.cliff_threshold;
+  info.color_map = color_pack (val.color_map);
+  planet.color_rock[index_x][index_y] = color_pack (val.color_rock);
+  planet.color_dirt[index_x][index_y] = color_pack (val.color_dirt);
+  planet.color_grass[index_x][index_y] = color_pack (val.color_grass);
+  info.color_atmosphere = color_pack (val.color_atmosphere);
+  for (i = 0; i < FLOWERS; i++) {
+    info.color_flowers[i] = color_pack (val.color_flowers[i]);
+    info.flower_shape[i] = val.flower_shape[i];
+  }
+  info.has_flowers = val.has_flowers;
 
 }
 
-Region WorldRegionFromPosition (int world_x, int world_y)
+//Which region (after dithering) does the given cell belong to?
+GLcoord WorldRegionCoord (int world_x, int world_y)
 {
-  
+
+  GLcoord   result;
+
   world_x = max (world_x, 0);
   world_y = max (world_y, 0);
   world_x += dithermap[world_x % DITHER_SIZE][world_y % DITHER_SIZE].x;
   world_y += dithermap[world_x % DITHER_SIZE][world_y % DITHER_SIZE].y;
-  world_x /= REGION_SIZE;
-  world_y /= REGION_SIZE;
-  if (world_x >= WORLD_GRID || world_y >= WORLD_GRID)
-    return planet.map[0][0];
-  return planet.map[world_x][world_y];
+  result.x = world_x / REGION_SIZE;
+  result.y = world_y / REGION_SIZE;
+  if (result.x >= WORLD_GRID || result.y >= WORLD_GRID)
+    result.Clear ();
+  return result;
+
+}
+
+Region WorldRegionFromPosition (int world_x, int world_y)
+{
+  
+  GLcoord   c;
+
+  c = WorldRegionCoord (world_x, world_y);
+  return WorldRegionGet (c.x, c.y);
 
 }
 
@@ -596,7 +1210,8 @@ GLrgba WorldColorGet (int world_x, int world_y, SurfaceColor c)
   int       x, y;
   GLvector2 offset;
   GLrgba    c0, c1, c2, c3, result;
-  Region    r0, r1, r2, r3;
+  int       x1, y1;
+  unsigned  (*plane)[WORLD_GRID];
 
   x = max (world_x % DITHER_SIZE, 0);
   y = max (world_y % DITHER_SIZE, 0);
@@ -606,33 +1221,28 @@ GLrgba WorldColorGet (int world_x, int world_y, SurfaceColor c)
   offset.y = (float)(world_y % REGION_SIZE) / REGION_SIZE;
   origin.x = world_x / REGION_SIZE;
   origin.y = world_y / REGION_SIZE;
-  r0 = WorldRegionGet (origin.x, origin.y);
-  r1 = WorldRegionGet (origin.x + 1, origin.y);
-  r2 = WorldRegionGet (origin.x, origin.y + 1);
-  r3 = WorldRegionGet (origin.x + 1, origin.y + 1);
+  origin.x = clamp (origin.x, 0, WORLD_GRID - 1);
+  origin.y = clamp (origin.y, 0, WORLD_GRID - 1);
+  x1 = edge (origin.x + 1);
+  y1 = edge (origin.y + 1);
   switch (c) {
   case SURFACE_COLOR_DIRT:
-    c0 = r0.color_dirt;
-    c1 = r1.color_dirt;
-    c2 = r2.color_dirt;
-    c3 = r3.color_dirt;
+    plane = planet.color_dirt;
     break;
   case SURFACE_COLOR_ROCK:
-    c0 = r0.color_rock;
-    c1 = r1.color_rock;
-    c2 = r2.color_rock;
-    c3 = r3.color_rock;
+    plane = planet.color_rock;
     break;
   case SURFACE_COLOR_SAND:
     return glRgba (0.98f, 0.82f, 0.42f);
   default:
   case SURFACE_COLOR_GRASS:
-    c0 = r0.color_grass;
-    c1 = r1.color_grass;
-    c2 = r2.color_grass;
-    c3 = r3.color_grass;
+    plane = planet.color_grass;
     break;
   }
+  c0 = color_unpack (plane[origin.x][origin.y]);
+  c1 = color_unpack (plane[x1][origin.y]);
+  c2 = color_unpack (plane[origin.x][y1]);
+  c3 = color_unpack (plane[x1][y1]);
   result.red   = MathInterpolateQuad (c0.red, c1.red, c2.red, c3.red, offset);
   result.green = MathInterpolateQuad (c0.green, c1.green, c2.green, c3.green, offset);
   result.blue  = MathInterpolateQuad (c0.blue, c1.blue, c2.blue, c3.blue, offset);
@@ -647,38 +1257,55 @@ unsigned WorldCanopyTree ()
 
 }
 
-unsigned WorldMap ()
+//A fingerprint of the code and constants that produced the world.
+unsigned WorldGenerator ()
 {
 
-  return map_id;
+  unsigned    hash;
+  unsigned    values[] = { GENERATOR_VERSION, WORLD_GRID, REGION_SIZE, NOISE_BUFFER, TREE_TYPES };
+  unsigned    i;
+
+  hash = 2166136261u;
+  for (i = 0; i < sizeof (values) / sizeof (unsigned); i++)
+    hash = (hash ^ values[i]) * 16777619u;
+  return hash;
 
 }
 
-World* WorldPtr ()
+//The map as an RGB image, one pixel per region, bottom row first the way 
+//OpenGL wants it.  The buffer must hold WORLD_GRID * WORLD_GRID * 3 bytes.
+void WorldMapImage (unsigned char* buffer)
 {
 
-  return &planet;
+  int             x, y, yy;
+  GLrgba          c;
+  unsigned char*  ptr;
+
+  for (x = 0; x < WORLD_GRID; x++) {
+    for (y = 0; y < WORLD_GRID; y++) {
+      //Flip it vertically, because the OpenGL texture coord system is retarded.
+      yy = (WORLD_GRID - 1) - y;
+      c = color_unpack (planet.info[x][yy].color_map);
+      ptr = &buffer[(x + y * WORLD_GRID) * 3];
+      ptr[0] = (unsigned char)(c.red * 255.0f);
+      ptr[1] = (unsigned char)(c.green * 255.0f);
+      ptr[2] = (unsigned char)(c.blue * 255.0f);
+    }
+  }
 
 }
 
-void          WorldTexturePurge ()
+World* WorldPtr ()
 {
 
-  unsigned    m, t;
-
-  for (m = 0; m < TREE_TYPES; m++) {
-    for (t = 0; t < TREE_TYPES; t++) {
-      tree[m][t].TexturePurge ();
-    }
-  }
-  build_map_texture ();
+  return &planet;
 
 }
 
-char* WorldDirectionFromAngle (float angle)
+const char* WorldDirectionFromAngle (float angle)
 {
 
-  char*   direction;
+  const char*   direction;
 
   direction = "North";
   if (angle < 22.5f)
@@ -700,7 +1327,7 @@ char* WorldDirectionFromAngle (float angle)
   return direction;
 
 }
-/*
+//Where everything about this world is saved.
 char* WorldDirectory ()
 {
 
@@ -710,5 +1337,3 @@ char* WorldDirectory ()
   return dir;
 
 }
-
-*/
\ No newline at end of file
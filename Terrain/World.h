@@ -37,6 +37,13 @@
 //in the world is the square of this value, minus one. ("tree zero" is actually
 //"no trees at all".)
 #define TREE_TYPES        6
+//Region titles are stored once each, in a table of this many.
+#define WORLD_TITLES      4096
+#define TITLE_LENGTH      50
+//Width and height of the map image made by WorldPreview.
+#define PREVIEW_SIZE      64
+//Shore distance for regions that can't reach the ocean at all.
+#define SHORE_FAR         255
 
 enum Climate
 {
@@ -58,9 +65,11 @@ enum Climate
 };
 
 
+//Everything about a region, gathered together.  This is how regions are 
+//handed around, but it's not how they're stored.  See World, below.
 struct Region
 {
-  char      title[50];
+  char      title[TITLE_LENGTH];
   unsigned  tree_type;
   unsigned  flags_shape;
   Climate   climate;
@@ -87,8 +96,30 @@ struct Region
   bool      has_flowers;
 };
 
+//The parts of a region that building terrain never looks at.  Colors are 
+//kept as 8-bit RGBA, packed into a single unsigned.
+struct RegionInfo
+{
+  unsigned        title; //Index into World::titles
+  unsigned        tree_type;
+  int             mountain_height;
+  int             river_id;
+  int             river_segment;
+  float           tree_threshold;
+  float           geo_scale;
+  unsigned        color_map;
+  unsigned        color_atmosphere;
+  unsigned        color_flowers[FLOWERS];
+  unsigned        flower_shape[FLOWERS];
+  bool            has_flowers;
+};
+
 //Only one of these is ever instanced.  This is everything that goes into a "save file".
 //Using only this, the entire world can be re-created.
+//
+//Regions are split up by how often they're used.  The properties that every
+//cell of terrain depends on each get their own plane, so building terrain 
+//only streams through the bytes it needs.
 struct World
 {
   unsigned      seed;
@@ -98,24 +129,64 @@ struct World
   unsigned      lake_count;
   float         noisef[NOISE_BUFFER];
   unsigned      noisei[NOISE_BUFFER];
-  Region        map[WORLD_GRID][WORLD_GRID];
+  //Elevation
+  unsigned      flags_shape[WORLD_GRID][WORLD_GRID];
+  float         geo_water[WORLD_GRID][WORLD_GRID];
+  float         geo_bias[WORLD_GRID][WORLD_GRID];
+  float         geo_detail[WORLD_GRID][WORLD_GRID];
+  float         cliff_threshold[WORLD_GRID][WORLD_GRID];
+  float         river_width[WORLD_GRID][WORLD_GRID];
+  UCHAR         climate[WORLD_GRID][WORLD_GRID];
+  //Surfaces and colors
+  float         temperature[WORLD_GRID][WORLD_GRID];
+  float         moisture[WORLD_GRID][WORLD_GRID];
+  unsigned      color_rock[WORLD_GRID][WORLD_GRID];
+  unsigned      color_dirt[WORLD_GRID][WORLD_GRID];
+  unsigned      color_grass[WORLD_GRID][WORLD_GRID];
+  //How many regions away the nearest ocean is, counting diagonal steps as 
+  //one, and which way it lies. The direction is the signs of the offset to 
+  //it, packed as (x + 1) + (y + 1) * 3, so 4 means this is the ocean.
+  UCHAR         shore_distance[WORLD_GRID][WORLD_GRID];
+  UCHAR         shore_direction[WORLD_GRID][WORLD_GRID];
+  //Everything else
+  RegionInfo    info[WORLD_GRID][WORLD_GRID];
+  unsigned      title_count;
+  char          titles[WORLD_TITLES][TITLE_LENGTH];
 };
 
+//A few numbers that describe a world at a glance, from WorldPreview.
+struct WorldSummary
+{
+  unsigned      seed;
+  float         land;         //Share of the map above the sea
+  float         beach;        //Share of the map right on the shore
+  float         temperature;  //Average over land
+  float         moisture;     //Average over land
+  bool          wind_from_west;
+  bool          northern_hemisphere;
+  unsigned      rivers_planned; //Rivers and lakes the full world will try for
+  unsigned      lakes_planned;
+};
 
 Cell          WorldCell (int world_x, int world_y);
+void          WorldCells (int world_x, int world_y, int count, Cell* out);
 GLrgba        WorldColorGet (int world_x, int world_y, SurfaceColor c);
-char*         WorldLocationName (int world_x, int world_y);
+const char*   WorldLocationName (int world_x, int world_y);
+GLcoord       WorldRegionCoord (int world_x, int world_y);
 Region        WorldRegionFromPosition (int world_x, int world_y);
 Region        WorldRegionFromPosition (int world_x, int world_y);
 float         WorldWaterLevel (int world_x, int world_y);
 
+void          WorldBake (unsigned seed);
 void          WorldGenerate (unsigned seed);
 unsigned      WorldCanopyTree ();
-char*         WorldDirectionFromAngle (float angle);
-//char*         WorldDirectory ();
+const char*   WorldDirectionFromAngle (float angle);
+unsigned      WorldGenerator ();
+char*         WorldDirectory ();
 void          WorldInit ();
 void          WorldLoad (unsigned seed);
-unsigned      WorldMap ();
+void          WorldPreview (unsigned seed, char* image, WorldSummary* summary);
+void          WorldMapImage (unsigned char* buffer);
 unsigned      WorldNoisei (int index);
 float         WorldNoisef (int index);
 World*        WorldPtr ();
@@ -124,4 +195,7 @@ void          WorldRegionSet (int index_x, int index_y, Region val);
 void          WorldSave ();
 unsigned      WorldTreeType (float moisture, float temperature);
 class CTree*  WorldTree (unsigned id);
+//These are in WorldTexture.cpp, with the game.
+unsigned      WorldMap ();
+void          WorldTextureBuild ();
 void          WorldTexturePurge ();
@@ -0,0 +1,72 @@
+/*-----------------------------------------------------------------------------
+
+  WorldTexture.cpp
+
+-------------------------------------------------------------------------------
+
+  The world's textures: the map, and the trees.  World.cpp makes the world
+  without any graphics, so once a world has been generated or loaded, the
+  game calls WorldTextureBuild to give it a look.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+#include "CTree.h"
+#include "World.h"
+
+static unsigned     map_id;
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+static void build_map_texture ()
+{
+
+  unsigned char*  buffer;
+
+  if (!map_id)
+    glGenTextures (1, &map_id);
+  glBindTexture(GL_TEXTURE_2D, map_id);
+	glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+  glTexParameteri (GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  buffer = new unsigned char[WORLD_GRID * WORLD_GRID * 3];
+  WorldMapImage (buffer);
+  glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, WORLD_GRID, WORLD_GRID, 0, GL_RGB, GL_UNSIGNED_BYTE, &buffer[0]);
+  delete[] buffer;
+
+}
+
+/*-----------------------------------------------------------------------------
+
+-----------------------------------------------------------------------------*/
+
+unsigned WorldMap ()
+{
+
+  return map_id;
+
+}
+
+void          WorldTextureBuild ()
+{
+
+  unsigned    i;
+
+  for (i = 0; i < TREE_TYPES * TREE_TYPES; i++)
+    WorldTree (i)->DoTexture ();
+  build_map_texture ();
+
+}
+
+//Rebuild the textures we already have, after the GL context has been lost.
+void          WorldTexturePurge ()
+{
+
+  unsigned    i;
+
+  for (i = 0; i < TREE_TYPES * TREE_TYPES; i++)
+    WorldTree (i)->TexturePurge ();
+  build_map_texture ();
+
+}
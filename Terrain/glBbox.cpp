@@ -11,7 +11,7 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 #include <math.h>
 
 #define MAX_VALUE               999999999999999.9f
@@ -55,37 +55,3 @@ void GLbbox::Clear (void)
 
 }
 
-void GLbbox::Render ()
-{
-  //Bottom of box (Assuming z = up)
-  glBegin (GL_LINE_STRIP);
-  glVertex3f (pmin.x, pmin.y, pmin.z);
-  glVertex3f (pmax.x, pmin.y, pmin.z);
-  glVertex3f (pmax.x, pmax.y, pmin.z);
-  glVertex3f (pmin.x, pmax.y, pmin.z);
-  glVertex3f (pmin.x, pmin.y, pmin.z);
-  glEnd ();
-  //Top of box
-  glBegin (GL_LINE_STRIP);
-  glVertex3f (pmin.x, pmin.y, pmax.z);
-  glVertex3f (pmax.x, pmin.y, pmax.z);
-  glVertex3f (pmax.x, pmax.y, pmax.z);
-  glVertex3f (pmin.x, pmax.y, pmax.z);
-  glVertex3f (pmin.x, pmin.y, pmax.z);
-  glEnd ();
-  //Sides
-  glBegin (GL_LINES);
-  glVertex3f (pmin.x, pmin.y, pmin.z);
-  glVertex3f (pmin.x, pmin.y, pmax.z);
-
-  glVertex3f (pmax.x, pmin.y, pmin.z);
-  glVertex3f (pmax.x, pmin.y, pmax.z);
-
-  glVertex3f (pmax.x, pmax.y, pmin.z);
-  glVertex3f (pmax.x, pmax.y, pmax.z);
-
-  glVertex3f (pmin.x, pmax.y, pmin.z);
-  glVertex3f (pmin.x, pmax.y, pmax.z);
-  glEnd ();
-
-}
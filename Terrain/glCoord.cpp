@@ -10,7 +10,7 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 
 bool GLcoord::operator== (const GLcoord& c)
 {
@@ -0,0 +1,63 @@
+/*-----------------------------------------------------------------------------
+
+  glDraw.cpp
+
+-------------------------------------------------------------------------------
+  
+  Immediate-mode drawing for the gl types, mostly for debugging.  This is 
+  kept apart from the types themselves, which the engine core uses without 
+  OpenGL.
+
+-----------------------------------------------------------------------------*/
+
+#include "stdafx.h"
+
+void GLbbox::Render ()
+{
+  //Bottom of box (Assuming z = up)
+  glBegin (GL_LINE_STRIP);
+  glVertex3f (pmin.x, pmin.y, pmin.z);
+  glVertex3f (pmax.x, pmin.y, pmin.z);
+  glVertex3f (pmax.x, pmax.y, pmin.z);
+  glVertex3f (pmin.x, pmax.y, pmin.z);
+  glVertex3f (pmin.x, pmin.y, pmin.z);
+  glEnd ();
+  //Top of box
+  glBegin (GL_LINE_STRIP);
+  glVertex3f (pmin.x, pmin.y, pmax.z);
+  glVertex3f (pmax.x, pmin.y, pmax.z);
+  glVertex3f (pmax.x, pmax.y, pmax.z);
+  glVertex3f (pmin.x, pmax.y, pmax.z);
+  glVertex3f (pmin.x, pmin.y, pmax.z);
+  glEnd ();
+  //Sides
+  glBegin (GL_LINES);
+  glVertex3f (pmin.x, pmin.y, pmin.z);
+  glVertex3f (pmin.x, pmin.y, pmax.z);
+
+  glVertex3f (pmax.x, pmin.y, pmin.z);
+  glVertex3f (pmax.x, pmin.y, pmax.z);
+
+  glVertex3f (pmax.x, pmax.y, pmin.z);
+  glVertex3f (pmax.x, pmax.y, pmax.z);
+
+  glVertex3f (pmin.x, pmax.y, pmin.z);
+  glVertex3f (pmin.x, pmax.y, pmax.z);
+  glEnd ();
+
+}
+
+void GLmesh::Render ()
+{
+
+  unsigned      i;
+
+  glBegin (GL_TRIANGLES);
+  for (i = 0; i < _index.size (); i++) {
+    glNormal3fv (&_normal[_index[i]].x);
+    glTexCoord2fv (&_uv[_index[i]].x);
+    glVertex3fv (&_vertex[_index[i]].x);
+  }
+  glEnd ();
+
+}
@@ -10,7 +10,7 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 
 #define M(e,x,y)                (e.elements[x][y])
 #define E(x,y)                  (elements[x][y])
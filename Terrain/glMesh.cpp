@@ -10,7 +10,7 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 
 void GLmesh::PushTriangle (UINT i1, UINT i2, UINT i3)
 {
@@ -61,21 +61,6 @@ void GLmesh::Clear ()
 
 }
 
-void GLmesh::Render ()
-{
-
-  unsigned      i;
-
-  glBegin (GL_TRIANGLES);
-  for (i = 0; i < _index.size (); i++) {
-    glNormal3fv (&_normal[_index[i]].x);
-    glTexCoord2fv (&_uv[_index[i]].x);
-    glVertex3fv (&_vertex[_index[i]].x);
-  }
-  glEnd ();
-
-}
-
 void GLmesh::RecalculateBoundingBox ()
 {
 
@@ -119,10 +104,10 @@ void GLmesh::CalculateNormals ()
     //calculate the 3 internal angles of this triangle.
     dot = glVectorDotProduct (edge[2], edge[0]);
     angle[0] = acos(-dot);
-    if (_isnan (angle[0]))
+    if (ISNAN (angle[0]))
       continue;
     angle[1] = acos(-glVectorDotProduct (edge[0], edge[1]));
-    if (_isnan (angle[1]))
+    if (ISNAN (angle[1]))
       continue;
     angle[2] = PI - (angle[0] + angle[1]);
     //Now weight each normal by the size of the angle so that the triangle 
@@ -196,10 +181,10 @@ void GLmesh::CalculateNormalsSeamless ()
     //calculate the 3 internal angles of this triangle.
     dot = glVectorDotProduct (edge[2], edge[0]);
     angle[0] = acos(-dot);
-    if (_isnan (angle[0]))
+    if (ISNAN (angle[0]))
       continue;
     angle[1] = acos(-glVectorDotProduct (edge[0], edge[1]));
-    if (_isnan (angle[1]))
+    if (ISNAN (angle[1]))
       continue;
     angle[2] = PI - (angle[0] + angle[1]);
     //Now weight each normal by the size of the angle so that the triangle 
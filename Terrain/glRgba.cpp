@@ -10,11 +10,11 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 #include <stdio.h>
 #include <math.h>
 
-#include "math.h"
+#include "Math.h"
 
 //This is a list of the integers from 0 to 511, in random order. Used for 
 //scrambling the unique colors function.
@@ -206,9 +206,9 @@ GLrgba glRgba (char* string)
     pound[0] = ' ';
   if (sscanf (string, "%x", &color) != 1)
 	  return glRgba (0.0f);
-  result.red = (float)GetBValue (color) / 255.0f;
-  result.green = (float)GetGValue (color) / 255.0f;
-  result.blue = (float)GetRValue (color) / 255.0f;
+  result.red = (float)((color >> 16) & 0xFF) / 255.0f;
+  result.green = (float)((color >> 8) & 0xFF) / 255.0f;
+  result.blue = (float)(color & 0xFF) / 255.0f;
   result.alpha = 1.0f;
   return result;  
 
@@ -275,9 +275,9 @@ GLrgba glRgba (long c)
 
   GLrgba     result;
 
-  result.red = (float)GetRValue (c) / 255.0f;
-  result.green = (float)GetGValue (c) / 255.0f;
-  result.blue = (float)GetBValue (c) / 255.0f;
+  result.red = (float)(c & 0xFF) / 255.0f;
+  result.green = (float)((c >> 8) & 0xFF) / 255.0f;
+  result.blue = (float)((c >> 16) & 0xFF) / 255.0f;
   result.alpha = 1.0f;
   return result;
 
@@ -10,7 +10,7 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 
 void GLuvbox::Set (float repeats)
 {
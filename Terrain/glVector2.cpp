@@ -10,12 +10,12 @@
 
 -----------------------------------------------------------------------------*/
 
-#include "stdafx.h"
+#include "Core.h"
 
 #include <float.h>
 #include <math.h>
 
-#include "math.h"
+#include "Math.h"
 
 /*-----------------------------------------------------------------------------
                            
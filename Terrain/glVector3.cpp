@@ -9,12 +9,15 @@
   Functions for dealing with 3d vectors.
 
 -----------------------------------------------------------------------------*/
-#include "stdafx.h"
+#include "Core.h"
 
 #include <float.h>
 #include <math.h>
 
-#include "math.h"
+#include "Math.h"
+
+//Longest string we'll read a vector from.
+#define STREAM_MAX    256
 
 /*-----------------------------------------------------------------------------
                            
@@ -288,8 +291,8 @@ std::ostream &operator<<(std::ostream &stream, GLvector &v)
  */
 std::istream &operator>>(std::istream &stream, GLvector &v)
 {
-    char str[NAME_MAX] = {0};
-    stream.readsome( str, NAME_MAX );
+    char str[STREAM_MAX] = {0};
+    stream.readsome( str, STREAM_MAX - 1 );
     sscanf( str, "[ %f, %f, %f ]", &v.x, &v.y, &v.z );
 
     return stream;